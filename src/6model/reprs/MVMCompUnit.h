@@ -144,6 +144,10 @@ struct MVMCompUnitBody {
 
     /* Was a frame in this compilation unit invoked yet? */
     MVMuint8 invoked;
+
+    /* The specialization profile cache unit for this compilation unit, if
+     * the cache is enabled and the unit was invoked. */
+    MVMSpeshProfileCacheUnit *spesh_profile_unit;
 };
 struct MVMCompUnit {
     MVMObject common;
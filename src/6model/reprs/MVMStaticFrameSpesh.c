@@ -53,6 +53,10 @@ static void gc_free(MVMThreadContext *tc, MVMObject *obj) {
             sfs->body.num_spesh_candidates * sizeof(MVMSpeshCandidate *),
             sfs->body.spesh_candidates);
     MVM_spesh_plugin_state_free(tc, sfs->body.plugin_state);
+    if (sfs->body.deopt_storm_offsets)
+        MVM_fixed_size_free(tc, tc->instance->fsa,
+            (sfs->body.deopt_storm_offsets[0] + 1) * sizeof(MVMuint32),
+            sfs->body.deopt_storm_offsets);
 }
 
 static const MVMStorageSpec storage_spec = {
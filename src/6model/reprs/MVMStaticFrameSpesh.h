@@ -19,6 +19,12 @@ struct MVMStaticFrameSpeshBody {
      * extra recording or so. */
     MVMuint32 spesh_entries_recorded;
 
+    /* In adaptive tiering mode, the number of calls that were selected a
+     * specialization not specific to argument types while data was still
+     * being recorded; used to pick which of them run unspecialized so they
+     * are logged. Like the above, allowed to be a bit racey. */
+    MVMuint32 spesh_certain_calls;
+
     /* Specialization statistics assembled by the specialization worker thread
      * from logs. */
     MVMSpeshStats *spesh_stats;
@@ -31,6 +37,21 @@ struct MVMStaticFrameSpeshBody {
      * specialized. Used to decide whether we'll directly allocate this frame
      * on the heap. */
     MVMuint32 num_heap_promotions;
+
+    /* Bytecode offsets of deopt points where a guard caused a deopt storm,
+     * and that we should not speculate at again, preceded by their count.
+     * Allocated using the FSA and replaced under the spesh install lock. */
+    MVMuint32 *deopt_storm_offsets;
+
+    /* The number of candidates discarded due to deopt storms in a row, and
+     * when the latest of them happened (a uv_hrtime value). */
+    MVMuint32 num_deopt_storms;
+    MVMuint64 last_deopt_storm;
+
+    /* Set by the specialization worker once it has produced specializations
+     * from cached profiles for the frame; protected by the instance's spesh
+     * sync mutex. */
+    MVMuint32 profile_cache_seeded;
 };
 struct MVMStaticFrameSpesh {
     MVMObject common;
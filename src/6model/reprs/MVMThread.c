@@ -27,6 +27,7 @@ static void gc_mark(MVMThreadContext *tc, MVMSTable *st, void *data, MVMGCWorkli
     MVMThreadBody *body = (MVMThreadBody *)data;
     MVM_gc_worklist_add(tc, worklist, &body->invokee);
     MVM_gc_worklist_add(tc, worklist, &body->next);
+    MVM_spesh_log_ring_gc_mark(tc, body->spesh_log_ring, worklist);
 
     /* Unstarted threads are not yet in the running threads list, so their TC
      * needs marking here. The rest of the time, it's marked due to being in
@@ -40,6 +41,10 @@ static void gc_free(MVMThreadContext *tc, MVMObject *obj) {
     /* The ThreadContext has already been destroyed by the GC. */
     MVMThread *thread = (MVMThread *)obj;
     thread->body.invokee = NULL;
+    if (thread->body.spesh_log_ring) {
+        MVM_spesh_log_ring_destroy(tc, thread->body.spesh_log_ring);
+        thread->body.spesh_log_ring = NULL;
+    }
 }
 
 static const MVMStorageSpec storage_spec = {
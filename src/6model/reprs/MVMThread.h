@@ -36,6 +36,11 @@ struct MVMThreadBody {
     /* Non-zero if the thread should not block shutdown of the VM (those with
      * zero in here will be joined when the main thread ends). */
     MVMint32 app_lifetime;
+
+    /* Spesh logs sent by the thread and awaiting the spesh worker, if the
+     * thread does spesh logging. Lives here rather than in the thread
+     * context, since the worker may get to them after the thread ended. */
+    MVMSpeshLogRing *spesh_log_ring;
 };
 struct MVMThread {
     MVMObject common;
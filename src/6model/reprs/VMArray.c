@@ -1374,6 +1374,7 @@ static void spesh(MVMThreadContext *tc, MVMSTable *st, MVMSpeshGraph *g, MVMSpes
             ins->operands[0]          = target;
             ins->operands[1]          = obj;
             ins->operands[2].lit_i16 = offsetof(MVMArray, body.elems);
+            MVM_spesh_get_facts(tc, g, target)->flags |= MVM_SPESH_FACT_NON_NEGATIVE;
     }
     }
 }
@@ -23,6 +23,7 @@ MVMRegister * MVM_frame_initial_work(MVMThreadContext *tc, MVMuint16 *local_type
 static void prepare_and_verify_static_frame(MVMThreadContext *tc, MVMStaticFrame *static_frame) {
     MVMStaticFrameBody *static_frame_body = &static_frame->body;
     MVMCompUnit        *cu                = static_frame_body->cu;
+    MVMint32            first_prepared    = 0;
 
     /* Ensure the frame is fully deserialized. */
     if (!static_frame_body->fully_deserialized)
@@ -35,6 +36,8 @@ static void prepare_and_verify_static_frame(MVMThreadContext *tc, MVMStaticFrame
         cu->body.invoked = 1;
         if (tc->instance->spesh_enabled)
             MVM_spesh_log_new_compunit(tc);
+        if (tc->instance->spesh_profile_cache)
+            MVM_spesh_profile_cache_compunit_invoked(tc, cu);
     }
 
     /* Take compilation unit lock, to make sure we don't race to do the
@@ -84,10 +87,16 @@ static void prepare_and_verify_static_frame(MVMThreadContext *tc, MVMStaticFrame
 
         /* We now have at least instrumentation level 1. */
         static_frame->body.instrumentation_level = 1;
+        first_prepared = 1;
     }
 
     /* Unlock, now we're finished. */
     MVM_reentrantmutex_unlock(tc, (MVMReentrantMutex *)cu->body.deserialize_frame_mutex);
+
+    /* If there are cached specialization profiles for the frame, have them
+     * used right away. */
+    if (first_prepared && cu->body.spesh_profile_unit)
+        MVM_spesh_profile_cache_frame_prepared(tc, static_frame);
 }
 
 /* When we don't match the current instrumentation level, we hit this. It may
@@ -485,9 +494,28 @@ void MVM_frame_invoke(MVMThreadContext *tc, MVMStaticFrame *static_frame,
 
     /* See if any specializations apply. */
     spesh = static_frame->body.spesh;
-    if (spesh_cand < 0)
-        spesh_cand = MVM_spesh_arg_guard_run(tc, spesh->body.spesh_arg_guard,
-            callsite, args, NULL);
+    if (spesh_cand >= 0 && spesh->body.spesh_candidates[spesh_cand]->discarded)
+        spesh_cand = -1;
+    if (spesh_cand < 0) {
+        if (tc->instance->spesh_adaptive_enabled &&
+                spesh->body.spesh_entries_recorded < MVM_SPESH_LOG_LOGGED_ENOUGH) {
+            /* In adaptive tiering mode, the frame may have been specialized
+             * before its argument types were stable. If we'd run a
+             * specialization that is not specific to them, sometimes run
+             * unspecialized instead, so the types are logged and the frame
+             * can be planned again. */
+            MVMint32 certain = -1;
+            spesh_cand = MVM_spesh_arg_guard_run(tc, spesh->body.spesh_arg_guard,
+                callsite, args, &certain);
+            if (spesh_cand >= 0 && spesh_cand == certain &&
+                    spesh->body.spesh_certain_calls++ % MVM_SPESH_ADAPTIVE_RESAMPLE_INTERVAL == 0)
+                spesh_cand = -1;
+        }
+        else {
+            spesh_cand = MVM_spesh_arg_guard_run(tc, spesh->body.spesh_arg_guard,
+                callsite, args, NULL);
+        }
+    }
 #if MVM_SPESH_CHECK_PRESELECTION
     else {
         MVMint32 certain = -1;
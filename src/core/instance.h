@@ -282,17 +282,44 @@ struct MVMInstance {
     MVMint8 spesh_inline_log;
     MVMint8 spesh_osr_enabled;
     MVMint8 spesh_pea_enabled;
+    MVMint8 spesh_gvn_enabled;
+    MVMint8 spesh_licm_enabled;
+    MVMint8 spesh_bce_enabled;
+    MVMint8 spesh_vec_enabled;
+    MVMint8 spesh_unbox_enabled;
     MVMint8 spesh_nodelay;
     MVMint8 spesh_blocking;
+    MVMint8 spesh_adaptive_enabled;
 
     /* Number of specializations produced, and limit on number of
-     * specializations (zero if no limit). */
-    MVMint32 spesh_produced;
+     * specializations (zero if no limit). The count is bumped atomically,
+     * since several workers may be producing specializations. */
+    AO_t spesh_produced;
     MVMint32 spesh_limit;
 
+    /* The number of specialization worker threads. The first one receives
+     * the logs, updates statistics and forms the plan; the others are just
+     * helpers that take planned specializations and produce them. */
+    MVMuint32 spesh_num_workers;
+
+    /* In adaptive tiering mode, the percentage the specialization thresholds
+     * are scaled by; lowered while the worker is idle and raised while it has
+     * a backlog. Only touched by the main worker. */
+    MVMuint32 spesh_threshold_percent;
+
+    /* The number of logs waiting in the threads' log rings for the main
+     * worker to process them. */
+    AO_t spesh_logs_waiting;
+
+    /* The number of times any thread ran out of spesh log quota. */
+    AO_t spesh_log_quota_exhausted;
+
     /* Mutex taken when install specializations. */
     uv_mutex_t mutex_spesh_install;
 
+    /* Cache of specialization profiles from previous runs, if enabled. */
+    MVMSpeshProfileCache *spesh_profile_cache;
+
     /* The thread object representing the spesh thread */
     MVMObject *spesh_thread;
 
@@ -300,9 +327,28 @@ struct MVMInstance {
      * is enabled. */
     MVMObject *spesh_queue;
 
+    /* Array of thread objects for the helper workers, if any. */
+    MVMObject *spesh_helper_threads;
+
     /* The current specialization plan; hung off here so we can mark it. */
     MVMSpeshPlan *spesh_plan;
 
+    /* Lock protecting the distribution of the current plan between workers.
+     * Planned specializations are handed out in plan order, starting at
+     * spesh_plan_next, one depth tier at a time: only those before
+     * spesh_plan_tier_end can be claimed, and the next tier is opened once
+     * all of them have been produced. spesh_plan_outstanding counts those
+     * not yet produced. Workers wait on the ready condition for a plan or
+     * tier to show up, and the main worker waits on the done condition for
+     * the plan to be finished. */
+    uv_mutex_t mutex_spesh_plan;
+    uv_cond_t cond_spesh_plan_ready;
+    uv_cond_t cond_spesh_plan_done;
+    MVMuint32 spesh_plan_next;
+    MVMuint32 spesh_plan_tier_end;
+    MVMuint32 spesh_plan_outstanding;
+    MVMuint32 spesh_helpers_stop;
+
     /* The latest statistics version (incremented each time a spesh log is
      * received by the worker thread). */
     MVMuint32 spesh_stats_version;
@@ -332,6 +378,15 @@ struct MVMInstance {
     /* File for JIT perf map logging */
     FILE *jit_perf_map;
 
+    /* File for JIT perf jitdump logging, the mapping of it that perf looks
+     * for, and the index of the last code written to it */
+    FILE *jit_perf_dump;
+    void *jit_perf_dump_marker;
+    AO_t  jit_perf_dump_index;
+
+    /* Executable memory that JIT compiled code is placed in */
+    MVMJitCodeHeap *jit_code_heap;
+
     /* Directory name for JIT bytecode dumps */
     char *jit_bytecode_dir;
 
@@ -535,6 +590,7 @@ struct MVMInstance {
     MVMDebugServerData *debugserver;
 
     MVMuint32 speshworker_thread_id;
+    MVMuint32 *speshworker_helper_thread_ids;
 
     /* Log file for dynamic var performance, if we're to log it. */
     FILE *dynvar_log_fh;
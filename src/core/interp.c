@@ -6596,6 +6596,68 @@ void MVM_interp_run(MVMThreadContext *tc, void (*initial_invoke)(MVMThreadContex
                 cur_op += 8;
                 goto NEXT;
             }
+            OP(sp_atpos_i64): {
+                MVMArrayBody *body = &((MVMArray *)GET_REG(cur_op, 2).o)->body;
+                GET_REG(cur_op, 0).i64 = body->slots.i64[body->start + GET_REG(cur_op, 4).i64];
+                cur_op += 6;
+                goto NEXT;
+            }
+            OP(sp_atpos_n): {
+                MVMArrayBody *body = &((MVMArray *)GET_REG(cur_op, 2).o)->body;
+                GET_REG(cur_op, 0).n64 = body->slots.n64[body->start + GET_REG(cur_op, 4).i64];
+                cur_op += 6;
+                goto NEXT;
+            }
+            OP(sp_bindpos_i64): {
+                MVMObject *o = GET_REG(cur_op, 0).o;
+                MVMArrayBody *body = &((MVMArray *)o)->body;
+                body->slots.i64[body->start + GET_REG(cur_op, 2).i64] = GET_REG(cur_op, 4).i64;
+                MVM_SC_WB_OBJ(tc, o);
+                cur_op += 6;
+                goto NEXT;
+            }
+            OP(sp_bindpos_n): {
+                MVMObject *o = GET_REG(cur_op, 0).o;
+                MVMArrayBody *body = &((MVMArray *)o)->body;
+                body->slots.n64[body->start + GET_REG(cur_op, 2).i64] = GET_REG(cur_op, 4).n64;
+                MVM_SC_WB_OBJ(tc, o);
+                cur_op += 6;
+                goto NEXT;
+            }
+            OP(sp_vec_binop_n): {
+                MVMObject *o = GET_REG(cur_op, 0).o;
+                MVM_spesh_vec_binop_n(tc, o, GET_REG(cur_op, 2).o, GET_REG(cur_op, 4).o,
+                    GET_REG(cur_op, 6).i64, GET_REG(cur_op, 8).i64, GET_I16(cur_op, 10));
+                MVM_SC_WB_OBJ(tc, o);
+                cur_op += 12;
+                goto NEXT;
+            }
+            OP(sp_vec_binop_i): {
+                MVMObject *o = GET_REG(cur_op, 0).o;
+                MVM_spesh_vec_binop_i(tc, o, GET_REG(cur_op, 2).o, GET_REG(cur_op, 4).o,
+                    GET_REG(cur_op, 6).i64, GET_REG(cur_op, 8).i64, GET_I16(cur_op, 10));
+                MVM_SC_WB_OBJ(tc, o);
+                cur_op += 12;
+                goto NEXT;
+            }
+            OP(sp_vec_cmp_n): {
+                MVMObject *o = GET_REG(cur_op, 0).o;
+                MVM_spesh_vec_cmp_n(tc, o, GET_REG(cur_op, 2).o, GET_REG(cur_op, 4).o,
+                    GET_REG(cur_op, 6).i64, GET_REG(cur_op, 8).i64, GET_I16(cur_op, 10));
+                MVM_SC_WB_OBJ(tc, o);
+                cur_op += 12;
+                goto NEXT;
+            }
+            OP(sp_vec_sum_n):
+                GET_REG(cur_op, 0).n64 = MVM_spesh_vec_sum_n(tc, GET_REG(cur_op, 2).n64,
+                    GET_REG(cur_op, 4).o, GET_REG(cur_op, 6).i64, GET_REG(cur_op, 8).i64);
+                cur_op += 10;
+                goto NEXT;
+            OP(sp_vec_sum_i):
+                GET_REG(cur_op, 0).i64 = MVM_spesh_vec_sum_i(tc, GET_REG(cur_op, 2).i64,
+                    GET_REG(cur_op, 4).o, GET_REG(cur_op, 6).i64, GET_REG(cur_op, 8).i64);
+                cur_op += 10;
+                goto NEXT;
 #if MVM_CGOTO
             OP_CALL_EXTOP: {
                 /* Bounds checking? Never heard of that. */
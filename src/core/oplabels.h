@@ -920,15 +920,15 @@ static const void * const LABELS[] = {
     &&OP_ctw_check,
     &&OP_coverage_log,
     &&OP_breakpoint,
-    NULL,
-    NULL,
-    NULL,
-    NULL,
-    NULL,
-    NULL,
-    NULL,
-    NULL,
-    NULL,
+    &&OP_sp_atpos_i64,
+    &&OP_sp_atpos_n,
+    &&OP_sp_bindpos_i64,
+    &&OP_sp_bindpos_n,
+    &&OP_sp_vec_binop_n,
+    &&OP_sp_vec_binop_i,
+    &&OP_sp_vec_cmp_n,
+    &&OP_sp_vec_sum_n,
+    &&OP_sp_vec_sum_i,
     NULL,
     NULL,
     NULL,
@@ -920,6 +920,15 @@
 #define MVM_OP_ctw_check 916
 #define MVM_OP_coverage_log 917
 #define MVM_OP_breakpoint 918
+#define MVM_OP_sp_atpos_i64 919
+#define MVM_OP_sp_atpos_n 920
+#define MVM_OP_sp_bindpos_i64 921
+#define MVM_OP_sp_bindpos_n 922
+#define MVM_OP_sp_vec_binop_n 923
+#define MVM_OP_sp_vec_binop_i 924
+#define MVM_OP_sp_vec_cmp_n 925
+#define MVM_OP_sp_vec_sum_n 926
+#define MVM_OP_sp_vec_sum_i 927
 
 #define MVM_OP_EXT_BASE 1024
 #define MVM_OP_EXT_CU_LIMIT 1024
@@ -1,5 +1,41 @@
 #include "moar.h"
 
+/* Gets a block with a buffer of at least the specified size, taking it from
+ * the thread's pool of free blocks if the one at its head is big enough. */
+static MVMRegionBlock * obtain_block(MVMThreadContext *tc, size_t buffer_size) {
+    MVMRegionBlock *block = tc->region_pool;
+    if (block && (size_t)(block->limit - block->buffer) >= buffer_size) {
+        tc->region_pool       = block->prev;
+        tc->region_pool_size -= block->limit - block->buffer;
+    }
+    else {
+        block = MVM_malloc(sizeof(MVMRegionBlock));
+        block->buffer = MVM_calloc(1, buffer_size);
+        block->limit  = block->buffer + buffer_size;
+    }
+    block->alloc = block->buffer;
+    return block;
+}
+
+/* Gives a block back, putting it into the thread's pool if it is small
+ * enough and the pool has room for it, and freeing it otherwise. Only the
+ * part of the buffer that was used needs zeroing. */
+static void release_block(MVMThreadContext *tc, MVMRegionBlock *block) {
+    size_t buffer_size = block->limit - block->buffer;
+    if (tc->region_pool_enabled &&
+            buffer_size <= MVM_REGIONALLOC_POOL_MAX_BLOCK_SIZE &&
+            tc->region_pool_size + buffer_size <= MVM_REGIONALLOC_POOL_MAX_SIZE) {
+        memset(block->buffer, 0, block->alloc - block->buffer);
+        block->prev           = tc->region_pool;
+        tc->region_pool       = block;
+        tc->region_pool_size += buffer_size;
+    }
+    else {
+        MVM_free(block->buffer);
+        MVM_free(block);
+    }
+}
+
 void * MVM_region_alloc(MVMThreadContext *tc, MVMRegionAlloc *al, size_t bytes) {
     char *result = NULL;
 
@@ -13,17 +49,15 @@ void * MVM_region_alloc(MVMThreadContext *tc, MVMRegionAlloc *al, size_t bytes)
         al->block->alloc += bytes;
     } else {
         /* No block, or block was full. Add another. */
-        MVMRegionBlock *block = MVM_malloc(sizeof(MVMRegionBlock));
+        MVMRegionBlock *block;
         size_t buffer_size = al->block == NULL
             ? MVM_REGIONALLOC_FIRST_MEMBLOCK_SIZE
             : MVM_REGIONALLOC_MEMBLOCK_SIZE;
         if (buffer_size < bytes)
             buffer_size = bytes;
-        block->buffer = MVM_calloc(1, buffer_size);
-        block->alloc  = block->buffer;
-        block->limit  = block->buffer + buffer_size;
-        block->prev   = al->block;
-        al->block     = block;
+        block       = obtain_block(tc, buffer_size);
+        block->prev = al->block;
+        al->block   = block;
 
         /* Now allocate out of it. */
         result = block->alloc;
@@ -34,11 +68,10 @@ void * MVM_region_alloc(MVMThreadContext *tc, MVMRegionAlloc *al, size_t bytes)
 
 void MVM_region_destroy(MVMThreadContext *tc, MVMRegionAlloc *alloc) {
     MVMRegionBlock *block = alloc->block;
-    /* Free all of the allocated memory. */
+    /* Release all of the allocated memory. */
     while (block) {
         MVMRegionBlock *prev = block->prev;
-        MVM_free(block->buffer);
-        MVM_free(block);
+        release_block(tc, block);
         block = prev;
     }
     alloc->block = NULL;
@@ -55,3 +88,16 @@ void MVM_region_merge(MVMThreadContext *tc, MVMRegionAlloc *target, MVMRegionAll
     }
     source->block = NULL;
 }
+
+/* Frees the blocks in the thread's pool of free region blocks. */
+void MVM_region_pool_destroy(MVMThreadContext *tc) {
+    MVMRegionBlock *block = tc->region_pool;
+    while (block) {
+        MVMRegionBlock *prev = block->prev;
+        MVM_free(block->buffer);
+        MVM_free(block);
+        block = prev;
+    }
+    tc->region_pool      = NULL;
+    tc->region_pool_size = 0;
+}
@@ -22,6 +22,14 @@ struct MVMRegionAlloc {
 #define MVM_REGIONALLOC_FIRST_MEMBLOCK_SIZE 32768
 #define MVM_REGIONALLOC_MEMBLOCK_SIZE       8192
 
+/* When a region is destroyed, its blocks are kept in a per-thread pool to be
+ * handed out again, so building one spesh graph after another does not keep
+ * going back to malloc. Blocks larger than this are freed rather than pooled,
+ * as is anything beyond the maximum total size of the pool. */
+#define MVM_REGIONALLOC_POOL_MAX_BLOCK_SIZE 65536
+#define MVM_REGIONALLOC_POOL_MAX_SIZE       (4 * 1024 * 1024)
+
 void * MVM_region_alloc(MVMThreadContext *tc, MVMRegionAlloc *alloc, size_t s);
 void MVM_region_destroy(MVMThreadContext *tc, MVMRegionAlloc *alloc);
 void MVM_region_merge(MVMThreadContext *tc,  MVMRegionAlloc *target, MVMRegionAlloc *source);
+void MVM_region_pool_destroy(MVMThreadContext *tc);
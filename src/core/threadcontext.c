@@ -74,6 +74,7 @@ void MVM_tc_destroy(MVMThreadContext *tc) {
 
     /* Free specialization state. */
     MVM_spesh_sim_stack_destroy(tc, tc->spesh_sim_stack);
+    MVM_region_pool_destroy(tc);
 
     /* Free the nursery and finalization queue. */
 #if MVM_GC_DEBUG >= 3
@@ -224,11 +224,6 @@ struct MVMThreadContext {
      * one. */
     MVMSpeshLog *spesh_log;
 
-    /* How many spesh logs we can produce, inclusive of the current one.
-     * Ensures the spesh worker isn't overwhelmed with data before it has a
-     * change to produce some specializations. */
-    AO_t spesh_log_quota;
-
     /* The spesh stack simulation, perserved between processing logs. */
     MVMSpeshSimStack *spesh_sim_stack;
 
@@ -237,11 +232,13 @@ struct MVMThreadContext {
      * optimization process, giving less GC latency. */
     MVMSpeshGraph *spesh_active_graph;
 
-    /* We try to do better at OSR by creating a fresh log when we enter a new
-     * compilation unit. However, for things that EVAL or do a ton of BEGIN,
-     * we risk high memory use. Use this to throttle it by limiting the number
-     * of such extra logs that might exist at a time. */
-    AO_t num_compunit_extra_logs;
+    /* Pool of free blocks for region allocators, reused across the spesh
+     * graphs built on this thread, and the total size of their buffers. The
+     * blocks are kept zeroed, as they are when freshly allocated. Only the
+     * specialization worker threads keep such a pool. */
+    MVMRegionBlock *region_pool;
+    size_t region_pool_size;
+    MVMuint8 region_pool_enabled;
 
     /* The current specialization correlation ID, used in logging. */
     MVMuint32 spesh_cid;
@@ -259,6 +256,11 @@ struct MVMThreadContext {
     MVMint32 osr_hunt_frame_nr;
     MVMint32 osr_hunt_num_spesh_candidates;
 
+    /* If a candidate was found but could not be entered at the loop header
+     * we were at, the bytecode offset of that OSR point, so we try again at
+     * other loop headers of the frame; zero otherwise. */
+    MVMuint32 osr_hunt_failed_offset;
+
     /* If we are currently in a spesh plugin, the current set of guards we
      * have recorded. */
     MVMSpeshPluginGuard *plugin_guards;
@@ -587,7 +587,7 @@ MVM_PUBLIC void MVM_debugserver_notify_unhandled_exception(MVMThreadContext *tc,
 }
 
 static MVMuint8 is_thread_id_eligible(MVMInstance *vm, MVMuint32 id) {
-    if (id == vm->debugserver->thread_id || id == vm->speshworker_thread_id) {
+    if (id == vm->debugserver->thread_id || MVM_spesh_worker_is_worker_thread_id(vm, id)) {
         return 0;
     }
     return 1;
@@ -933,7 +933,7 @@ static void send_is_execution_suspended_info(MVMThreadContext *dtc, cmp_ctx_t *c
     while (cur_thread) {
         if ((MVM_load(&cur_thread->body.tc->gc_status) & MVMSUSPENDSTATUS_MASK) != MVMSuspendState_SUSPENDED
                 && cur_thread->body.thread_id != vm->debugserver->thread_id
-                && cur_thread->body.thread_id != vm->speshworker_thread_id) {
+                && !MVM_spesh_worker_is_worker_thread_id(vm, cur_thread->body.thread_id)) {
             result = 0;
             break;
         }
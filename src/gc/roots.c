@@ -92,6 +92,8 @@ void MVM_gc_root_add_instance_roots_to_worklist(MVMThreadContext *tc, MVMGCWorkl
         "Specialization thread");
     add_collectable(tc, worklist, snapshot, tc->instance->spesh_queue,
         "Specialization log queue");
+    add_collectable(tc, worklist, snapshot, tc->instance->spesh_helper_threads,
+        "Specialization helper threads");
 
     if (worklist)
         MVM_spesh_plan_gc_mark(tc, tc->instance->spesh_plan, worklist);
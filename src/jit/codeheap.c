@@ -0,0 +1,250 @@
+#include "moar.h"
+#include "platform/mmap.h"
+
+/* Sets up the code heap for the instance. */
+void MVM_jit_code_heap_init(MVMThreadContext *tc) {
+    MVMJitCodeHeap *heap = MVM_calloc(1, sizeof(MVMJitCodeHeap));
+    int init_stat;
+    if ((init_stat = uv_mutex_init(&heap->mutex)) < 0) {
+        fprintf(stderr, "MoarVM: Initialization of JIT code heap mutex failed\n    %s\n",
+            uv_strerror(init_stat));
+        exit(1);
+    }
+    tc->instance->jit_code_heap = heap;
+}
+
+/* Finds the chunk that a piece of code lives in, if any. */
+static MVMJitCodeChunk * find_chunk(MVMJitCodeHeap *heap, void *code) {
+    MVMJitCodeChunk *chunk = heap->chunks;
+    while (chunk) {
+        if ((char *)code >= chunk->exec_base && (char *)code < chunk->exec_base + chunk->size)
+            return chunk;
+        chunk = chunk->next;
+    }
+    return NULL;
+}
+
+/* Tries to take space for code from a chunk's free list. */
+static MVMint32 alloc_from_free_list(MVMJitCodeChunk *chunk, size_t size, size_t *offset) {
+    MVMJitCodeFreeBlock *prev = NULL;
+    MVMJitCodeFreeBlock *block = chunk->free_list;
+    while (block) {
+        if (block->size >= size) {
+            *offset = block->offset;
+            if (block->size == size) {
+                if (prev)
+                    prev->next = block->next;
+                else
+                    chunk->free_list = block->next;
+                MVM_free(block);
+            }
+            else {
+                block->offset += size;
+                block->size   -= size;
+            }
+            return 1;
+        }
+        prev  = block;
+        block = block->next;
+    }
+    return 0;
+}
+
+/* Returns space to a chunk's free list, merging it with its neighbours. */
+static void add_to_free_list(MVMJitCodeChunk *chunk, size_t offset, size_t size) {
+    MVMJitCodeFreeBlock *prev = NULL;
+    MVMJitCodeFreeBlock *next = chunk->free_list;
+    while (next && next->offset < offset) {
+        prev = next;
+        next = next->next;
+    }
+    if (prev && prev->offset + prev->size == offset) {
+        prev->size += size;
+        if (next && prev->offset + prev->size == next->offset) {
+            prev->size += next->size;
+            prev->next  = next->next;
+            MVM_free(next);
+        }
+    }
+    else if (next && offset + size == next->offset) {
+        next->offset  = offset;
+        next->size   += size;
+    }
+    else {
+        MVMJitCodeFreeBlock *block = MVM_malloc(sizeof(MVMJitCodeFreeBlock));
+        block->offset = offset;
+        block->size   = size;
+        block->next   = next;
+        if (prev)
+            prev->next = block;
+        else
+            chunk->free_list = block;
+    }
+
+    /* If the last free block runs up to the bump pointer, give it back to
+     * that. */
+    {
+        MVMJitCodeFreeBlock *before = NULL;
+        MVMJitCodeFreeBlock *last = chunk->free_list;
+        while (last->next) {
+            before = last;
+            last = last->next;
+        }
+        if (last->offset + last->size == chunk->used) {
+            chunk->used = last->offset;
+            if (before)
+                before->next = NULL;
+            else
+                chunk->free_list = NULL;
+            MVM_free(last);
+        }
+    }
+}
+
+/* Unmaps a chunk and frees its free list. */
+static void destroy_chunk(MVMJitCodeChunk *chunk) {
+    MVMJitCodeFreeBlock *block = chunk->free_list;
+    while (block) {
+        MVMJitCodeFreeBlock *next = block->next;
+        MVM_free(block);
+        block = next;
+    }
+    MVM_platform_free_dual_pages(chunk->write_base, chunk->exec_base, chunk->size);
+    MVM_free(chunk);
+}
+
+/* Allocates space for code of the given size. Returns the address the code
+ * will be run from, and sets writable to the address the code should be
+ * written to; these may differ, so the code must only refer to itself using
+ * relative addressing. Once the code is written, MVM_jit_code_heap_seal must
+ * be called to make it executable. */
+void * MVM_jit_code_heap_alloc(MVMThreadContext *tc, size_t size, void **writable) {
+    MVMJitCodeHeap *heap = tc->instance->jit_code_heap;
+    size_t alloc_size = (size + MVM_JIT_CODE_ALIGN - 1) & ~(size_t)(MVM_JIT_CODE_ALIGN - 1);
+    MVMJitCodeChunk *chunk = NULL;
+    size_t offset = 0;
+    void *code;
+
+    uv_mutex_lock(&heap->mutex);
+    if (!heap->chunks_unavailable && alloc_size <= MVM_JIT_CODE_CHUNK_SIZE / 4) {
+        /* Look for space freed by discarded code first, then try to bump
+         * allocate in the current chunk. */
+        MVMJitCodeChunk *cur = heap->chunks;
+        while (cur) {
+            if (alloc_from_free_list(cur, alloc_size, &offset)) {
+                chunk = cur;
+                break;
+            }
+            cur = cur->next;
+        }
+        if (!chunk && heap->chunks &&
+                heap->chunks->size - heap->chunks->used >= alloc_size) {
+            chunk = heap->chunks;
+            offset = chunk->used;
+            chunk->used += alloc_size;
+        }
+
+        /* Otherwise, make a new chunk. */
+        if (!chunk) {
+            void *write_base, *exec_base;
+            if (MVM_platform_alloc_dual_pages(MVM_JIT_CODE_CHUNK_SIZE, &write_base, &exec_base)) {
+                chunk = MVM_calloc(1, sizeof(MVMJitCodeChunk));
+                chunk->write_base = write_base;
+                chunk->exec_base  = exec_base;
+                chunk->size       = MVM_JIT_CODE_CHUNK_SIZE;
+                chunk->used       = alloc_size;
+                chunk->next       = heap->chunks;
+                heap->chunks      = chunk;
+                offset            = 0;
+            }
+            else {
+                if (tc->instance->jit_debug_enabled)
+                    fprintf(stderr, "JIT: Could not map code heap chunk, using separate pages\n");
+                heap->chunks_unavailable = 1;
+            }
+        }
+    }
+
+    if (chunk) {
+        /* Open up the chunk for writing. */
+        if (chunk->writers++ == 0)
+            MVM_platform_set_page_mode(chunk->write_base, chunk->size,
+                MVM_PAGE_READ|MVM_PAGE_WRITE);
+        chunk->live += alloc_size;
+        code = chunk->exec_base + offset;
+        *writable = chunk->write_base + offset;
+    }
+    else {
+        /* Too big for a chunk, or no chunks available; give the code its
+         * own pages. */
+        code = MVM_platform_alloc_pages(size, MVM_PAGE_READ|MVM_PAGE_WRITE);
+        *writable = code;
+    }
+    uv_mutex_unlock(&heap->mutex);
+    return code;
+}
+
+/* Marks that code has been written, making it executable. Returns zero if
+ * this was not possible. */
+MVMint32 MVM_jit_code_heap_seal(MVMThreadContext *tc, void *code, size_t size) {
+    MVMJitCodeHeap *heap = tc->instance->jit_code_heap;
+    MVMJitCodeChunk *chunk;
+    MVMint32 result = 1;
+    uv_mutex_lock(&heap->mutex);
+    chunk = find_chunk(heap, code);
+    if (chunk) {
+        /* The code is already executable through the other view, so just
+         * close the writable one if we're the last writer. */
+        if (--chunk->writers == 0)
+            result = MVM_platform_set_page_mode(chunk->write_base, chunk->size,
+                MVM_PAGE_NONE);
+    }
+    else {
+        result = MVM_platform_set_page_mode(code, size, MVM_PAGE_READ|MVM_PAGE_EXEC);
+    }
+    uv_mutex_unlock(&heap->mutex);
+    return result;
+}
+
+/* Frees code, so its space can be reused. */
+void MVM_jit_code_heap_free(MVMThreadContext *tc, void *code, size_t size) {
+    MVMJitCodeHeap *heap = tc->instance->jit_code_heap;
+    MVMJitCodeChunk *chunk;
+    uv_mutex_lock(&heap->mutex);
+    chunk = find_chunk(heap, code);
+    if (chunk) {
+        size_t alloc_size = (size + MVM_JIT_CODE_ALIGN - 1) & ~(size_t)(MVM_JIT_CODE_ALIGN - 1);
+        add_to_free_list(chunk, (char *)code - chunk->exec_base, alloc_size);
+        chunk->live -= alloc_size;
+
+        /* Unmap chunks with nothing left in them, other than the one we
+         * are bump allocating from. */
+        if (chunk->live == 0 && chunk != heap->chunks && chunk->writers == 0) {
+            MVMJitCodeChunk *prev = heap->chunks;
+            while (prev->next != chunk)
+                prev = prev->next;
+            prev->next = chunk->next;
+            destroy_chunk(chunk);
+        }
+    }
+    else {
+        MVM_platform_free_pages(code, size);
+    }
+    uv_mutex_unlock(&heap->mutex);
+}
+
+/* Frees all of the code heap memory. */
+void MVM_jit_code_heap_destroy(MVMThreadContext *tc) {
+    MVMJitCodeHeap *heap = tc->instance->jit_code_heap;
+    if (heap) {
+        MVMJitCodeChunk *chunk = heap->chunks;
+        while (chunk) {
+            MVMJitCodeChunk *next = chunk->next;
+            destroy_chunk(chunk);
+            chunk = next;
+        }
+        uv_mutex_destroy(&heap->mutex);
+        MVM_free(heap);
+        tc->instance->jit_code_heap = NULL;
+    }
+}
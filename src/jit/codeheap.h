@@ -0,0 +1,64 @@
+/* The JIT code heap. Rather than giving every piece of compiled code its own
+ * mapping, which wastes most of a page on small frames, code is packed into
+ * shared chunks. Each chunk is mapped twice: an executable view that code is
+ * run from, and a writable view that is only accessible while some thread is
+ * writing code into the chunk. Space freed by discarded code is reused, and
+ * chunks are unmapped once all of the code in them has gone. Where mapping
+ * memory twice is not supported, code gets its own pages as before. */
+struct MVMJitCodeHeap {
+    /* Protects all of the below. */
+    uv_mutex_t mutex;
+
+    /* Chunks of code memory; the first one is the one we bump allocate
+     * from. */
+    MVMJitCodeChunk *chunks;
+
+    /* Whether we failed to set up a chunk, and so should give up on
+     * trying to. */
+    MVMuint8 chunks_unavailable;
+};
+
+/* A chunk of the code heap. */
+struct MVMJitCodeChunk {
+    /* The executable and writable views of the chunk memory. */
+    char *exec_base;
+    char *write_base;
+
+    /* The size of the chunk and how much of it has been bump allocated. */
+    size_t size;
+    size_t used;
+
+    /* The number of bytes in live allocations. */
+    size_t live;
+
+    /* The number of threads currently writing code into the chunk; the
+     * writable view is accessible while this is non-zero. */
+    MVMuint32 writers;
+
+    /* Free space within the bump allocated area, sorted by offset. */
+    MVMJitCodeFreeBlock *free_list;
+
+    /* The next chunk. */
+    MVMJitCodeChunk *next;
+};
+
+/* A free block in a code heap chunk. These are kept outside of the chunk
+ * memory, since that is not usually writable. */
+struct MVMJitCodeFreeBlock {
+    size_t offset;
+    size_t size;
+    MVMJitCodeFreeBlock *next;
+};
+
+/* The size of a code heap chunk. Code bigger than a quarter of that gets its
+ * own pages instead. */
+#define MVM_JIT_CODE_CHUNK_SIZE     (1024 * 1024)
+
+/* The alignment of code in a chunk. */
+#define MVM_JIT_CODE_ALIGN          16
+
+void MVM_jit_code_heap_init(MVMThreadContext *tc);
+void * MVM_jit_code_heap_alloc(MVMThreadContext *tc, size_t size, void **writable);
+MVMint32 MVM_jit_code_heap_seal(MVMThreadContext *tc, void *code, size_t size);
+void MVM_jit_code_heap_free(MVMThreadContext *tc, void *code, size_t size);
+void MVM_jit_code_heap_destroy(MVMThreadContext *tc);
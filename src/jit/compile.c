@@ -14,8 +14,8 @@ void MVM_jit_compile_expr_tree(MVMThreadContext *tc, MVMJitCompiler *compiler, M
 static const MVMuint16 MAGIC_BYTECODE[] = { MVM_OP_sp_jit_enter, 0 };
 
 void MVM_jit_compiler_init(MVMThreadContext *tc, MVMJitCompiler *cl, MVMJitGraph *jg) {
-    /* Create dasm state */
-    dasm_init(cl, 2);
+    /* Create dasm state, with sections for inline code, cold code and data */
+    dasm_init(cl, 3);
     dasm_setupglobal(cl, cl->dasm_globals, MVM_JIT_MAX_GLOBALS);
     dasm_setup(cl, MVM_jit_actions());
 
@@ -23,6 +23,8 @@ void MVM_jit_compiler_init(MVMThreadContext *tc, MVMJitCompiler *cl, MVMJitGraph
     cl->graph        = jg;
     /* next (internal) label to assign */
     cl->label_offset = jg->num_labels;
+    /* start out emitting inline code */
+    cl->cold         = 0;
     /* space for dynamic labels */
     dasm_growpc(cl, jg->num_labels);
 
@@ -106,8 +108,14 @@ MVMJitCode * MVM_jit_compile_graph(MVMThreadContext *tc, MVMJitGraph *jg) {
         MVM_free(file_location);
         MVM_free(frame_name);
     }
+    if (tc->instance->jit_perf_dump && code && jg->sg->sf)
+        MVM_jit_perf_dump_code(tc, jg, code);
 #endif
 
+    /* Let GDB know about the code, so it can name and unwind through it */
+    if (code)
+        MVM_jit_gdb_register(tc, jg, code);
+
     /* Logging for insight */
     if (MVM_jit_bytecode_dump_enabled(tc))
         MVM_jit_dump_bytecode(tc, code);
@@ -119,6 +127,7 @@ MVMJitCode * MVM_jit_compiler_assemble(MVMThreadContext *tc, MVMJitCompiler *cl,
     MVMJitCode * code;
     MVMint32 i;
     char * memory;
+    void * writable;
     size_t codesize;
 
     MVMint32 dasm_error = 0;
@@ -130,15 +139,20 @@ MVMJitCode * MVM_jit_compiler_assemble(MVMThreadContext *tc, MVMJitCompiler *cl,
         return NULL;
     }
 
-    memory = MVM_platform_alloc_pages(codesize, MVM_PAGE_READ|MVM_PAGE_WRITE);
-    if ((dasm_error = dasm_encode(cl, memory)) != 0) {
+    /* The code heap may hand us a different address to write the code to
+     * than the one it will run from; our code only ever refers to itself
+     * relative to the instruction pointer, so that is fine. */
+    memory = MVM_jit_code_heap_alloc(tc, codesize, &writable);
+    if ((dasm_error = dasm_encode(cl, writable)) != 0) {
         if (tc->instance->jit_debug_enabled)
             fprintf(stderr, "DynASM could not encode, error: %d\n", dasm_error);
+        MVM_jit_code_heap_seal(tc, memory, codesize);
+        MVM_jit_code_heap_free(tc, memory, codesize);
         return NULL;
     }
 
     /* set memory readable + executable */
-    if (!MVM_platform_set_page_mode(memory, codesize, MVM_PAGE_READ|MVM_PAGE_EXEC)) {
+    if (!MVM_jit_code_heap_seal(tc, memory, codesize)) {
         if (tc->instance->jit_debug_enabled)
             fprintf(stderr, "JIT: Impossible to mark code read/executable");
         /* our caller allocated the compiler and our caller must clean it up */
@@ -160,6 +174,7 @@ MVMJitCode * MVM_jit_compiler_assemble(MVMThreadContext *tc, MVMJitCompiler *cl,
     code->ref_cnt      = 1;
 
     code->sf         = jg->sg->sf;
+    code->gdb_entry  = NULL;
     code->spill_size = cl->spills_num;
     if (cl->spills_num > 0) {
         MVMint32 sg_num_locals = jg->sg->num_locals;
@@ -193,7 +208,7 @@ MVMJitCode * MVM_jit_compiler_assemble(MVMThreadContext *tc, MVMJitCompiler *cl,
         code->labels[i] = memory + offset;
     }
     /* We only ever use one global label, which is the exit label */
-    code->exit_label = cl->dasm_globals[0];
+    code->exit_label = memory + ((char *)cl->dasm_globals[0] - (char *)writable);
 
     /* Copy the deopts, inlines, and handlers. Because these use the
      * label index rather than the direct pointer, no fixup is
@@ -217,7 +232,8 @@ MVMJitCode* MVM_jit_code_copy(MVMThreadContext *tc, MVMJitCode * const code) {
 void MVM_jit_code_destroy(MVMThreadContext *tc, MVMJitCode *code) {
     if (AO_fetch_and_sub1(&code->ref_cnt) > 0)
         return;
-    MVM_platform_free_pages(code->func_ptr, code->size);
+    MVM_jit_gdb_unregister(tc, code);
+    MVM_jit_code_heap_free(tc, code->func_ptr, code->size);
     MVM_free(code->labels);
     MVM_free(code->deopts);
     MVM_free(code->handlers);
@@ -247,6 +263,12 @@ void MVM_jit_compile_label(MVMThreadContext *tc, MVMJitCompiler *compiler,
     MVM_jit_emit_label(tc, compiler, tree->graph, tile->args[0]);
 }
 
+void MVM_jit_compile_section_label(MVMThreadContext *tc, MVMJitCompiler *compiler,
+                                   MVMJitTile *tile, MVMJitExprTree *tree) {
+    MVM_jit_emit_section(tc, compiler, tile->args[1]);
+    MVM_jit_emit_label(tc, compiler, tree->graph, tile->args[0]);
+}
+
 void MVM_jit_compile_store(MVMThreadContext *tc, MVMJitCompiler *compiler,
                            MVMJitTile *tile, MVMJitExprTree *tree) {
     MVM_jit_emit_store(tc, compiler, tile->args[0], tile->args[1], tile->values[1], sizeof(MVMRegister));
@@ -291,6 +313,9 @@ void MVM_jit_compile_expr_tree(MVMThreadContext *tc, MVMJitCompiler *compiler, M
     /* Second stage, allocate registers */
     MVM_jit_linear_scan_allocate(tc, compiler, list);
 
+    /* Remove redundant moves, tests and jumps */
+    MVM_jit_tile_list_peephole(tc, list);
+
     /* Allocate sufficient space for the new internal labels */
     dasm_growpc(compiler, compiler->label_offset);
 
@@ -26,6 +26,9 @@ struct MVMJitCode {
     MVMint32       spill_size;
     MVMint32       seq_nr;
 
+    /* Registration of this code with GDB */
+    MVMJitGDBCodeEntry *gdb_entry;
+
     AO_t ref_cnt;
 };
 
@@ -37,6 +40,8 @@ void MVM_jit_code_destroy(MVMThreadContext *tc, MVMJitCode *code);
 /* Peseudotile compile functions */
 void MVM_jit_compile_label(MVMThreadContext *tc, MVMJitCompiler *compiler,
                            MVMJitTile *tile, MVMJitExprTree *tree);
+void MVM_jit_compile_section_label(MVMThreadContext *tc, MVMJitCompiler *compiler,
+                                   MVMJitTile *tile, MVMJitExprTree *tree);
 void MVM_jit_compile_branch(MVMThreadContext *tc, MVMJitCompiler *compiler,
                             MVMJitTile *tile, MVMJitExprTree *tree);
 void MVM_jit_compile_conditional_branch(MVMThreadContext *tc, MVMJitCompiler *compiler,
@@ -649,10 +649,79 @@ static void active_values_flush(MVMThreadContext *tc, MVMJitExprTree *tree,
     }
 }
 
+/* insert stores for all the active unstored values, but keep them available
+ * for use later in the tree; for when memory must be up to date but control
+ * flow doesn't leave the tree, like a guard that passes */
+static void active_values_store(MVMThreadContext *tc, MVMJitExprTree *tree,
+                                struct ValueDefinition *values, MVMint32 num_values) {
+    MVMint32 i;
+    for (i = 0; i < num_values; i++) {
+        if (values[i].root >= 0) {
+            tree->roots[values[i].root] = MVM_jit_expr_add_store(tc, tree, values[i].addr, values[i].node, MVM_JIT_REG_SZ);
+            values[i].root = -1;
+        }
+    }
+}
+
 static MVMint32 tree_is_empty(MVMThreadContext *tc, MVMJitExprTree *tree) {
     return MVM_VECTOR_ELEMS(tree->nodes) == 0;
 }
 
+/* Whether the tree can carry on into the basic block that follows this one,
+ * keeping the values computed so far in registers. This is only the case if
+ * that block can only be entered by falling through from this one, so that
+ * nothing jumps into the middle of the tree. */
+static MVMint32 can_extend_tree(MVMThreadContext *tc, MVMJitGraph *jg, MVMSpeshBB *bb) {
+    MVMSpeshBB *next = bb->linear_next;
+    MVMSpeshIns *last = bb->last_ins;
+    MVMint32 i;
+    if (!next || next->num_pred != 1 || next->pred[0] != bb)
+        return 0;
+    /* Bisection and breakpoints work per basic block */
+    if (tc->instance->jit_expr_last_frame >= 0 || tc->instance->jit_breakpoints_num > 0)
+        return 0;
+    if (last) {
+        if (last->info->opcode == MVM_OP_goto || last->info->opcode == MVM_OP_jumplist)
+            return 0;
+        for (i = 0; i < last->info->num_operands; i++) {
+            if ((last->info->operands[i] & MVM_operand_type_mask) == MVM_operand_ins &&
+                    last->operands[i].ins_bb == next)
+                return 0;
+        }
+    }
+    return 1;
+}
+
+/* Whether an instruction may branch elsewhere. */
+static MVMint32 ins_may_branch(MVMThreadContext *tc, MVMSpeshIns *ins) {
+    MVMint32 i;
+    for (i = 0; i < ins->info->num_operands; i++)
+        if ((ins->info->operands[i] & MVM_operand_type_mask) == MVM_operand_ins)
+            return 1;
+    return 0;
+}
+
+/* Moves on to the next instruction, carrying on into the next basic block if
+ * we can. The label of that block is added to the tree, since it will not
+ * get one of its own. If the block we leave ends in a conditional branch,
+ * the branch target reads the values from memory, so all values computed
+ * so far are stored before we carry on (while keeping them available, since
+ * the next block may still use them). */
+static MVMSpeshIns * next_ins(MVMThreadContext *tc, MVMJitGraph *jg, MVMSpeshIterator *iter,
+                              MVMJitExprTree *tree, struct ValueDefinition *values) {
+    MVMSpeshIns *ins = MVM_spesh_iterator_next_ins(tc, iter);
+    if (ins == NULL && !tree_is_empty(tc, tree) && can_extend_tree(tc, jg, iter->bb)) {
+        MVMSpeshIns *last = iter->bb->last_ins;
+        if (last && ins_may_branch(tc, last))
+            active_values_store(tc, tree, values, jg->sg->num_locals);
+        MVM_spesh_iterator_next_bb(tc, iter);
+        MVM_VECTOR_PUSH(tree->roots, MVM_jit_expr_add_label(tc, tree,
+            MVM_jit_label_before_bb(tc, jg, iter->bb)));
+        ins = iter->ins;
+    }
+    return ins;
+}
+
 MVMJitExprTree * MVM_jit_expr_tree_build(MVMThreadContext *tc, MVMJitGraph *jg, MVMSpeshIterator *iter) {
     MVMSpeshGraph *sg = jg->sg;
     MVMSpeshIns *entry = iter->ins;
@@ -690,7 +759,7 @@ MVMJitExprTree * MVM_jit_expr_tree_build(MVMThreadContext *tc, MVMJitGraph *jg,
        internally linked together (relative to absolute indexes).
        Afterwards stores are inserted for computed values. */
 
-    for (ins = iter->ins; ins != NULL; ins = MVM_spesh_iterator_next_ins(tc, iter)) {
+    for (ins = iter->ins; ins != NULL; ins = next_ins(tc, jg, iter, tree, values)) {
         /* NB - we probably will want to involve the spesh info in selecting a
            template. And for optimisation, I'd like to copy spesh facts (if any)
            to the tree info */
@@ -795,13 +864,17 @@ MVMJitExprTree * MVM_jit_expr_tree_build(MVMThreadContext *tc, MVMJitGraph *jg,
         case MVM_OP_sp_guardtype:
         case MVM_OP_sp_guardobj:
         case MVM_OP_sp_guardnotobj:
-        case MVM_OP_sp_rebless:
         case MVM_OP_sp_guardsf:
         case MVM_OP_sp_guardsfouter:
         case MVM_OP_sp_guardjustconc:
         case MVM_OP_sp_guardjusttype:
             /* If we deopt, then all values must be stored to memory, otherwise
-             * the interpreter can't see them */
+             * the interpreter can't see them. If we don't, they are still
+             * good to use from registers. */
+            active_values_store(tc, tree, values, sg->num_locals);
+            break;
+        case MVM_OP_sp_rebless:
+            /* This calls into the VM, which may move the objects we hold */
             active_values_flush(tc, tree, values, sg->num_locals);
             break;
         default:
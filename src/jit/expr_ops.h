@@ -73,6 +73,8 @@
     _(CARG, 1, 1),     \
     /* special constrol structures */ \
     _(GUARD, 1, 2),  \
+    /* deoptimize and leave the frame */ \
+    _(DEOPT, 1, 0), \
     /* interpreter special variables */ \
     _(TC, 0, 0), \
     _(CU, 0, 0), \
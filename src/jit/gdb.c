@@ -0,0 +1,321 @@
+#include "moar.h"
+
+/* GDB puts a breakpoint on this function, and reads the descriptor when it
+ * is hit. Both are looked up by name, so must not be renamed. */
+MVM_PUBLIC MVMJitGDBDescriptor __jit_debug_descriptor = { 1, MVM_JIT_GDB_NOACTION, NULL, NULL };
+
+#ifdef _MSC_VER
+MVM_PUBLIC __declspec(noinline) void __jit_debug_register_code(void) {
+#else
+MVM_PUBLIC __attribute__((noinline)) void __jit_debug_register_code(void) {
+    __asm__ volatile("");
+#endif
+}
+
+/* The descriptor is shared by the whole process, so updates to it are made
+ * under a lock. */
+static uv_once_t gdb_lock_initialized = UV_ONCE_INIT;
+static uv_mutex_t gdb_lock;
+static void init_gdb_lock(void) {
+    uv_mutex_init(&gdb_lock);
+}
+
+/* The ELF object we build for each piece of code. */
+typedef struct {
+    MVM_VECTOR_DECL(char, bytes);
+} ELFBuffer;
+
+static void emit(ELFBuffer *elf, const void *data, size_t size) {
+    MVM_VECTOR_APPEND(elf->bytes, (const char *)data, size);
+}
+static void emit_u8(ELFBuffer *elf, MVMuint8 value) {
+    emit(elf, &value, sizeof(MVMuint8));
+}
+static void emit_u16(ELFBuffer *elf, MVMuint16 value) {
+    emit(elf, &value, sizeof(MVMuint16));
+}
+static void emit_u32(ELFBuffer *elf, MVMuint32 value) {
+    emit(elf, &value, sizeof(MVMuint32));
+}
+static void emit_u64(ELFBuffer *elf, MVMuint64 value) {
+    emit(elf, &value, sizeof(MVMuint64));
+}
+static void emit_uleb128(ELFBuffer *elf, MVMuint32 value) {
+    do {
+        MVMuint8 byte = value & 0x7F;
+        value >>= 7;
+        if (value)
+            byte |= 0x80;
+        emit_u8(elf, byte);
+    } while (value);
+}
+static void emit_sleb128(ELFBuffer *elf, MVMint32 value) {
+    MVMint32 more = 1;
+    while (more) {
+        MVMuint8 byte = value & 0x7F;
+        value >>= 7;
+        if ((value == 0 && !(byte & 0x40)) || (value == -1 && (byte & 0x40)))
+            more = 0;
+        else
+            byte |= 0x80;
+        emit_u8(elf, byte);
+    }
+}
+static void align(ELFBuffer *elf, size_t alignment, MVMuint8 fill) {
+    while (elf->bytes_num % alignment)
+        emit_u8(elf, fill);
+}
+static void patch_u32(ELFBuffer *elf, size_t offset, MVMuint32 value) {
+    memcpy(elf->bytes + offset, &value, sizeof(MVMuint32));
+}
+static void patch_u64(ELFBuffer *elf, size_t offset, MVMuint64 value) {
+    memcpy(elf->bytes + offset, &value, sizeof(MVMuint64));
+}
+
+/* Sections of the ELF object. */
+#define SECT_NULL       0
+#define SECT_TEXT       1
+#define SECT_EH_FRAME   2
+#define SECT_SHSTRTAB   3
+#define SECT_STRTAB     4
+#define SECT_SYMTAB     5
+#define NUM_SECTS       6
+
+/* DWARF call frame instructions and registers we use. */
+#define DW_CFA_nop              0x00
+#define DW_CFA_advance_loc4     0x04
+#define DW_CFA_def_cfa          0x0c
+#define DW_CFA_def_cfa_register 0x0d
+#define DW_CFA_def_cfa_offset   0x0e
+#define DW_CFA_advance_loc      0x40
+#define DW_CFA_offset           0x80
+#define DW_EH_PE_udata4         0x03
+#define DW_EH_PE_textrel        0x20
+#define DW_REG_RBX              3
+#define DW_REG_RBP              6
+#define DW_REG_RSP              7
+#define DW_REG_R13              13
+#define DW_REG_R14              14
+#define DW_REG_RA               16
+
+/* Emits the unwind information. Our prologue is always:
+ *
+ *   push rbp            ; 1 byte
+ *   mov rbp, rsp        ; 3 bytes
+ *   sub rsp, 0x100
+ *   mov [rbp-0x8], r14  ; TC
+ *   mov [rbp-0x10], r13 ; CU
+ *   mov [rbp-0x18], rbx ; WORK
+ *   ...
+ *
+ * So after the first four bytes the frame is addressed from rbp, and by the
+ * time we reach the first label the callee-save registers have been stored.
+ * The epilogue restores them in place, so we don't describe it. */
+static void emit_eh_frame(ELFBuffer *elf, MVMuint32 code_size, MVMuint32 body_start) {
+    size_t cie_start, cie_length, fde_start, fde_length;
+
+    /* Common information entry. */
+    cie_length = elf->bytes_num;
+    emit_u32(elf, 0); /* Length, patched below */
+    cie_start = elf->bytes_num;
+    emit_u32(elf, 0); /* CIE id */
+    emit_u8(elf, 1);  /* Version */
+    emit(elf, "zR", 3);
+    emit_uleb128(elf, 1);  /* Code alignment factor */
+    emit_sleb128(elf, -8); /* Data alignment factor */
+    emit_uleb128(elf, DW_REG_RA);
+    emit_uleb128(elf, 1);  /* Augmentation data length */
+    emit_u8(elf, DW_EH_PE_textrel | DW_EH_PE_udata4);
+    emit_u8(elf, DW_CFA_def_cfa);
+    emit_uleb128(elf, DW_REG_RSP);
+    emit_uleb128(elf, 8);
+    emit_u8(elf, DW_CFA_offset | DW_REG_RA);
+    emit_uleb128(elf, 1);
+    align(elf, 8, DW_CFA_nop);
+    patch_u32(elf, cie_length, elf->bytes_num - cie_start);
+
+    /* Frame description entry covering all of the code. */
+    fde_length = elf->bytes_num;
+    emit_u32(elf, 0); /* Length, patched below */
+    fde_start = elf->bytes_num;
+    emit_u32(elf, fde_start - cie_length); /* Offset back to the CIE */
+    emit_u32(elf, 0); /* Start, relative to .text */
+    emit_u32(elf, code_size);
+    emit_uleb128(elf, 0); /* Augmentation data length */
+    emit_u8(elf, DW_CFA_advance_loc | 1);
+    emit_u8(elf, DW_CFA_def_cfa_offset);
+    emit_uleb128(elf, 16);
+    emit_u8(elf, DW_CFA_offset | DW_REG_RBP);
+    emit_uleb128(elf, 2);
+    emit_u8(elf, DW_CFA_advance_loc | 3);
+    emit_u8(elf, DW_CFA_def_cfa_register);
+    emit_uleb128(elf, DW_REG_RBP);
+    if (body_start > 4) {
+        emit_u8(elf, DW_CFA_advance_loc4);
+        emit_u32(elf, body_start - 4);
+        emit_u8(elf, DW_CFA_offset | DW_REG_R14);
+        emit_uleb128(elf, 3);
+        emit_u8(elf, DW_CFA_offset | DW_REG_R13);
+        emit_uleb128(elf, 4);
+        emit_u8(elf, DW_CFA_offset | DW_REG_RBX);
+        emit_uleb128(elf, 5);
+    }
+    align(elf, 8, DW_CFA_nop);
+    patch_u32(elf, fde_length, elf->bytes_num - fde_start);
+
+    /* Terminator. */
+    emit_u32(elf, 0);
+}
+
+/* Emits a symbol table entry. */
+static void emit_symbol(ELFBuffer *elf, MVMuint32 name, MVMuint8 info, MVMuint16 section,
+        MVMuint64 value, MVMuint64 size) {
+    emit_u32(elf, name);
+    emit_u8(elf, info);
+    emit_u8(elf, 0); /* Visibility */
+    emit_u16(elf, section);
+    emit_u64(elf, value);
+    emit_u64(elf, size);
+}
+
+/* Emits a section header. */
+static void emit_section_header(ELFBuffer *elf, MVMuint32 name, MVMuint32 type,
+        MVMuint64 flags, MVMuint64 addr, MVMuint64 offset, MVMuint64 size,
+        MVMuint32 link, MVMuint32 info, MVMuint64 alignment, MVMuint64 entsize) {
+    emit_u32(elf, name);
+    emit_u32(elf, type);
+    emit_u64(elf, flags);
+    emit_u64(elf, addr);
+    emit_u64(elf, offset);
+    emit_u64(elf, size);
+    emit_u32(elf, link);
+    emit_u32(elf, info);
+    emit_u64(elf, alignment);
+    emit_u64(elf, entsize);
+}
+
+/* Builds an ELF object describing the code. The code itself is not in it;
+ * the .text section just says where it lives. */
+static void build_elf(MVMThreadContext *tc, ELFBuffer *elf, MVMJitCode *code,
+        const char *symbol_name) {
+    static const char shstrtab[] = "\0.text\0.eh_frame\0.shstrtab\0.strtab\0.symtab";
+    MVMuint32 body_start = (char *)code->labels[0] - (char *)code->func_ptr;
+    size_t eh_frame_offset, eh_frame_size, shstrtab_offset, strtab_offset, strtab_size,
+           symtab_offset, shoff_pos, sh_offset;
+
+    /* ELF header. */
+    emit(elf, "\177ELF", 4);
+    emit_u8(elf, 2); /* 64-bit */
+    emit_u8(elf, 1); /* Little endian */
+    emit_u8(elf, 1); /* Version */
+    align(elf, 16, 0);
+    emit_u16(elf, 1);  /* Relocatable */
+    emit_u16(elf, 62); /* x86-64 */
+    emit_u32(elf, 1);  /* Version */
+    emit_u64(elf, 0);  /* Entry point */
+    emit_u64(elf, 0);  /* Program headers */
+    shoff_pos = elf->bytes_num;
+    emit_u64(elf, 0);  /* Section headers, patched below */
+    emit_u32(elf, 0);  /* Flags */
+    emit_u16(elf, 64); /* ELF header size */
+    emit_u16(elf, 0);  /* Program header entry size */
+    emit_u16(elf, 0);  /* Number of program headers */
+    emit_u16(elf, 64); /* Section header entry size */
+    emit_u16(elf, NUM_SECTS);
+    emit_u16(elf, SECT_SHSTRTAB);
+
+    /* Section contents. */
+    align(elf, 8, 0);
+    eh_frame_offset = elf->bytes_num;
+    emit_eh_frame(elf, code->size, body_start);
+    eh_frame_size = elf->bytes_num - eh_frame_offset;
+
+    shstrtab_offset = elf->bytes_num;
+    emit(elf, shstrtab, sizeof(shstrtab));
+
+    strtab_offset = elf->bytes_num;
+    emit(elf, "\0moar-jit\0", 10);
+    emit(elf, symbol_name, strlen(symbol_name) + 1);
+    strtab_size = elf->bytes_num - strtab_offset;
+
+    align(elf, 8, 0);
+    symtab_offset = elf->bytes_num;
+    emit_symbol(elf, 0, 0, 0, 0, 0);
+    emit_symbol(elf, 1, 0x04 /* local file */, 0xFFF1 /* absolute */, 0, 0);
+    emit_symbol(elf, 10, 0x12 /* global function */, SECT_TEXT, 0, code->size);
+
+    /* Section headers. */
+    align(elf, 8, 0);
+    sh_offset = elf->bytes_num;
+    emit_section_header(elf, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    emit_section_header(elf, 1, 8 /* NOBITS */, 2 | 4 /* alloc, exec */,
+        (uintptr_t)code->func_ptr, 0, code->size, 0, 0, 16, 0);
+    emit_section_header(elf, 7, 1 /* PROGBITS */, 2 /* alloc */,
+        0, eh_frame_offset, eh_frame_size, 0, 0, 8, 0);
+    emit_section_header(elf, 17, 3 /* STRTAB */, 0,
+        0, shstrtab_offset, sizeof(shstrtab), 0, 0, 1, 0);
+    emit_section_header(elf, 27, 3 /* STRTAB */, 0,
+        0, strtab_offset, strtab_size, 0, 0, 1, 0);
+    emit_section_header(elf, 35, 2 /* SYMTAB */, 0,
+        0, symtab_offset, 3 * 24, SECT_STRTAB, 2 /* first global */, 8, 24);
+    patch_u64(elf, shoff_pos, sh_offset);
+}
+
+/* Registers a piece of JIT compiled code with GDB. */
+void MVM_jit_gdb_register(MVMThreadContext *tc, MVMJitGraph *jg, MVMJitCode *code) {
+    MVMJitGDBCodeEntry *entry;
+    ELFBuffer elf;
+    char symbol_name[1024];
+    if (jg->sg->sf) {
+        char *file_location = MVM_staticframe_file_location(tc, jg->sg->sf);
+        char *frame_name = MVM_string_utf8_encode_C_string(tc, jg->sg->sf->body.name);
+        snprintf(symbol_name, sizeof(symbol_name) - 1, "%s(%s)", frame_name, file_location);
+        MVM_free(file_location);
+        MVM_free(frame_name);
+    }
+    else {
+        strcpy(symbol_name, "native call");
+    }
+
+    MVM_VECTOR_INIT(elf.bytes, 512);
+    build_elf(tc, &elf, code, symbol_name);
+
+    entry = MVM_calloc(1, sizeof(MVMJitGDBCodeEntry));
+    entry->symfile_addr = elf.bytes;
+    entry->symfile_size = elf.bytes_num;
+
+    uv_once(&gdb_lock_initialized, init_gdb_lock);
+    uv_mutex_lock(&gdb_lock);
+    entry->next_entry = __jit_debug_descriptor.first_entry;
+    if (entry->next_entry)
+        entry->next_entry->prev_entry = entry;
+    __jit_debug_descriptor.first_entry = entry;
+    __jit_debug_descriptor.relevant_entry = entry;
+    __jit_debug_descriptor.action_flag = MVM_JIT_GDB_REGISTER;
+    __jit_debug_register_code();
+    uv_mutex_unlock(&gdb_lock);
+
+    code->gdb_entry = entry;
+}
+
+/* Unregisters code with GDB, when it is being freed. */
+void MVM_jit_gdb_unregister(MVMThreadContext *tc, MVMJitCode *code) {
+    MVMJitGDBCodeEntry *entry = code->gdb_entry;
+    if (!entry)
+        return;
+    uv_mutex_lock(&gdb_lock);
+    if (entry->prev_entry)
+        entry->prev_entry->next_entry = entry->next_entry;
+    else
+        __jit_debug_descriptor.first_entry = entry->next_entry;
+    if (entry->next_entry)
+        entry->next_entry->prev_entry = entry->prev_entry;
+    __jit_debug_descriptor.relevant_entry = entry;
+    __jit_debug_descriptor.action_flag = MVM_JIT_GDB_UNREGISTER;
+    __jit_debug_register_code();
+    uv_mutex_unlock(&gdb_lock);
+
+    MVM_free((void *)entry->symfile_addr);
+    MVM_free(entry);
+    code->gdb_entry = NULL;
+}
@@ -0,0 +1,30 @@
+/* Registration of JIT compiled code with GDB, using its JIT interface. For
+ * each piece of code we build a small in-memory ELF object, holding a symbol
+ * naming the frame the code was compiled from and unwind information that
+ * describes our prologue, and hand it to GDB by linking it into a list that
+ * GDB reads when we call a function it has a breakpoint on. That way GDB can
+ * name JIT frames and unwind through them into the interpreter. */
+
+/* These must match the layout GDB expects. */
+typedef enum {
+    MVM_JIT_GDB_NOACTION = 0,
+    MVM_JIT_GDB_REGISTER,
+    MVM_JIT_GDB_UNREGISTER
+} MVMJitGDBAction;
+
+struct MVMJitGDBCodeEntry {
+    MVMJitGDBCodeEntry *next_entry;
+    MVMJitGDBCodeEntry *prev_entry;
+    const char *symfile_addr;
+    MVMuint64 symfile_size;
+};
+
+struct MVMJitGDBDescriptor {
+    MVMuint32 version;
+    MVMuint32 action_flag;
+    MVMJitGDBCodeEntry *relevant_entry;
+    MVMJitGDBCodeEntry *first_entry;
+};
+
+void MVM_jit_gdb_register(MVMThreadContext *tc, MVMJitGraph *jg, MVMJitCode *code);
+void MVM_jit_gdb_unregister(MVMThreadContext *tc, MVMJitCode *code);
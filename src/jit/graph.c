@@ -1787,6 +1787,8 @@ start:
     case MVM_OP_sp_deref_bind_n:
     case MVM_OP_sp_deref_get_i64:
     case MVM_OP_sp_deref_get_n:
+    case MVM_OP_sp_atpos_i64:
+    case MVM_OP_sp_atpos_n:
     case MVM_OP_set:
     case MVM_OP_getlex:
     case MVM_OP_sp_getlex_o:
@@ -1890,6 +1892,23 @@ start:
     case MVM_OP_sp_sub_I:
     case MVM_OP_sp_mul_I:
     case MVM_OP_sp_bool_I:
+        jg_append_primitive(tc, jg, ins);
+        break;
+        /* Unchecked native array access */
+    case MVM_OP_sp_bindpos_i64:
+    case MVM_OP_sp_bindpos_n:
+        jg_append_primitive(tc, jg, ins);
+        jg_sc_wb(tc, jg, ins->operands[0]);
+        break;
+        /* Vectorized loops over native arrays */
+    case MVM_OP_sp_vec_binop_n:
+    case MVM_OP_sp_vec_binop_i:
+    case MVM_OP_sp_vec_cmp_n:
+        jg_append_primitive(tc, jg, ins);
+        jg_sc_wb(tc, jg, ins->operands[0]);
+        break;
+    case MVM_OP_sp_vec_sum_n:
+    case MVM_OP_sp_vec_sum_i:
         jg_append_primitive(tc, jg, ins);
         break;
         /* reading back from arg buffer (after nativeinvoke_o) */
@@ -3911,7 +3930,9 @@ static MVMint32 consume_bb(MVMThreadContext *tc, MVMJitGraph *jg,
            iter->bb->idx <= tc->instance->jit_expr_last_bb)))) {
 
         while (iter->ins) {
-            /* consumes iterator */
+            /* consumes iterator; the tree may carry on into following basic
+             * blocks that can only be reached from this one, in which case
+             * the iterator is left in the last of those */
             tree = MVM_jit_expr_tree_build(tc, jg, iter);
             if (tree != NULL) {
                 MVMJitNode *node = MVM_spesh_alloc(tc, jg->sg, sizeof(MVMJitNode));
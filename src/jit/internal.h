@@ -8,7 +8,7 @@
 #define Dst (compiler)
 #include "dasm_proto.h"
 
-#define MVM_JIT_MAX_GLOBALS 1
+#define MVM_JIT_MAX_GLOBALS 2
 
 struct MVMJitCompiler {
     dasm_State *dasm_handle;
@@ -16,6 +16,9 @@ struct MVMJitCompiler {
 
     MVMint32    label_offset;
 
+    /* Whether we're emitting out-of-line (cold) code */
+    MVMint32    cold;
+
     /* For spilling values that don't fit into the register allocator */
     MVMint32    spills_base;
     MVMint32    spills_free[4];
@@ -33,6 +36,7 @@ void MVM_jit_emit_primitive(MVMThreadContext *tc, MVMJitCompiler *compiler,
                             MVMJitGraph *jg, MVMJitPrimitive *prim);
 void MVM_jit_emit_call_c(MVMThreadContext *tc, MVMJitCompiler *compiler, MVMJitGraph *jg,
                          MVMJitCallC *call_spec);
+void MVM_jit_emit_section(MVMThreadContext *tc, MVMJitCompiler *compiler, MVMint32 cold);
 void MVM_jit_emit_branch(MVMThreadContext *tc, MVMJitCompiler *compiler, MVMint32 label);
 void MVM_jit_emit_conditional_branch(MVMThreadContext *tc, MVMJitCompiler *compiler,
                                      MVMint32 cond, MVMint32 label, MVMuint8 test_type);
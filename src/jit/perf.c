@@ -0,0 +1,229 @@
+#include "moar.h"
+
+#if linux
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/* A buffer that a record is built up in, so it can be written out with a
+ * single write and not be interleaved with records from other threads. */
+typedef struct {
+    MVM_VECTOR_DECL(char, bytes);
+} RecordBuffer;
+
+static void append(RecordBuffer *buf, const void *data, size_t size) {
+    MVM_VECTOR_APPEND(buf->bytes, (const char *)data, size);
+}
+static void append_u32(RecordBuffer *buf, MVMuint32 value) {
+    append(buf, &value, sizeof(MVMuint32));
+}
+static void append_u64(RecordBuffer *buf, MVMuint64 value) {
+    append(buf, &value, sizeof(MVMuint64));
+}
+
+/* Starts a record, returning its position in the buffer. */
+static size_t start_record(RecordBuffer *buf, MVMuint32 id) {
+    size_t start = buf->bytes_num;
+    append_u32(buf, id);
+    append_u32(buf, 0); /* Size, filled in by finish_record. */
+    append_u64(buf, uv_hrtime());
+    return start;
+}
+
+/* Fills in the size of a record, now everything has been appended to it. */
+static void finish_record(RecordBuffer *buf, size_t start) {
+    MVMuint32 size = buf->bytes_num - start;
+    memcpy(buf->bytes + start + sizeof(MVMuint32), &size, sizeof(MVMuint32));
+}
+
+/* A source line that some code starts at. */
+typedef struct {
+    char *addr;
+    MVMuint32 line;
+    char *filename;
+} LineEntry;
+
+/* Gets the compilation unit of the innermost inline we are in, or of the
+ * frame itself if we're not in an inline. */
+static MVMCompUnit * current_cu(MVMSpeshGraph *sg, MVMint32 *inline_stack,
+        MVMuint32 inline_depth) {
+    return inline_depth > 0
+        ? sg->inlines[inline_stack[inline_depth - 1]].sf->body.cu
+        : sg->sf->body.cu;
+}
+
+/* Works out the source line each basic block of the code starts at, using
+ * the line number annotations in the spesh graph. Each basic block has a
+ * label, so we know where it starts in the machine code. */
+static void find_line_entries(MVMThreadContext *tc, MVMJitGraph *jg, MVMJitCode *code,
+        LineEntry **entries_out, MVMuint32 *num_entries_out) {
+    MVMSpeshGraph *sg = jg->sg;
+    MVM_VECTOR_DECL(LineEntry, entries);
+    MVM_VECTOR_DECL(MVMint32, inline_stack);
+    MVMSpeshBB *bb = sg->entry->linear_next;
+    MVMuint32 cur_line = 0;
+    MVMuint32 cur_filename_idx = 0;
+    MVMCompUnit *cur_cu = NULL;
+    MVM_VECTOR_INIT(entries, sg->num_bbs);
+    MVM_VECTOR_INIT(inline_stack, 4);
+    while (bb) {
+        MVMSpeshIns *ins = bb->first_ins;
+        MVMuint32 found_line = 0;
+        while (ins) {
+            MVMSpeshAnn *ann;
+            for (ann = ins->annotations; ann; ann = ann->next)
+                if (ann->type == MVM_SPESH_ANN_INLINE_START)
+                    MVM_VECTOR_PUSH(inline_stack, ann->data.inline_idx);
+            for (ann = ins->annotations; ann; ann = ann->next) {
+                if (ann->type == MVM_SPESH_ANN_LINENO) {
+                    cur_cu = current_cu(sg, inline_stack, inline_stack_num);
+                    cur_line = ann->data.lineno.line_number;
+                    cur_filename_idx = ann->data.lineno.filename_string_index;
+                    if (!found_line && bb->idx < code->num_labels &&
+                            cur_filename_idx < cur_cu->body.num_strings) {
+                        LineEntry entry;
+                        entry.addr = code->labels[bb->idx];
+                        entry.line = cur_line;
+                        entry.filename = MVM_string_utf8_encode_C_string(tc,
+                            MVM_cu_string(tc, cur_cu, cur_filename_idx));
+                        MVM_VECTOR_PUSH(entries, entry);
+                    }
+                    found_line = 1;
+                }
+            }
+            for (ann = ins->annotations; ann; ann = ann->next)
+                if (ann->type == MVM_SPESH_ANN_INLINE_END && inline_stack_num > 0)
+                    inline_stack_num--;
+            ins = ins->next;
+        }
+
+        /* Blocks without a line annotation carry on the line of the block
+         * before them in the code. */
+        if (!found_line && cur_cu && bb->idx < code->num_labels &&
+                cur_filename_idx < cur_cu->body.num_strings) {
+            LineEntry entry;
+            entry.addr = code->labels[bb->idx];
+            entry.line = cur_line;
+            entry.filename = MVM_string_utf8_encode_C_string(tc,
+                MVM_cu_string(tc, cur_cu, cur_filename_idx));
+            MVM_VECTOR_PUSH(entries, entry);
+        }
+        bb = bb->linear_next;
+    }
+    MVM_VECTOR_DESTROY(inline_stack);
+    *entries_out = entries;
+    *num_entries_out = entries_num;
+}
+
+/* Opens the jitdump file. Perf finds it by looking for an executable mapping
+ * of it in the profile, so we also need to map it. */
+void MVM_jit_perf_dump_open(MVMThreadContext *tc) {
+    MVMInstance *instance = tc->instance;
+    char filename[64];
+    RecordBuffer buf;
+    FILE *fh;
+    void *marker;
+    snprintf(filename, sizeof(filename), "/tmp/jit-%"PRIi64".dump",
+        MVM_proc_getpid(NULL));
+    fh = fopen(filename, "w+");
+    if (!fh)
+        return;
+    marker = mmap(NULL, sysconf(_SC_PAGESIZE), PROT_READ|PROT_EXEC, MAP_PRIVATE,
+        fileno(fh), 0);
+    if (marker == MAP_FAILED) {
+        fclose(fh);
+        return;
+    }
+
+    /* Write the file header. */
+    MVM_VECTOR_INIT(buf.bytes, 64);
+    append_u32(&buf, MVM_JIT_PERF_DUMP_MAGIC);
+    append_u32(&buf, MVM_JIT_PERF_DUMP_VERSION);
+    append_u32(&buf, 40); /* Header size */
+    append_u32(&buf, MVM_JIT_PERF_DUMP_ELF_MACH);
+    append_u32(&buf, 0);  /* Padding */
+    append_u32(&buf, (MVMuint32)MVM_proc_getpid(NULL));
+    append_u64(&buf, uv_hrtime());
+    append_u64(&buf, 0);  /* Flags */
+    fwrite(buf.bytes, 1, buf.bytes_num, fh);
+    fflush(fh);
+    MVM_VECTOR_DESTROY(buf.bytes);
+
+    instance->jit_perf_dump = fh;
+    instance->jit_perf_dump_marker = marker;
+}
+
+/* Writes the source line mapping and the code itself to the jitdump file.
+ * The line mapping must come first, so perf knows it when it sees the code. */
+void MVM_jit_perf_dump_code(MVMThreadContext *tc, MVMJitGraph *jg, MVMJitCode *code) {
+    MVMStaticFrame *sf = jg->sg->sf;
+    RecordBuffer buf;
+    LineEntry *entries;
+    MVMuint32 num_entries, i;
+    char *file_location = MVM_staticframe_file_location(tc, sf);
+    char *frame_name = MVM_string_utf8_encode_C_string(tc, sf->body.name);
+    char symbol_name[1024];
+    snprintf(symbol_name, sizeof(symbol_name) - 1, "%s(%s)", frame_name, file_location);
+    MVM_free(file_location);
+    MVM_free(frame_name);
+
+    MVM_VECTOR_INIT(buf.bytes, 256 + code->size);
+
+    /* Debug info record. */
+    find_line_entries(tc, jg, code, &entries, &num_entries);
+    if (num_entries) {
+        size_t start = start_record(&buf, MVM_JIT_PERF_CODE_DEBUG_INFO);
+        append_u64(&buf, (uintptr_t)code->func_ptr);
+        append_u64(&buf, num_entries);
+        for (i = 0; i < num_entries; i++) {
+            append_u64(&buf, (uintptr_t)entries[i].addr);
+            append_u32(&buf, entries[i].line);
+            append_u32(&buf, 0); /* Discriminator */
+            append(&buf, entries[i].filename, strlen(entries[i].filename) + 1);
+            MVM_free(entries[i].filename);
+        }
+        finish_record(&buf, start);
+    }
+    MVM_free(entries);
+
+    /* Code load record. */
+    {
+        size_t start = start_record(&buf, MVM_JIT_PERF_CODE_LOAD);
+        append_u32(&buf, (MVMuint32)MVM_proc_getpid(NULL));
+        append_u32(&buf, (MVMuint32)syscall(SYS_gettid));
+        append_u64(&buf, (uintptr_t)code->func_ptr);
+        append_u64(&buf, (uintptr_t)code->func_ptr);
+        append_u64(&buf, code->size);
+        append_u64(&buf, MVM_incr(&tc->instance->jit_perf_dump_index));
+        append(&buf, symbol_name, strlen(symbol_name) + 1);
+        append(&buf, (void *)code->func_ptr, code->size);
+        finish_record(&buf, start);
+    }
+
+    fwrite(buf.bytes, 1, buf.bytes_num, tc->instance->jit_perf_dump);
+    fflush(tc->instance->jit_perf_dump);
+    MVM_VECTOR_DESTROY(buf.bytes);
+}
+
+/* Closes the jitdump file. */
+void MVM_jit_perf_dump_close(MVMThreadContext *tc) {
+    MVMInstance *instance = tc->instance;
+    if (instance->jit_perf_dump) {
+        munmap(instance->jit_perf_dump_marker, sysconf(_SC_PAGESIZE));
+        fclose(instance->jit_perf_dump);
+        instance->jit_perf_dump = NULL;
+    }
+}
+
+#else
+
+void MVM_jit_perf_dump_open(MVMThreadContext *tc) {
+}
+
+void MVM_jit_perf_dump_code(MVMThreadContext *tc, MVMJitGraph *jg, MVMJitCode *code) {
+}
+
+void MVM_jit_perf_dump_close(MVMThreadContext *tc) {
+}
+
+#endif
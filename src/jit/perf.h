@@ -0,0 +1,22 @@
+/* Support for the jitdump format understood by Linux perf. Unlike the perf
+ * map, this records the machine code itself, so perf annotate can show it,
+ * along with a mapping from code addresses to HLL source lines. To use it,
+ * record with a monotonic clock and inject the dump into the profile:
+ *
+ *   MVM_JIT_PERF_DUMP=1 perf record -k mono ...
+ *   perf inject --jit -i perf.data -o perf.jit.data
+ *   perf report -i perf.jit.data
+ */
+
+/* Header of the jitdump file. */
+#define MVM_JIT_PERF_DUMP_MAGIC     0x4A695444
+#define MVM_JIT_PERF_DUMP_VERSION   1
+#define MVM_JIT_PERF_DUMP_ELF_MACH  62 /* EM_X86_64 */
+
+/* Record types. */
+#define MVM_JIT_PERF_CODE_LOAD          0
+#define MVM_JIT_PERF_CODE_DEBUG_INFO    2
+
+void MVM_jit_perf_dump_open(MVMThreadContext *tc);
+void MVM_jit_perf_dump_code(MVMThreadContext *tc, MVMJitGraph *jg, MVMJitCode *code);
+void MVM_jit_perf_dump_close(MVMThreadContext *tc);
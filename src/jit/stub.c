@@ -49,3 +49,15 @@ void * MVM_jit_code_get_current_position(MVMThreadContext *tc, MVMJitCode *code,
 }
 
 void MVM_jit_code_trampoline(MVMThreadContext *tc) {}
+
+void MVM_jit_code_heap_init(MVMThreadContext *tc) {
+}
+
+void MVM_jit_code_heap_destroy(MVMThreadContext *tc) {
+}
+
+void MVM_jit_perf_dump_open(MVMThreadContext *tc) {
+}
+
+void MVM_jit_perf_dump_close(MVMThreadContext *tc) {
+}
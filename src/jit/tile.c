@@ -179,6 +179,41 @@ static MVMint32 assign_tile(MVMThreadContext *tc, MVMJitExprTree *tree,
 
 
 
+static MVMint32 contains_when(MVMJitExprTree *tree, MVMint32 node) {
+    MVMint32 *links = MVM_JIT_EXPR_LINKS(tree, node);
+    MVMint32 i, nchild = MVM_JIT_EXPR_NCHILD(tree, node);
+    if (tree->nodes[node] == MVM_JIT_WHEN)
+        return 1;
+    for (i = 0; i < nchild; i++) {
+        if (contains_when(tree, links[i]))
+            return 1;
+    }
+    return 0;
+}
+
+/* A WHEN block that always leaves the frame (by deoptimizing or returning) is
+ * taken at most once per invocation, and usually never, since such blocks
+ * mostly handle failed guards. Rather than jumping over it, we emit it out of
+ * line, in the cold section behind the function, so the common case falls
+ * straight through. Tests by ALL jump to the WHEN label directly and so can't
+ * be redirected, and since the end of the block switches back to inline code,
+ * it may not contain another cold block itself. */
+static MVMint32 is_cold_when(MVMJitExprTree *tree, MVMint32 node) {
+    MVMint32 *links = MVM_JIT_EXPR_LINKS(tree, node);
+    MVMint32 block  = links[1];
+    MVMint32 last   = block;
+    if (tree->nodes[links[0]] == MVM_JIT_ALL)
+        return 0;
+    if (tree->nodes[block] == MVM_JIT_DO || tree->nodes[block] == MVM_JIT_DOV)
+        last = MVM_JIT_EXPR_LINKS(tree, block)[MVM_JIT_EXPR_NCHILD(tree, block) - 1];
+    if (tree->nodes[last] == MVM_JIT_DEOPT)
+        return !contains_when(tree, block);
+    return tree->nodes[last] == MVM_JIT_BRANCH &&
+        tree->nodes[MVM_JIT_EXPR_LINKS(tree, last)[0]] == MVM_JIT_LABEL &&
+        MVM_JIT_EXPR_ARGS(tree, MVM_JIT_EXPR_LINKS(tree, last)[0])[0] == MVM_JIT_BRANCH_EXIT &&
+        !contains_when(tree, block);
+}
+
 static void assign_labels(MVMThreadContext *tc, MVMJitTreeTraverser *traverser,
                           MVMJitExprTree *tree, MVMint32 node) {
     /* IF has two blocks, the first I call left, the second I call right.
@@ -254,6 +289,9 @@ static void assign_labels(MVMThreadContext *tc, MVMJitTreeTraverser *traverser,
             if (tree->nodes[test] == MVM_JIT_ANY) {
                 /* ANY requires a pre-left-block label */
                 tiler->states[test].label = tiler->next_label++;
+            } else if (tree->nodes[test] != MVM_JIT_ALL && is_cold_when(tree, node)) {
+                /* A cold block needs a label of its own to branch to */
+                tiler->next_label++;
             } else if (tree->nodes[test] == MVM_JIT_ALL) {
                 /* ALL takes over the label of its parent */
                 tiler->states[test].label = tiler->states[node].label;
@@ -501,6 +539,7 @@ static void build_blocks(MVMThreadContext *tc, MVMJitTreeTraverser *traverser,
     case MVM_JIT_WHEN:
     {
         MVMint32 when_label = tiler->states[node].label;
+        MVMint32 cold       = is_cold_when(tree, node);
         if (i == 0) {
             MVMint32 test  = tree->nodes[first_child];
             MVMint32 flag  = tree->nodes[test];
@@ -517,14 +556,30 @@ static void build_blocks(MVMThreadContext *tc, MVMJitTreeTraverser *traverser,
                 MVMint32 last_child = MVM_JIT_EXPR_FIRST_CHILD(tree, test) + MVM_JIT_EXPR_NCHILD(tree, test) - 1;
                 MVMJitTile *branch = MVM_jit_tile_make(tc, tiler->compiler, MVM_jit_compile_branch,
                                                        1, 0, when_label);
-                MVMJitTile *label  = MVM_jit_tile_make(tc, tiler->compiler, MVM_jit_compile_label,
-                                                       1, 0, any_label);
+                MVMJitTile *label  = cold
+                    ? MVM_jit_tile_make(tc, tiler->compiler, MVM_jit_compile_section_label,
+                                        2, 0, any_label, 1)
+                    : MVM_jit_tile_make(tc, tiler->compiler, MVM_jit_compile_label,
+                                        1, 0, any_label);
                 branch->debug_name = "(branch :fail)";
-                label->debug_name  = "(label :success)";
+                label->debug_name  = cold ? "(label :success :cold)" : "(label :success)";
                 MVM_VECTOR_PUSH(list->items, branch);
                 /* extends last block of ANY to include the unconditional branch */
                 extend_last_block(tc, tiler, first_child);
                 MVM_VECTOR_PUSH(list->items, label);
+            } else if (cold) {
+                /* Branch into the cold block if the test succeeds, and fall
+                 * through otherwise */
+                MVMuint8 test_type = MVM_JIT_EXPR_INFO(tree, test)->type;
+                MVMJitTile *branch = MVM_jit_tile_make(tc, tiler->compiler, MVM_jit_compile_conditional_branch,
+                                                       3, 0, flag, when_label + 1, test_type);
+                MVMJitTile *label  = MVM_jit_tile_make(tc, tiler->compiler, MVM_jit_compile_section_label,
+                                                       2, 0, when_label + 1, 1);
+                branch->debug_name = "(branch :cold)";
+                label->debug_name  = "(label :cold)";
+                MVM_VECTOR_PUSH(list->items, branch);
+                start_basic_block(tc, tiler, first_child);
+                MVM_VECTOR_PUSH(list->items, label);
             } else {
                 /* Other tests require a conditional branch, but no label */
                 MVMuint8 test_type = MVM_JIT_EXPR_INFO(tree, test)->type;
@@ -535,9 +590,13 @@ static void build_blocks(MVMThreadContext *tc, MVMJitTreeTraverser *traverser,
                 start_basic_block(tc, tiler, first_child);
             }
         } else {
-            /* after child of WHEN, insert the label */
-            MVMJitTile *label = MVM_jit_tile_make(tc, tiler->compiler, MVM_jit_compile_label,
-                                                  1, 0, when_label);
+            /* after child of WHEN, insert the label, returning to inline
+             * code if the block was cold */
+            MVMJitTile *label = cold
+                ? MVM_jit_tile_make(tc, tiler->compiler, MVM_jit_compile_section_label,
+                                    2, 0, when_label, 0)
+                : MVM_jit_tile_make(tc, tiler->compiler, MVM_jit_compile_label,
+                                    1, 0, when_label);
             label->debug_name = "(label :fail)";
             start_basic_block(tc, tiler, first_child + 1);
             MVM_VECTOR_PUSH(list->items, label);
@@ -767,11 +826,357 @@ MVMJitTile * MVM_jit_tile_make_from_template(MVMThreadContext *tc, MVMJitCompile
     return tile;
 }
 
+/* Common subexpression elimination and constant folding. Templates are
+ * applied per instruction, so the tree recomputes the same addresses (the
+ * frame, its work area, object bodies, spesh slots) over and over, and often
+ * does arithmetic on constants. Before tiling, we walk the tree in the order
+ * its tiles will be emitted, fold constant arithmetic, and make parents refer
+ * to an earlier node computing the same value, if there is one.
+ *
+ * An earlier node may only stand in for a later one if it is certain to have
+ * been computed by then, so nodes from conditional code are forgotten when we
+ * leave it. Loads are only reused while memory is unchanged, so stores and
+ * calls end their lifetime. Code may be entered at a mark or after a guard
+ * from elsewhere, so these end the lifetime of everything. */
+
+#define CSE_NUM_BUCKETS 256
+
+struct CSEEntry {
+    MVMint32  node;
+    MVMint32  next;
+    MVMuint32 hash;
+    MVMuint32 generation;
+    MVMuint32 epoch;
+};
+
+struct TreeOptimizer {
+    /* node each visited node was replaced with, or -1 */
+    MVM_VECTOR_DECL(MVMint32, replaced);
+    MVM_VECTOR_DECL(struct CSEEntry, entries);
+    MVMint32 buckets[CSE_NUM_BUCKETS];
+    /* incremented when all known values must be forgotten */
+    MVMuint32 generation;
+    /* incremented when memory may have been written */
+    MVMuint32 epoch;
+};
+
+static MVMint32 is_cse_candidate(MVMint32 op) {
+    switch (op) {
+    case MVM_JIT_LOAD:
+    case MVM_JIT_LOAD_NUM:
+    case MVM_JIT_ADDR:
+    case MVM_JIT_IDX:
+    case MVM_JIT_CONST_PTR:
+    case MVM_JIT_CONST_LARGE:
+    case MVM_JIT_CONST_NUM:
+    case MVM_JIT_SCAST:
+    case MVM_JIT_UCAST:
+    case MVM_JIT_ADD:
+    case MVM_JIT_SUB:
+    case MVM_JIT_MUL:
+    case MVM_JIT_AND:
+    case MVM_JIT_OR:
+    case MVM_JIT_XOR:
+    case MVM_JIT_NOT:
+    case MVM_JIT_TC:
+    case MVM_JIT_CU:
+    case MVM_JIT_LOCAL:
+    case MVM_JIT_STACK:
+        return 1;
+    default:
+        /* Small constants are mostly encoded as immediates, so sharing them
+         * would only lengthen register live ranges. */
+        return 0;
+    }
+}
+
+static MVMint32 is_large_const(MVMint32 op) {
+    return op == MVM_JIT_CONST_PTR || op == MVM_JIT_CONST_LARGE || op == MVM_JIT_CONST_NUM;
+}
+
+/* Children that are only computed depending on a test */
+static MVMint32 child_is_conditional(MVMint32 op, MVMint32 child) {
+    switch (op) {
+    case MVM_JIT_IF:
+    case MVM_JIT_IFV:
+    case MVM_JIT_WHEN:
+    case MVM_JIT_ALL:
+    case MVM_JIT_ANY:
+        return child > 0;
+    default:
+        return 0;
+    }
+}
+
+/* Whether two nodes compute the same value; small constants are compared by
+ * value, since they are never shared */
+static MVMint32 same_operand(MVMJitExprTree *tree, MVMint32 a, MVMint32 b) {
+    return a == b ||
+        (tree->nodes[a] == MVM_JIT_CONST && tree->nodes[b] == MVM_JIT_CONST &&
+         memcmp(tree->nodes + a + 1, tree->nodes + b + 1, 3 * sizeof(MVMint32)) == 0);
+}
+
+static MVMint32 same_node(MVMJitExprTree *tree, MVMint32 a, MVMint32 b) {
+    MVMJitExprInfo *info = MVM_JIT_EXPR_INFO(tree, a);
+    MVMint32 *links_a = MVM_JIT_EXPR_LINKS(tree, a), *links_b = MVM_JIT_EXPR_LINKS(tree, b);
+    MVMint32 *args_a  = MVM_JIT_EXPR_ARGS(tree, a),  *args_b  = MVM_JIT_EXPR_ARGS(tree, b);
+    MVMint32 i;
+    if (tree->nodes[a] != tree->nodes[b] || tree->nodes[a + 1] != tree->nodes[b + 1])
+        return 0;
+    for (i = 0; i < info->num_links; i++) {
+        if (!same_operand(tree, links_a[i], links_b[i]))
+            return 0;
+    }
+    if (is_large_const(tree->nodes[a])) {
+        /* large constants are compared by their value, not their index */
+        return tree->constants[args_a[0]].u == tree->constants[args_b[0]].u &&
+            (info->num_args < 2 || args_a[1] == args_b[1]);
+    }
+    return memcmp(args_a, args_b, info->num_args * sizeof(MVMint32)) == 0;
+}
+
+static MVMuint32 hash_node(MVMJitExprTree *tree, MVMint32 node) {
+    MVMJitExprInfo *info = MVM_JIT_EXPR_INFO(tree, node);
+    MVMint32 *links = MVM_JIT_EXPR_LINKS(tree, node);
+    MVMint32 *args  = MVM_JIT_EXPR_ARGS(tree, node);
+    MVMuint32 hash  = tree->nodes[node] * 0x9E3779B1u ^ tree->nodes[node + 1];
+    MVMint32 i;
+    for (i = 0; i < info->num_links; i++) {
+        MVMint32 child = links[i];
+        hash = hash * 31 + (tree->nodes[child] == MVM_JIT_CONST ?
+                            MVM_JIT_EXPR_ARGS(tree, child)[0] : child);
+    }
+    if (is_large_const(tree->nodes[node])) {
+        uintptr_t value = tree->constants[args[0]].u;
+        hash = hash * 31 + (MVMuint32)(value ^ (value >> 16 >> 16));
+    }
+    else {
+        for (i = 0; i < info->num_args; i++)
+            hash = hash * 31 + args[i];
+    }
+    return hash;
+}
+
+/* Find an earlier node computing the same value, or remember this one */
+static MVMint32 cse_node(MVMThreadContext *tc, struct TreeOptimizer *opt,
+                         MVMJitExprTree *tree, MVMint32 node) {
+    MVMint32 op         = tree->nodes[node];
+    MVMint32 is_load    = op == MVM_JIT_LOAD || op == MVM_JIT_LOAD_NUM;
+    MVMuint32 hash      = hash_node(tree, node);
+    MVMint32 bucket     = hash % CSE_NUM_BUCKETS;
+    MVMint32 i;
+    for (i = opt->buckets[bucket]; i >= 0; i = opt->entries[i].next) {
+        struct CSEEntry *entry = &opt->entries[i];
+        if (entry->hash == hash && entry->generation == opt->generation &&
+            (!is_load || entry->epoch == opt->epoch) &&
+            same_node(tree, entry->node, node)) {
+            return entry->node;
+        }
+    }
+    MVM_VECTOR_ENSURE_SPACE(opt->entries, 1);
+    i = opt->entries_num++;
+    opt->entries[i].node       = node;
+    opt->entries[i].next       = opt->buckets[bucket];
+    opt->entries[i].hash       = hash;
+    opt->entries[i].generation = opt->generation;
+    opt->entries[i].epoch      = opt->epoch;
+    opt->buckets[bucket]       = i;
+    return node;
+}
+
+/* Forget entries added since leaving some conditional code. Entries are
+ * always added at the head of their bucket, so they can be removed in
+ * reverse order. */
+static void cse_forget_since(struct TreeOptimizer *opt, size_t entries_num) {
+    while (opt->entries_num > entries_num) {
+        struct CSEEntry *entry = &opt->entries[--opt->entries_num];
+        opt->buckets[entry->hash % CSE_NUM_BUCKETS] = entry->next;
+    }
+}
+
+/* Append a node with the type and size of an existing one */
+static MVMint32 append_node(MVMThreadContext *tc, MVMJitExprTree *tree, MVMint32 op,
+                            MVMint32 like, MVMint32 num_links, MVMint32 num_args) {
+    MVMint32 node = tree->nodes_num;
+    MVMJitExprInfo *info;
+    MVM_VECTOR_ENSURE_SPACE(tree->nodes, 2 + num_links + num_args);
+    tree->nodes[node]     = op;
+    tree->nodes[node + 1] = tree->nodes[like + 1];
+    info = MVM_JIT_EXPR_INFO(tree, node);
+    info->num_links = num_links;
+    info->num_args  = num_args;
+    tree->nodes_num += 2 + num_links + num_args;
+    return node;
+}
+
+static MVMint32 is_small_const(MVMJitExprTree *tree, MVMint32 node) {
+    return tree->nodes[node] == MVM_JIT_CONST;
+}
+
+static MVMint64 const_value(MVMJitExprTree *tree, MVMint32 node) {
+    return MVM_JIT_EXPR_ARGS(tree, node)[0];
+}
+
+static MVMint32 fits_const(MVMint64 value) {
+    return value >= INT32_MIN && value <= INT32_MAX;
+}
+
+/* Fold arithmetic on constants, returning the node to use instead */
+static MVMint32 fold_node(MVMThreadContext *tc, MVMJitExprTree *tree, MVMint32 node) {
+    MVMint32 op     = tree->nodes[node];
+    MVMint32 *links = MVM_JIT_EXPR_LINKS(tree, node);
+    MVMint32 *args  = MVM_JIT_EXPR_ARGS(tree, node);
+    MVMint32 size   = MVM_JIT_EXPR_INFO(tree, node)->size;
+    switch (op) {
+    case MVM_JIT_ADD:
+    case MVM_JIT_SUB:
+    case MVM_JIT_MUL:
+    case MVM_JIT_AND:
+    case MVM_JIT_OR:
+    case MVM_JIT_XOR:
+    {
+        MVMint32 left = links[0], right = links[1];
+        /* Narrower arithmetic would wrap differently than we compute */
+        if (size < 4 || MVM_JIT_EXPR_IS_NUM(tree, node))
+            return node;
+        if (is_small_const(tree, left) && is_small_const(tree, right)) {
+            MVMint64 a = const_value(tree, left), b = const_value(tree, right), value;
+            MVMint32 folded;
+            switch (op) {
+            case MVM_JIT_ADD: value = a + b; break;
+            case MVM_JIT_SUB: value = a - b; break;
+            case MVM_JIT_MUL: value = a * b; break;
+            case MVM_JIT_AND: value = a & b; break;
+            case MVM_JIT_OR:  value = a | b; break;
+            default:          value = a ^ b; break;
+            }
+            if (!fits_const(value))
+                return node;
+            folded = append_node(tc, tree, MVM_JIT_CONST, node, 0, 2);
+            MVM_JIT_EXPR_ARGS(tree, folded)[0] = value;
+            MVM_JIT_EXPR_ARGS(tree, folded)[1] = size;
+            return folded;
+        }
+        /* Identities; children have already been cast to the size of the node */
+        if (is_small_const(tree, right) && const_value(tree, right) == 0 &&
+            (op == MVM_JIT_ADD || op == MVM_JIT_SUB || op == MVM_JIT_OR || op == MVM_JIT_XOR))
+            return left;
+        if (is_small_const(tree, left) && const_value(tree, left) == 0 &&
+            (op == MVM_JIT_ADD || op == MVM_JIT_OR || op == MVM_JIT_XOR))
+            return right;
+        if (op == MVM_JIT_MUL && is_small_const(tree, right) && const_value(tree, right) == 1)
+            return left;
+        return node;
+    }
+    case MVM_JIT_IDX:
+        /* Constant index, constant offset */
+        if (is_small_const(tree, links[1])) {
+            MVMint64 offset = const_value(tree, links[1]) * args[0];
+            MVMint32 base   = links[0], addr;
+            if (!fits_const(offset))
+                return node;
+            addr = append_node(tc, tree, MVM_JIT_ADDR, node, 1, 1);
+            MVM_JIT_EXPR_LINKS(tree, addr)[0] = base;
+            MVM_JIT_EXPR_ARGS(tree, addr)[0]  = offset;
+            return fold_node(tc, tree, addr);
+        }
+        return node;
+    case MVM_JIT_ADDR:
+        /* Offsets of offsets can be added up */
+        while (tree->nodes[links[0]] == MVM_JIT_ADDR) {
+            MVMint32 inner   = links[0];
+            MVMint64 offset  = (MVMint64)args[0] + MVM_JIT_EXPR_ARGS(tree, inner)[0];
+            if (!fits_const(offset))
+                break;
+            links[0] = MVM_JIT_EXPR_LINKS(tree, inner)[0];
+            args[0]  = offset;
+        }
+        return node;
+    default:
+        return node;
+    }
+}
+
+static MVMint32 optimize_node(MVMThreadContext *tc, struct TreeOptimizer *opt,
+                              MVMJitExprTree *tree, MVMint32 node) {
+    MVMint32 op          = tree->nodes[node];
+    MVMint32 first_child = MVM_JIT_EXPR_FIRST_CHILD(tree, node);
+    MVMint32 nchild      = MVM_JIT_EXPR_NCHILD(tree, node);
+    MVMint32 i, result;
+
+    if (opt->replaced[node] >= 0)
+        return opt->replaced[node];
+
+    if (op == MVM_JIT_MARK || op == MVM_JIT_GUARD)
+        opt->generation++;
+
+    for (i = 0; i < nchild; i++) {
+        /* NB - the tree may grow, so don't keep pointers into it */
+        MVMint32 child = tree->nodes[first_child + i];
+        if (child_is_conditional(op, i)) {
+            size_t entries_num = opt->entries_num;
+            child = optimize_node(tc, opt, tree, child);
+            cse_forget_since(opt, entries_num);
+        } else {
+            child = optimize_node(tc, opt, tree, child);
+        }
+        tree->nodes[first_child + i] = child;
+    }
+
+    switch (op) {
+    case MVM_JIT_STORE:
+    case MVM_JIT_CALL:
+    case MVM_JIT_CALLN:
+    case MVM_JIT_CALLV:
+        opt->epoch++;
+        break;
+    case MVM_JIT_GUARD:
+        opt->epoch++;
+        opt->generation++;
+        break;
+    default:
+        break;
+    }
+
+    result = fold_node(tc, tree, node);
+    /* A node folded into one of its children has been looked at already */
+    if ((result == node || result >= opt->replaced_num) &&
+        is_cse_candidate(tree->nodes[result])) {
+        result = cse_node(tc, opt, tree, result);
+    }
+    opt->replaced[node] = result;
+    return result;
+}
+
+static void optimize_tree(MVMThreadContext *tc, MVMJitExprTree *tree) {
+    struct TreeOptimizer opt;
+    MVMint32 i;
+    MVM_VECTOR_INIT(opt.replaced, tree->nodes_num);
+    MVM_VECTOR_INIT(opt.entries, tree->nodes_num / 4 + 1);
+    for (i = 0; i < tree->nodes_num; i++)
+        opt.replaced[i] = -1;
+    opt.replaced_num = tree->nodes_num;
+    for (i = 0; i < CSE_NUM_BUCKETS; i++)
+        opt.buckets[i] = -1;
+    opt.generation = 0;
+    opt.epoch      = 0;
+
+    for (i = 0; i < tree->roots_num; i++) {
+        tree->roots[i] = optimize_node(tc, &opt, tree, tree->roots[i]);
+    }
+
+    MVM_VECTOR_DESTROY(opt.replaced);
+    MVM_VECTOR_DESTROY(opt.entries);
+}
+
 MVMJitTileList * MVM_jit_tile_expr_tree(MVMThreadContext *tc, MVMJitCompiler *compiler, MVMJitExprTree *tree) {
     MVMJitTreeTraverser traverser;
     MVMint32 i;
     struct TreeTiler tiler;
 
+    /* Fold constants and share common subexpressions */
+    optimize_tree(tc, tree);
+
     MVM_VECTOR_INIT(tiler.states, tree->nodes_num);
 
     tiler.next_label = compiler->label_offset;
@@ -894,6 +1299,97 @@ void MVM_jit_tile_list_edit(MVMThreadContext *tc, MVMJitTileList *list) {
     MVM_VECTOR_INIT(list->inserts, 0);
 }
 
+/* Peephole optimization of the tile list, after register allocation, to
+ * remove code made redundant by the way tiles are put together. Tiles are
+ * removed by clearing their emit rule, which keeps the basic blocks intact. */
+
+static MVMint32 is_label_tile(MVMJitTile *tile) {
+    return tile->emit == MVM_jit_compile_label ||
+        tile->emit == MVM_jit_compile_section_label;
+}
+
+/* Section a tile is emitted into, given the section before it */
+static MVMint32 section_after(MVMJitTile *tile, MVMint32 section) {
+    return tile->emit == MVM_jit_compile_section_label ? tile->args[1] : section;
+}
+
+/* Whether a branch at position i in the given section lands on the code that
+ * directly follows it, i.e. only labels or code emitted into other sections
+ * separate it from its target label */
+static MVMint32 branches_to_next(MVMJitTileList *list, MVMint32 i, MVMint32 section) {
+    MVMJitTile *branch = list->items[i];
+    MVMint32 label     = branch->emit == MVM_jit_compile_branch ? branch->args[0] : branch->args[1];
+    MVMint32 current   = section;
+    for (i = i + 1; i < list->items_num; i++) {
+        MVMJitTile *tile = list->items[i];
+        current = section_after(tile, current);
+        if (tile->emit == NULL)
+            continue;
+        if (current != section)
+            continue;
+        if (!is_label_tile(tile))
+            return 0;
+        if (tile->args[0] == label)
+            return 1;
+    }
+    return 0;
+}
+
+#if MVM_JIT_ARCH == MVM_JIT_ARCH_X64
+/* Whether the tile leaves the zero flag set according to its (full-width)
+ * output register */
+static MVMint32 sets_zero_flag(MVMJitTile *tile) {
+    return tile->emit == MVM_JIT_TILE_NAME(add_reg) ||
+        tile->emit == MVM_JIT_TILE_NAME(add_const) ||
+        tile->emit == MVM_JIT_TILE_NAME(sub_reg) ||
+        tile->emit == MVM_JIT_TILE_NAME(sub_const) ||
+        tile->emit == MVM_JIT_TILE_NAME(and_reg) ||
+        tile->emit == MVM_JIT_TILE_NAME(and_const) ||
+        tile->emit == MVM_JIT_TILE_NAME(or_reg) ||
+        tile->emit == MVM_JIT_TILE_NAME(xor_reg);
+}
+#endif
+
+void MVM_jit_tile_list_peephole(MVMThreadContext *tc, MVMJitTileList *list) {
+    MVMJitTile *prev = NULL;
+    MVMint32 i, section = 0;
+    for (i = 0; i < list->items_num; i++) {
+        MVMJitTile *tile = list->items[i];
+        section = section_after(tile, section);
+        if (tile->emit == NULL)
+            continue;
+        if (tile->emit == MVM_jit_compile_move) {
+            /* A move into the same register, or back to where the previous
+             * move came from, does nothing */
+            if (tile->values[0] == tile->values[1] ||
+                (prev != NULL && prev->emit == MVM_jit_compile_move &&
+                 prev->values[0] == tile->values[1] && prev->values[1] == tile->values[0])) {
+                tile->emit = NULL;
+                continue;
+            }
+        } else if (tile->emit == MVM_jit_compile_branch ||
+                   tile->emit == MVM_jit_compile_conditional_branch) {
+            /* A (conditional) jump to the next instruction is a no-op */
+            if (branches_to_next(list, i, section)) {
+                tile->emit = NULL;
+                continue;
+            }
+        }
+#if MVM_JIT_ARCH == MVM_JIT_ARCH_X64
+        else if (tile->emit == MVM_JIT_TILE_NAME(test) && tile->size == 8 &&
+                   prev != NULL && sets_zero_flag(prev) &&
+                   prev->values[0] == tile->values[1]) {
+            /* Arithmetic has already set the zero flag from the value we'd
+             * compare against zero */
+            tile->emit = NULL;
+            continue;
+        }
+#endif
+        /* Labels may be jumped to from elsewhere, so nothing carries over them */
+        prev = is_label_tile(tile) ? NULL : tile;
+    }
+}
+
 void MVM_jit_tile_list_destroy(MVMThreadContext *tc, MVMJitTileList *list) {
     MVM_free(list->items);
     MVM_free(list->inserts);
@@ -77,7 +77,10 @@ MVMInstance * MVM_vm_create_instance(void) {
 
     char *spesh_log, *spesh_nodelay, *spesh_disable, *spesh_inline_disable,
          *spesh_osr_disable, *spesh_limit, *spesh_blocking, *spesh_inline_log,
-         *spesh_pea_disable;
+         *spesh_pea_disable, *spesh_gvn_disable, *spesh_licm_disable,
+         *spesh_bce_disable, *spesh_vec_disable,
+         *spesh_unbox_disable,
+         *spesh_workers, *spesh_profile_cache, *spesh_adaptive;
     char *jit_expr_disable, *jit_disable, *jit_last_frame, *jit_last_bb;
     char *dynvar_log;
     int init_stat;
@@ -231,6 +234,21 @@ MVMInstance * MVM_vm_create_instance(void) {
         spesh_pea_disable = getenv("MVM_SPESH_PEA_DISABLE");
         if (!spesh_pea_disable || !spesh_pea_disable[0])
             instance->spesh_pea_enabled = 1;
+        spesh_gvn_disable = getenv("MVM_SPESH_GVN_DISABLE");
+        if (!spesh_gvn_disable || !spesh_gvn_disable[0])
+            instance->spesh_gvn_enabled = 1;
+        spesh_licm_disable = getenv("MVM_SPESH_LICM_DISABLE");
+        if (!spesh_licm_disable || !spesh_licm_disable[0])
+            instance->spesh_licm_enabled = 1;
+        spesh_bce_disable = getenv("MVM_SPESH_BCE_DISABLE");
+        if (!spesh_bce_disable || !spesh_bce_disable[0])
+            instance->spesh_bce_enabled = 1;
+        spesh_vec_disable = getenv("MVM_SPESH_VECTORIZE_DISABLE");
+        if (!spesh_vec_disable || !spesh_vec_disable[0])
+            instance->spesh_vec_enabled = 1;
+        spesh_unbox_disable = getenv("MVM_SPESH_UNBOX_DISABLE");
+        if (!spesh_unbox_disable || !spesh_unbox_disable[0])
+            instance->spesh_unbox_enabled = 1;
     }
 
     init_mutex(instance->mutex_parameterization_add, "parameterization");
@@ -255,16 +273,44 @@ MVMInstance * MVM_vm_create_instance(void) {
     if (spesh_blocking && spesh_blocking[0])
         instance->spesh_blocking = 1;
 
+    /* Should the specialization thresholds adapt to how busy the worker is
+     * and how costly frames are to interpret? Not with no delay, which is
+     * already the lowest threshold there is. */
+    instance->spesh_threshold_percent = 100;
+    spesh_adaptive = getenv("MVM_SPESH_ADAPTIVE");
+    if (spesh_adaptive && spesh_adaptive[0] && !instance->spesh_nodelay)
+        instance->spesh_adaptive_enabled = 1;
+
     /* Should we dump details of inlining? */
     spesh_inline_log = getenv("MVM_SPESH_INLINE_LOG");
     if (spesh_inline_log && spesh_inline_log[0])
         instance->spesh_inline_log = 1;
 
+    /* How many threads should produce specializations? Additional workers
+     * help to get through large plans quickly, but make the spesh log and
+     * the order of specialization (which bisection relies on) unpredictable,
+     * so we stick to a single worker when either is in use. */
+    instance->spesh_num_workers = 1;
+    spesh_workers = getenv("MVM_SPESH_WORKERS");
+    if (spesh_workers && spesh_workers[0] && !instance->spesh_log_fh
+            && !instance->spesh_limit) {
+        int num_workers = atoi(spesh_workers);
+        if (num_workers > MVM_SPESH_MAX_WORKERS)
+            num_workers = MVM_SPESH_MAX_WORKERS;
+        if (num_workers > 1)
+            instance->spesh_num_workers = num_workers;
+    }
+    init_mutex(instance->mutex_spesh_plan, "spesh plan");
+    init_cond(instance->cond_spesh_plan_ready, "spesh plan ready");
+    init_cond(instance->cond_spesh_plan_done, "spesh plan done");
+
     /* JIT environment/logging setup. */
     jit_disable = getenv("MVM_JIT_DISABLE");
     if (!jit_disable || !jit_disable[0])
         instance->jit_enabled = 1;
 
+    MVM_jit_code_heap_init(instance->main_thread);
+
     jit_expr_disable = getenv("MVM_JIT_EXPR_DISABLE");
     if (!jit_expr_disable || strlen(jit_expr_disable) == 0)
         instance->jit_expr_enabled = 1;
@@ -286,6 +332,11 @@ MVMInstance * MVM_vm_create_instance(void) {
             instance->jit_perf_map = fopen(perf_map_filename, "w");
         }
     }
+    {
+        char *jit_perf_dump = getenv("MVM_JIT_PERF_DUMP");
+        if (jit_perf_dump && *jit_perf_dump)
+            MVM_jit_perf_dump_open(instance->main_thread);
+    }
 #endif
 
     {
@@ -397,6 +448,13 @@ MVMInstance * MVM_vm_create_instance(void) {
     MVM_spesh_worker_start(instance->main_thread);
     MVM_spesh_log_initialize_thread(instance->main_thread, 1);
 
+    /* Should we keep specialization profiles across runs, so hot code can be
+     * specialized right away next time? */
+    spesh_profile_cache = getenv("MVM_SPESH_PROFILE_CACHE");
+    if (spesh_profile_cache && spesh_profile_cache[0] && instance->spesh_enabled)
+        instance->spesh_profile_cache = MVM_spesh_profile_cache_load(
+            instance->main_thread, spesh_profile_cache);
+
     /* Back to nursery allocation, now we're set up. */
     MVM_gc_allocate_gen2_default_clear(instance->main_thread);
 
@@ -507,7 +565,8 @@ void MVM_vm_exit(MVMInstance *instance) {
     MVM_thread_join_foreground(instance->main_thread);
     MVM_io_flush_standard_handles(instance->main_thread);
 
-    /* Close any spesh or jit log. */
+    /* Save any spesh profile cache, and close any spesh or jit log. */
+    MVM_spesh_profile_cache_save(instance->main_thread);
     if (instance->spesh_log_fh)
         fclose(instance->spesh_log_fh);
     if (instance->dynvar_log_fh) {
@@ -559,6 +618,9 @@ void MVM_vm_destroy_instance(MVMInstance *instance) {
     MVM_spesh_worker_join(instance->main_thread);
     MVM_io_eventloop_destroy(instance->main_thread);
 
+    /* Save the spesh profile cache, now nothing will add to it. */
+    MVM_spesh_profile_cache_save(instance->main_thread);
+
     /* Run the GC global destruction phase. After this,
      * no 6model object pointers should be accessed. */
     MVM_gc_global_destruction(instance->main_thread);
@@ -633,12 +695,20 @@ void MVM_vm_destroy_instance(MVMInstance *instance) {
 
     /* Clean up spesh mutexes and close any log. */
     uv_mutex_destroy(&instance->mutex_spesh_install);
+    uv_cond_destroy(&instance->cond_spesh_plan_done);
+    uv_cond_destroy(&instance->cond_spesh_plan_ready);
+    uv_mutex_destroy(&instance->mutex_spesh_plan);
+    MVM_free(instance->speshworker_helper_thread_ids);
+    if (instance->spesh_profile_cache)
+        MVM_spesh_profile_cache_destroy(instance->main_thread, instance->spesh_profile_cache);
     uv_cond_destroy(&instance->cond_spesh_sync);
     uv_mutex_destroy(&instance->mutex_spesh_sync);
     if (instance->spesh_log_fh)
         fclose(instance->spesh_log_fh);
     if (instance->jit_perf_map)
         fclose(instance->jit_perf_map);
+    MVM_jit_perf_dump_close(instance->main_thread);
+    MVM_jit_code_heap_destroy(instance->main_thread);
     if (instance->dynvar_log_fh)
         fclose(instance->dynvar_log_fh);
     if (instance->jit_bytecode_dir)
@@ -144,6 +144,11 @@ MVM_PUBLIC const MVMint32 MVM_jit_support(void);
 #include "spesh/dump.h"
 #include "spesh/debug.h"
 #include "spesh/pea.h"
+#include "spesh/gvn.h"
+#include "spesh/licm.h"
+#include "spesh/range.h"
+#include "spesh/vectorize.h"
+#include "spesh/unbox.h"
 #include "spesh/graph.h"
 #include "spesh/codegen.h"
 #include "spesh/candidate.h"
@@ -164,6 +169,7 @@ MVM_PUBLIC const MVMint32 MVM_jit_support(void);
 #include "spesh/worker.h"
 #include "spesh/stats.h"
 #include "spesh/plan.h"
+#include "spesh/profile_cache.h"
 #include "spesh/arg_guard.h"
 #include "spesh/plugin.h"
 #include "spesh/frame_walker.h"
@@ -206,6 +212,9 @@ MVM_PUBLIC const MVMint32 MVM_jit_support(void);
 #include "jit/register.h"
 #include "jit/tile.h"
 #include "jit/compile.h"
+#include "jit/codeheap.h"
+#include "jit/perf.h"
+#include "jit/gdb.h"
 #include "jit/dump.h"
 #include "jit/interface.h"
 #include "profiler/instrument.h"
@@ -1,3 +1,4 @@
+#define MVM_PAGE_NONE    0
 #define MVM_PAGE_READ    1
 #define MVM_PAGE_WRITE   2
 #define MVM_PAGE_EXEC    4
@@ -5,5 +6,7 @@
 void *MVM_platform_alloc_pages(size_t size, int mode);
 int MVM_platform_set_page_mode(void * block, size_t size, int mode);
 int MVM_platform_free_pages(void *block, size_t size);
+int MVM_platform_alloc_dual_pages(size_t size, void **write_view, void **exec_view);
+int MVM_platform_free_dual_pages(void *write_view, void *exec_view, size_t size);
 void *MVM_platform_map_file(int fd, void **handle, size_t size, int writable);
 int MVM_platform_unmap_file(void *block, void *handle, size_t size);
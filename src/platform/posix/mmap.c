@@ -3,6 +3,10 @@
 #include "moar.h"
 #include "platform/mmap.h"
 #include <errno.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
 
 /* MAP_ANONYMOUS is Linux, MAP_ANON is BSD */
 #ifndef MVM_MAP_ANON
@@ -60,6 +64,52 @@ int MVM_platform_free_pages(void *block, size_t size)
     return munmap(block, size) == 0;
 }
 
+/* Maps the same anonymous memory twice: once writable (initially with no
+ * access, so it must be made writable before use) and once readable and
+ * executable. Code can then be written through the one view and run from
+ * the other, without ever having a page that is writable and executable
+ * at once. Returns zero if this is not supported, in which case the caller
+ * should fall back to allocating pages with MVM_platform_alloc_pages. */
+int MVM_platform_alloc_dual_pages(size_t size, void **write_view, void **exec_view)
+{
+#if defined(__linux__) && defined(SYS_memfd_create)
+    void *write_block, *exec_block;
+    int fd = (int)syscall(SYS_memfd_create, "moar-jit", 0);
+    if (fd < 0)
+        return 0;
+    if (ftruncate(fd, size) != 0) {
+        close(fd);
+        return 0;
+    }
+    exec_block = mmap(NULL, size, PROT_READ|PROT_EXEC, MAP_SHARED, fd, 0);
+    if (exec_block == MAP_FAILED) {
+        close(fd);
+        return 0;
+    }
+    write_block = mmap(NULL, size, PROT_NONE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (write_block == MAP_FAILED) {
+        munmap(exec_block, size);
+        return 0;
+    }
+    *write_view = write_block;
+    *exec_view  = exec_block;
+    return 1;
+#else
+    (void)size;
+    (void)write_view;
+    (void)exec_view;
+    return 0;
+#endif
+}
+
+int MVM_platform_free_dual_pages(void *write_view, void *exec_view, size_t size)
+{
+    int write_freed = munmap(write_view, size) == 0;
+    int exec_freed  = munmap(exec_view, size) == 0;
+    return write_freed && exec_freed;
+}
+
 void *MVM_platform_map_file(int fd, void **handle, size_t size, int writable)
 {
     void *block = mmap(NULL, size,
@@ -40,6 +40,46 @@ int MVM_platform_free_pages(void *pages, size_t size) {
     return VirtualFree(pages, 0, MEM_RELEASE);
 }
 
+/* Maps the same pagefile-backed memory twice: once writable (initially with
+ * no access) and once readable and executable; see the POSIX version. */
+int MVM_platform_alloc_dual_pages(size_t size, void **write_view, void **exec_view) {
+    LARGE_INTEGER li;
+    HANDLE mapping;
+    void *write_block, *exec_block;
+    DWORD oldMode;
+
+    li.QuadPart = size;
+    mapping = CreateFileMapping(INVALID_HANDLE_VALUE, NULL, PAGE_EXECUTE_READWRITE,
+        li.HighPart, li.LowPart, NULL);
+    if (mapping == NULL)
+        return 0;
+
+    exec_block = MapViewOfFile(mapping, FILE_MAP_READ | FILE_MAP_EXECUTE, 0, 0, size);
+    write_block = MapViewOfFile(mapping, FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, size);
+
+    /* The views keep the mapping alive. */
+    CloseHandle(mapping);
+    if (exec_block == NULL || write_block == NULL) {
+        if (exec_block)
+            UnmapViewOfFile(exec_block);
+        if (write_block)
+            UnmapViewOfFile(write_block);
+        return 0;
+    }
+    VirtualProtect(write_block, size, PAGE_NOACCESS, &oldMode);
+
+    *write_view = write_block;
+    *exec_view  = exec_block;
+    return 1;
+}
+
+int MVM_platform_free_dual_pages(void *write_view, void *exec_view, size_t size) {
+    BOOL write_freed = UnmapViewOfFile(write_view);
+    BOOL exec_freed = UnmapViewOfFile(exec_view);
+    (void)size;
+    return write_freed && exec_freed;
+}
+
 void *MVM_platform_map_file(int fd, void **handle, size_t size, int writable) {
     HANDLE fh, mapping;
     LARGE_INTEGER li;
@@ -331,7 +331,9 @@ typedef struct {
     MVMString *osr;
     MVMString *deopt_one;
     MVMString *deopt_all;
+    MVMString *deopt_storm;
     MVMString *spesh_time;
+    MVMString *spesh_log_quota_exhausted;
     MVMString *thread;
     MVMString *native_lib;
     MVMString *managed_size;
@@ -539,6 +541,9 @@ static MVMObject * dump_call_graph_node(MVMThreadContext *tc, ProfDumpStrs *pds,
     if (pcn->deopt_all_count)
         MVM_repr_bind_key_o(tc, node_hash, pds->deopt_all,
             box_i(tc, pcn->deopt_all_count));
+    if (pcn->deopt_storm_count)
+        MVM_repr_bind_key_o(tc, node_hash, pds->deopt_storm,
+            box_i(tc, pcn->deopt_storm_count));
 
     if (pcn->num_alloc) {
         /* Emit allocations. */
@@ -672,6 +677,10 @@ static MVMObject * dump_thread_data(MVMThreadContext *tc, ProfDumpStrs *pds,
     MVM_repr_bind_key_o(tc, thread_hash, pds->spesh_time,
         box_i(tc, ptd->spesh_time / 1000));
 
+    /* Add the number of times the thread ran out of spesh log quota. */
+    MVM_repr_bind_key_o(tc, thread_hash, pds->spesh_log_quota_exhausted,
+        box_i(tc, ptd->spesh_log_quota_exhausted));
+
     /* Add thread id. */
     MVM_repr_bind_key_o(tc, thread_hash, pds->thread,
         box_i(tc, othertc->thread_id));
@@ -731,7 +740,9 @@ void MVM_profile_dump_instrumented_data(MVMThreadContext *tc) {
         pds.osr             = str(tc, "osr");
         pds.deopt_one       = str(tc, "deopt_one");
         pds.deopt_all       = str(tc, "deopt_all");
+        pds.deopt_storm     = str(tc, "deopt_storm");
         pds.spesh_time      = str(tc, "spesh_time");
+        pds.spesh_log_quota_exhausted = str(tc, "spesh_log_quota_exhausted");
         pds.thread          = str(tc, "thread");
         pds.native_lib      = str(tc, "native library");
         pds.managed_size    = str(tc, "managed_size");
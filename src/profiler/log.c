@@ -548,3 +548,17 @@ void MVM_profiler_log_deopt_all(MVMThreadContext *tc) {
     if (pcn)
         pcn->deopt_all_count++;
 }
+
+/* Log that a specialization was discarded due to a deopt storm. */
+void MVM_profiler_log_deopt_storm(MVMThreadContext *tc) {
+    MVMProfileThreadData *ptd = get_thread_data(tc);
+    MVMProfileCallNode   *pcn = ptd->current_call;
+    if (pcn)
+        pcn->deopt_storm_count++;
+}
+
+/* Log that the thread ran out of spesh log quota. */
+void MVM_profiler_log_spesh_log_quota_exhausted(MVMThreadContext *tc) {
+    MVMProfileThreadData *ptd = get_thread_data(tc);
+    ptd->spesh_log_quota_exhausted++;
+}
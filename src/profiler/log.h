@@ -34,6 +34,9 @@ struct MVMProfileThreadData {
     /* Amount of time spent in spesh. */
     MVMuint64 spesh_time;
 
+    /* Number of times the thread ran out of spesh log quota. */
+    MVMuint64 spesh_log_quota_exhausted;
+
     /* Current spesh work start time, if any. */
     MVMuint64 cur_spesh_start_time;
 
@@ -148,6 +151,10 @@ struct MVMProfileCallNode {
     /* Number of times deopt_all happened. */
     MVMuint64 deopt_all_count;
 
+    /* Number of times a specialization was discarded because it caused a
+     * deopt storm. */
+    MVMuint64 deopt_storm_count;
+
     /* If the static frame is NULL, we're collecting data on a native call */
     char *native_target_name;
 
@@ -230,3 +237,5 @@ void MVM_profiler_log_spesh_end(MVMThreadContext *tc);
 void MVM_profiler_log_osr(MVMThreadContext *tc, MVMuint64 jitted);
 void MVM_profiler_log_deopt_one(MVMThreadContext *tc);
 void MVM_profiler_log_deopt_all(MVMThreadContext *tc);
+void MVM_profiler_log_deopt_storm(MVMThreadContext *tc);
+void MVM_profiler_log_spesh_log_quota_exhausted(MVMThreadContext *tc);
@@ -300,6 +300,39 @@ void MVM_spesh_arg_guard_add(MVMThreadContext *tc, MVMSpeshArgGuard **orig,
     }
 }
 
+/* Takes a pointer to a guard set. Replaces it with a guard set in which the
+ * specified spesh candidate index is no longer selected, so that another
+ * specialization for the same guard may be added later. Any previous guard
+ * set will be scheduled for freeing at the next safepoint. */
+void MVM_spesh_arg_guard_remove(MVMThreadContext *tc, MVMSpeshArgGuard **orig,
+                                MVMuint32 candidate) {
+    MVMSpeshArgGuard *prev = *orig;
+    MVMSpeshArgGuard *new_guard;
+    MVMuint32 i, j;
+    if (!prev)
+        return;
+    new_guard = copy_and_extend(tc, prev, 0);
+    for (i = 1; i < new_guard->used_nodes; i++) {
+        MVMSpeshArgGuardNode *agn = &(new_guard->nodes[i]);
+        if ((agn->op == MVM_SPESH_GUARD_OP_RESULT || agn->op == MVM_SPESH_GUARD_OP_CERTAIN_RESULT)
+                && agn->result == candidate) {
+            /* Unlink the node; a certain result is skipped over, while for
+             * a result we terminate without one. */
+            MVMuint16 replacement = agn->op == MVM_SPESH_GUARD_OP_CERTAIN_RESULT
+                ? agn->yes
+                : 0;
+            for (j = 0; j < new_guard->used_nodes; j++) {
+                if (new_guard->nodes[j].yes == i)
+                    new_guard->nodes[j].yes = replacement;
+                if (new_guard->nodes[j].no == i)
+                    new_guard->nodes[j].no = replacement;
+            }
+        }
+    }
+    *orig = new_guard;
+    MVM_spesh_arg_guard_destroy(tc, prev, 1);
+}
+
 /* Checks if we already have a guard that precisely matches the specified
  * pair of callsite and type tuple. This is a more exact check that "would
  * the guard match", since a less precise specialization would match if we
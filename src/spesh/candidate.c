@@ -30,6 +30,64 @@ static void spesh_gc_point(MVMThreadContext *tc) {
 #endif
 }
 
+/* Builds the table of entry points for on-stack replacement, from the OSR
+ * deopt annotations on the loop headers of the frame. Those in inlined code
+ * are skipped: their offsets are in the bytecode of the inlinee, and we can't
+ * enter an inline part way through anyway. */
+static void build_osr_entries(MVMThreadContext *tc, MVMSpeshGraph *sg,
+                              MVMSpeshCandidate *candidate) {
+    MVM_VECTOR_DECL(MVMSpeshOSREntry, entries);
+    MVMSpeshBB *bb = sg->entry;
+    MVM_VECTOR_INIT(entries, 0);
+    while (bb) {
+        MVMSpeshIns *ins = bb->inlined ? NULL : bb->first_ins;
+        while (ins) {
+            MVMSpeshAnn *ann = ins->annotations;
+            while (ann) {
+                if (ann->type == MVM_SPESH_ANN_DEOPT_OSR) {
+                    MVMSpeshOSREntry entry;
+                    MVMuint32 i;
+                    entry.bytecode_offset = sg->deopt_addrs[2 * ann->data.deopt_idx];
+                    entry.deopt_idx = ann->data.deopt_idx;
+                    entry.jit_label = -1;
+
+                    /* Insert it in order of bytecode offset; there are only
+                     * ever a handful. */
+                    MVM_VECTOR_PUSH(entries, entry);
+                    i = MVM_VECTOR_ELEMS(entries) - 1;
+                    while (i > 0 && entries[i - 1].bytecode_offset > entry.bytecode_offset) {
+                        entries[i] = entries[i - 1];
+                        i--;
+                    }
+                    entries[i] = entry;
+                }
+                ann = ann->next;
+            }
+            ins = ins->next;
+        }
+        bb = bb->linear_next;
+    }
+    candidate->osr_entries = entries;
+    candidate->num_osr_entries = MVM_VECTOR_ELEMS(entries);
+}
+
+/* Looks up the JIT labels of the OSR entry points, so entering JIT code by
+ * OSR doesn't have to search for them. */
+static void add_osr_jit_labels(MVMThreadContext *tc, MVMSpeshCandidate *candidate) {
+    MVMJitCode *jitcode = candidate->jitcode;
+    MVMuint32 i;
+    for (i = 0; i < candidate->num_osr_entries; i++) {
+        MVMSpeshOSREntry *entry = &(candidate->osr_entries[i]);
+        MVMint32 j;
+        for (j = 0; j < jitcode->num_deopts; j++) {
+            if (jitcode->deopts[j].idx == entry->deopt_idx) {
+                entry->jit_label = jitcode->deopts[j].label;
+                break;
+            }
+        }
+    }
+}
+
 /* Produces and installs a specialized version of the code, according to the
  * specified plan. */
 void MVM_spesh_candidate_add(MVMThreadContext *tc, MVMSpeshPlanned *p) {
@@ -41,7 +99,7 @@ void MVM_spesh_candidate_add(MVMThreadContext *tc, MVMSpeshPlanned *p) {
     MVMuint64 start_time, spesh_time, jit_time, end_time;
 
     /* If we've reached our specialization limit, don't continue. */
-    MVMint32 spesh_produced = ++tc->instance->spesh_produced;
+    MVMint32 spesh_produced = (MVMint32)MVM_incr(&(tc->instance->spesh_produced)) + 1;
     if (tc->instance->spesh_limit)
         if (spesh_produced > tc->instance->spesh_limit)
             return;
@@ -101,6 +159,7 @@ void MVM_spesh_candidate_add(MVMThreadContext *tc, MVMSpeshPlanned *p) {
     candidate->num_handlers  = sg->num_handlers;
     candidate->num_deopts    = sg->num_deopt_addrs;
     candidate->deopts        = sg->deopt_addrs;
+    candidate->deopt_counts  = MVM_calloc(sg->num_deopt_addrs + 1, sizeof(MVMuint32));
     candidate->deopt_named_used_bit_field = sg->deopt_named_used_bit_field;
     candidate->deopt_pea     = sg->deopt_pea;
     candidate->num_locals    = sg->num_locals;
@@ -111,6 +170,7 @@ void MVM_spesh_candidate_add(MVMThreadContext *tc, MVMSpeshPlanned *p) {
     candidate->lexical_types = sg->lexical_types;
 
     MVM_free(sc);
+    build_osr_entries(tc, sg, candidate);
 
     /* Try to JIT compile the optimised graph. The JIT graph hangs from
      * the spesh graph and can safely be deleted with it. */
@@ -123,6 +183,8 @@ void MVM_spesh_candidate_add(MVMThreadContext *tc, MVMSpeshPlanned *p) {
         if (jg != NULL) {
             candidate->jitcode = MVM_jit_compile_graph(tc, jg);
             MVM_jit_graph_destroy(tc, jg);
+            if (candidate->jitcode)
+                add_osr_jit_labels(tc, candidate);
         }
     }
 
@@ -160,6 +222,10 @@ void MVM_spesh_candidate_add(MVMThreadContext *tc, MVMSpeshPlanned *p) {
     sg->cand = candidate;
     MVM_spesh_graph_destroy(tc, sg);
 
+    /* Several workers may be producing specializations of the same frame,
+     * so installation of the candidate and its guards is done under lock. */
+    uv_mutex_lock(&tc->instance->mutex_spesh_install);
+
     /* Create a new candidate list and copy any existing ones. Free memory
      * using the FSA safepoint mechanism. */
     spesh = p->sf->body.spesh;
@@ -190,6 +256,7 @@ void MVM_spesh_candidate_add(MVMThreadContext *tc, MVMSpeshPlanned *p) {
         p->cs_stats->cs, p->type_tuple, spesh->body.num_spesh_candidates);
     MVM_barrier();
     spesh->body.num_spesh_candidates++;
+    uv_mutex_unlock(&tc->instance->mutex_spesh_install);
 
     /* If we're logging, dump the upadated arg guards also. */
     if (MVM_spesh_debug_enabled(tc)) {
@@ -199,6 +266,10 @@ void MVM_spesh_candidate_add(MVMThreadContext *tc, MVMSpeshPlanned *p) {
         MVM_free(guard_dump);
     }
 
+    /* Remember what we produced for next time, if there's a profile cache. */
+    if (tc->instance->spesh_profile_cache)
+        MVM_spesh_profile_cache_record(tc, p, candidate->jitcode != NULL);
+
 #if MVM_GC_DEBUG
     tc->in_spesh = 0;
 #endif
@@ -217,5 +288,77 @@ void MVM_spesh_candidate_destroy(MVMThreadContext *tc, MVMSpeshCandidate *candid
     if (candidate->jitcode)
         MVM_jit_code_destroy(tc, candidate->jitcode);
     MVM_free(candidate->deopt_usage_info);
+    MVM_free(candidate->deopt_counts);
+    MVM_free(candidate->osr_entries);
     MVM_free(candidate);
 }
+
+/* Records a bytecode offset that had a deopt storm. Must be called with the
+ * spesh install lock held. */
+static void add_deopt_storm_offset(MVMThreadContext *tc, MVMStaticFrameSpesh *spesh,
+                                   MVMuint32 offset) {
+    MVMuint32 *orig = spesh->body.deopt_storm_offsets;
+    MVMuint32 num_orig = orig ? orig[0] : 0;
+    MVMuint32 *updated;
+    MVMuint32 i;
+    for (i = 1; i <= num_orig; i++)
+        if (orig[i] == offset)
+            return;
+    updated = MVM_fixed_size_alloc(tc, tc->instance->fsa,
+        (num_orig + 2) * sizeof(MVMuint32));
+    if (num_orig)
+        memcpy(updated + 1, orig + 1, num_orig * sizeof(MVMuint32));
+    updated[0] = num_orig + 1;
+    updated[num_orig + 1] = offset;
+    MVM_barrier();
+    spesh->body.deopt_storm_offsets = updated;
+    if (orig)
+        MVM_fixed_size_free_at_safepoint(tc, tc->instance->fsa,
+            (num_orig + 1) * sizeof(MVMuint32), orig);
+}
+
+/* Discards a candidate that was found to be in a deopt storm, so that it is
+ * no longer selected and a new one may be produced in its place. If a static
+ * frame is passed, the deopt point at the specified bytecode offset in it is
+ * remembered, so specializations won't speculate there again. */
+void MVM_spesh_candidate_discard(MVMThreadContext *tc, MVMStaticFrame *sf,
+                                 MVMSpeshCandidate *candidate, MVMStaticFrame *storm_sf,
+                                 MVMuint32 storm_offset) {
+    MVMStaticFrameSpesh *spesh = sf->body.spesh;
+    MVMuint64 now;
+    MVMuint32 i;
+    uv_mutex_lock(&tc->instance->mutex_spesh_install);
+    if (!candidate->discarded) {
+        candidate->discarded = 1;
+        for (i = 0; i < spesh->body.num_spesh_candidates; i++)
+            if (spesh->body.spesh_candidates[i] == candidate)
+                MVM_spesh_arg_guard_remove(tc, &(spesh->body.spesh_arg_guard), i);
+        if (storm_sf && storm_sf->body.spesh)
+            add_deopt_storm_offset(tc, storm_sf->body.spesh, storm_offset);
+
+        /* Unless this keeps happening, have the frame logged again so it can
+         * be specialized anew. A storm long after the previous one starts
+         * the count over. */
+        now = uv_hrtime();
+        if (now - spesh->body.last_deopt_storm > MVM_SPESH_DEOPT_STORM_DECAY_NS)
+            spesh->body.num_deopt_storms = 0;
+        spesh->body.last_deopt_storm = now;
+        if (++spesh->body.num_deopt_storms < MVM_SPESH_DEOPT_STORM_MAX_DISCARDS)
+            spesh->body.spesh_entries_recorded = 0;
+    }
+    uv_mutex_unlock(&tc->instance->mutex_spesh_install);
+}
+
+/* Checks if a deopt point at the specified bytecode offset of a static frame
+ * had a deopt storm, meaning we should not speculate there. */
+MVMuint32 MVM_spesh_candidate_deopt_storm_at(MVMThreadContext *tc, MVMStaticFrame *sf,
+                                             MVMuint32 offset) {
+    MVMuint32 *offsets = sf->body.spesh ? sf->body.spesh->body.deopt_storm_offsets : NULL;
+    if (offsets) {
+        MVMuint32 i;
+        for (i = 1; i <= offsets[0]; i++)
+            if (offsets[i] == offset)
+                return 1;
+    }
+    return 0;
+}
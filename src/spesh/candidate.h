@@ -59,6 +59,11 @@ struct MVMSpeshCandidate {
     /* JIT-code structure. */
     MVMJitCode *jitcode;
 
+    /* Entry points for on-stack replacement, one per loop header of the
+     * frame itself (not of its inlines), sorted by bytecode offset. */
+    MVMSpeshOSREntry *osr_entries;
+    MVMuint32 num_osr_entries;
+
     /* Information used to reconstruct deoptimization usage info should we do
      * an inline of this candidate. It's stored as a sequence of integers of
      * the form:
@@ -68,8 +73,50 @@ struct MVMSpeshCandidate {
      *  There is a trailing -1 bytecode offset to mark the end of the data.
      */
     MVMint32 *deopt_usage_info;
+
+    /* The number of times a guard failing made us deoptimize out of this
+     * candidate, both in total and per deopt index, since the start of the
+     * current deopt storm window (a uv_hrtime value). These are updated
+     * without synchronization, so may be a little off if several threads run
+     * the candidate, which is fine for spotting deopt storms. */
+    MVMuint32 deopt_count;
+    MVMuint32 *deopt_counts;
+    MVMuint64 deopt_window_start;
+
+    /* Set if the candidate was discarded due to a deopt storm, after which
+     * it is no longer selected by the argument guards. */
+    MVMuint8 discarded;
 };
 
+/* An entry point for on-stack replacement. Maps the offset just after an
+ * osrpoint in the original bytecode to the deopt index that gives the place
+ * to enter the specialized bytecode, and to the label to enter the JIT code
+ * at (or -1 if there is no JIT code). */
+struct MVMSpeshOSREntry {
+    MVMuint32 bytecode_offset;
+    MVMint32 deopt_idx;
+    MVMint32 jit_label;
+};
+
+/* The number of deopts from a single deopt point, and from a candidate as a
+ * whole, within a single window of the given number of nanoseconds, at which
+ * we consider the candidate to be in a deopt storm. The counts start over in
+ * each window, so a candidate that deopts now and then over a long run does
+ * not add up to a storm. */
+#define MVM_SPESH_DEOPT_STORM_THRESHOLD             100
+#define MVM_SPESH_DEOPT_STORM_CANDIDATE_THRESHOLD   1000
+#define MVM_SPESH_DEOPT_STORM_WINDOW_NS             10000000
+
+/* The number of candidates of a frame we may discard due to deopt storms
+ * before we stop specializing it again. Storms only count towards this if
+ * they follow the previous one within the given number of nanoseconds. */
+#define MVM_SPESH_DEOPT_STORM_MAX_DISCARDS          4
+#define MVM_SPESH_DEOPT_STORM_DECAY_NS              10000000000ULL
+
 /* Functions for creating and clearing up specializations. */
 void MVM_spesh_candidate_add(MVMThreadContext *tc, MVMSpeshPlanned *p);
 void MVM_spesh_candidate_destroy(MVMThreadContext *tc, MVMSpeshCandidate *candidate);
+void MVM_spesh_candidate_discard(MVMThreadContext *tc, MVMStaticFrame *sf,
+    MVMSpeshCandidate *candidate, MVMStaticFrame *storm_sf, MVMuint32 storm_offset);
+MVMuint32 MVM_spesh_candidate_deopt_storm_at(MVMThreadContext *tc, MVMStaticFrame *sf,
+    MVMuint32 offset);
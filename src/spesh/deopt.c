@@ -162,55 +162,123 @@ static void deopt_named_args_used(MVMThreadContext *tc, MVMFrame *f) {
         f->params.named_used.bit_field = f->spesh_cand->deopt_named_used_bit_field;
 }
 
-/* Materialize an individual replaced object. */
-static void materialize_object(MVMThreadContext *tc, MVMFrame *f, MVMObject ***materialized,
-                               MVMuint16 info_idx, MVMuint16 target_reg) {
+/* Materialize a scalar-replaced P6opaque, filling in its attributes. */
+static MVMObject * materialize_p6opaque(MVMThreadContext *tc, MVMFrame *f,
+                                        MVMSpeshPEAMaterializeInfo *mi, MVMSTable *st) {
+    MVMP6opaqueREPRData *repr_data = (MVMP6opaqueREPRData *)st->REPR_data;
+    MVMuint32 num_attrs = repr_data->num_attributes;
+    MVMObject *obj;
+    char *data;
+    MVMuint32 i;
+    MVMROOT(tc, f, {
+        obj = MVM_gc_allocate_object(tc, st);
+    });
+    data = (char *)OBJECT_BODY(obj);
+    for (i = 0; i < num_attrs; i++) {
+        MVMRegister value = f->work[mi->attr_regs[i]];
+        MVMuint16 offset = repr_data->attribute_offsets[i];
+        MVMSTable *flattened = repr_data->flattened_stables[i];
+        if (flattened) {
+            const MVMStorageSpec *ss = flattened->REPR->get_storage_spec(tc, flattened);
+            switch (ss->boxed_primitive) {
+                case MVM_STORAGE_SPEC_BP_INT:
+                    flattened->REPR->box_funcs.set_int(tc, flattened, obj,
+                        (char *)data + offset, value.i64);
+                    break;
+                case MVM_STORAGE_SPEC_BP_NUM:
+                    flattened->REPR->box_funcs.set_num(tc, flattened, obj,
+                        (char *)data + offset, value.n64);
+                    break;
+                case MVM_STORAGE_SPEC_BP_STR:
+                    flattened->REPR->box_funcs.set_str(tc, flattened, obj,
+                        (char *)data + offset, value.s);
+                    break;
+                default:
+                    MVM_panic(1, "Unimplemented case of native attribute deopt materialization");
+            }
+        }
+        else {
+            *((MVMObject **)(data + offset)) = value.o;
+        }
+    }
+    return obj;
+}
+
+/* Materialize a scalar-replaced VMArray or MVMHash, adding its elements
+ * one at a time. */
+static MVMObject * materialize_elements(MVMThreadContext *tc, MVMFrame *f,
+                                        MVMSpeshPEAMaterializeInfo *mi, MVMSTable *st) {
+    MVMObject *obj;
+    MVMROOT(tc, f, {
+        obj = MVM_gc_allocate_object(tc, st);
+    });
+    MVMROOT2(tc, obj, f, {
+        MVMuint32 i;
+        for (i = 0; i < mi->num_attr_regs; i++) {
+            MVMRegister value = f->work[mi->attr_regs[i]];
+            if (st->REPR->ID == MVM_REPR_ID_MVMHash) {
+                MVMString *key = (MVMString *)f->spesh_cand->spesh_slots[mi->key_sslots[i]];
+                MVM_repr_bind_key_o(tc, obj, key, value.o);
+            }
+            else {
+                switch (((MVMArrayREPRData *)st->REPR_data)->slot_type) {
+                    case MVM_ARRAY_OBJ:
+                        MVM_repr_push_o(tc, obj, value.o);
+                        break;
+                    case MVM_ARRAY_STR:
+                        MVM_repr_push_s(tc, obj, value.s);
+                        break;
+                    case MVM_ARRAY_I64:
+                        MVM_repr_push_i(tc, obj, value.i64);
+                        break;
+                    case MVM_ARRAY_N64:
+                        MVM_repr_push_n(tc, obj, value.n64);
+                        break;
+                    default:
+                        MVM_panic(1, "Unimplemented case of array element deopt materialization");
+                }
+            }
+        }
+    });
+    return obj;
+}
+
+/* Materialize a box that was kept unboxed, from its native register. */
+static MVMObject * materialize_box(MVMThreadContext *tc, MVMFrame *f,
+                                   MVMSpeshPEAMaterializeInfo *mi, MVMSTable *st) {
+    MVMRegister value = f->work[mi->attr_regs[0]];
+    return mi->unboxed_kind == MVM_reg_num64
+        ? MVM_repr_box_num(tc, st->WHAT, value.n64)
+        : MVM_repr_box_int(tc, st->WHAT, value.i64);
+}
+
+/* Materialize an individual replaced object. Returns non-zero if a new
+ * object was made, in which case its slot in the materialized array was
+ * pushed as a temporary root, since making the next one may GC. */
+static MVMuint32 materialize_object(MVMThreadContext *tc, MVMFrame *f, MVMObject ***materialized,
+                                    MVMuint16 info_idx, MVMuint16 target_reg) {
     MVMSpeshCandidate *cand = f->spesh_cand;
+    MVMuint32 made = 0;
     if (!*materialized)
         *materialized = MVM_calloc(MVM_VECTOR_ELEMS(cand->deopt_pea.materialize_info), sizeof(MVMObject *));
     if (!(*materialized)[info_idx]) {
         MVMSpeshPEAMaterializeInfo *mi = &(cand->deopt_pea.materialize_info[info_idx]);
         MVMSTable *st = (MVMSTable *)cand->spesh_slots[mi->stable_sslot];
-        MVMP6opaqueREPRData *repr_data = (MVMP6opaqueREPRData *)st->REPR_data;
         MVMROOT(tc, f, {
-            MVMObject *obj = MVM_gc_allocate_object(tc, st);
-            char *data = (char *)OBJECT_BODY(obj);
-            MVMuint32 num_attrs = repr_data->num_attributes;
-            MVMuint32 i;
-            for (i = 0; i < num_attrs; i++) {
-                MVMRegister value = f->work[mi->attr_regs[i]];
-                MVMuint16 offset = repr_data->attribute_offsets[i];
-                MVMSTable *flattened = repr_data->flattened_stables[i];
-                if (flattened) {
-                    const MVMStorageSpec *ss = flattened->REPR->get_storage_spec(tc, flattened);
-                    switch (ss->boxed_primitive) {
-                        case MVM_STORAGE_SPEC_BP_INT:
-                            flattened->REPR->box_funcs.set_int(tc, flattened, obj,
-                                (char *)data + offset, value.i64);
-                            break;
-                        case MVM_STORAGE_SPEC_BP_NUM:
-                            flattened->REPR->box_funcs.set_num(tc, flattened, obj,
-                                (char *)data + offset, value.n64);
-                            break;
-                        case MVM_STORAGE_SPEC_BP_STR:
-                            flattened->REPR->box_funcs.set_str(tc, flattened, obj,
-                                (char *)data + offset, value.s);
-                            break;
-                        default:
-                            MVM_panic(1, "Unimplemented case of native attribute deopt materialization");
-                    }
-                }
-                else {
-                    *((MVMObject **)(data + offset)) = value.o;
-                }
-            }
-            (*materialized)[info_idx] = obj;
+            (*materialized)[info_idx] = mi->unboxed_kind
+                ? materialize_box(tc, f, mi, st)
+                : st->REPR->ID == MVM_REPR_ID_P6opaque
+                ? materialize_p6opaque(tc, f, mi, st)
+                : materialize_elements(tc, f, mi, st);
         });
+        MVM_gc_root_temp_push(tc, (MVMCollectable **)&((*materialized)[info_idx]));
+        made = 1;
 #if MVM_LOG_DEOPTS
         fprintf(stderr, "    Materialized a %s\n", st->debug_name);
 #endif
     }
     f->work[target_reg].o = (*materialized)[info_idx];
+    return made;
 }
 
 /* Materialize all replaced objects that need to be at this deopt index. */
@@ -219,13 +287,16 @@ static void materialize_replaced_objects(MVMThreadContext *tc, MVMFrame *f, MVMi
     MVMSpeshCandidate *cand = f->spesh_cand;
     MVMuint32 num_deopt_points = MVM_VECTOR_ELEMS(cand->deopt_pea.deopt_point);
     MVMObject **materialized = NULL;
+    MVMuint32 num_made = 0;
     MVMROOT(tc, f, {
         for (i = 0; i < num_deopt_points; i++) {
             MVMSpeshPEADeoptPoint *dp = &(cand->deopt_pea.deopt_point[i]);
             if (dp->deopt_point_idx == deopt_index)
-                materialize_object(tc, f, &materialized, dp->materialize_info_idx, dp->target_reg);
+                num_made += materialize_object(tc, f, &materialized,
+                    dp->materialize_info_idx, dp->target_reg);
         }
     });
+    MVM_gc_root_temp_pop_n(tc, num_made);
     MVM_free(materialized);
 }
 
@@ -273,6 +344,48 @@ static void deopt_frame(MVMThreadContext *tc, MVMFrame *f, MVMuint32 deopt_idx,
     }
 }
 
+/* Counts a deopt due to a guard failing in the specialization a frame is
+ * running. If a single deopt point, or the candidate as a whole, deopts too
+ * often within a storm window, then the speculation it was made with is not holding up and we are
+ * in a deopt storm; the candidate is discarded so a new one may be made. In
+ * the case of a single deopt point, we also remember it (in the frame that
+ * was inlined, if it is in an inline) so we won't speculate there again. */
+static void count_deopt(MVMThreadContext *tc, MVMFrame *f, MVMuint32 deopt_idx,
+                        MVMuint32 deopt_offset, MVMuint32 deopt_target) {
+    MVMSpeshCandidate *cand = f->spesh_cand;
+    MVMuint32 point_storm, cand_storm;
+    MVMuint64 now;
+    if (cand->discarded)
+        return;
+    now = uv_hrtime();
+    if (now - cand->deopt_window_start > MVM_SPESH_DEOPT_STORM_WINDOW_NS) {
+        memset(cand->deopt_counts, 0, (cand->num_deopts + 1) * sizeof(MVMuint32));
+        cand->deopt_count = 0;
+        cand->deopt_window_start = now;
+    }
+    point_storm = ++cand->deopt_counts[deopt_idx] >= MVM_SPESH_DEOPT_STORM_THRESHOLD;
+    cand_storm = ++cand->deopt_count >= MVM_SPESH_DEOPT_STORM_CANDIDATE_THRESHOLD;
+    if (point_storm || cand_storm) {
+        MVMStaticFrame *storm_sf = NULL;
+        if (point_storm) {
+            MVMint32 i;
+            storm_sf = f->static_info;
+            for (i = 0; i < cand->num_inlines; i++) {
+                if (deopt_offset > cand->inlines[i].start && deopt_offset <= cand->inlines[i].end) {
+                    storm_sf = cand->inlines[i].sf;
+                    break;
+                }
+            }
+        }
+#if MVM_LOG_DEOPTS
+        fprintf(stderr, "    Deopt storm; discarding specialization\n");
+#endif
+        MVM_spesh_candidate_discard(tc, f->static_info, cand, storm_sf, deopt_target);
+        if (tc->instance->profiling)
+            MVM_profiler_log_deopt_storm(tc);
+    }
+}
+
 /* De-optimizes the currently executing frame, provided it is specialized and
  * at a valid de-optimization point. Typically used when a guard fails. */
 void MVM_spesh_deopt_one(MVMThreadContext *tc, MVMuint32 deopt_idx) {
@@ -293,6 +406,7 @@ void MVM_spesh_deopt_one(MVMThreadContext *tc, MVMuint32 deopt_idx) {
 #if MVM_LOG_DEOPTS
         fprintf(stderr, "    Will deopt %u -> %u\n", deopt_offset, deopt_target);
 #endif
+        count_deopt(tc, f, deopt_idx, deopt_offset, deopt_target);
         deopt_frame(tc, tc->cur_frame, deopt_idx, deopt_offset, deopt_target);
     }
     else {
@@ -589,7 +589,8 @@ static void dump_deopt_pea(MVMThreadContext *tc, DumpStr *ds, MVMSpeshGraph *g)
         for (i = 0; i < MVM_VECTOR_ELEMS(g->deopt_pea.materialize_info); i++) {
             MVMSpeshPEAMaterializeInfo *mat = &(g->deopt_pea.materialize_info[i]);
             MVMSTable *st = (MVMSTable *)g->spesh_slots[mat->stable_sslot];
-            appendf(ds, "  %d: %s from regs ", i, st->debug_name);
+            appendf(ds, mat->unboxed_kind ? "  %d: %s boxed from regs " : "  %d: %s from regs ",
+                i, st->debug_name);
             for (j = 0; j < mat->num_attr_regs; j++)
                 appendf(ds, j > 0 ? ", r%hu" : "r%hu", mat->attr_regs[j]);
             append(ds, "\n");
@@ -603,6 +604,14 @@ static void dump_deopt_pea(MVMThreadContext *tc, DumpStr *ds, MVMSpeshGraph *g)
                     dp->materialize_info_idx, dp->target_reg);
         }
     }
+    if (MVM_VECTOR_ELEMS(g->deopt_pea.osr_unbox)) {
+        append(ds, "\nOSR unboxing:\n");
+        for (i = 0; i < MVM_VECTOR_ELEMS(g->deopt_pea.osr_unbox); i++) {
+            MVMSpeshPEAOSRUnbox *ou = &(g->deopt_pea.osr_unbox[i]);
+            appendf(ds, "  At %d unbox r%d into r%d\n", ou->deopt_idx,
+                    ou->obj_reg, ou->native_reg);
+        }
+    }
 }
 
 /* Dump a spesh graph into string form, for debugging purposes. */
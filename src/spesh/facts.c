@@ -195,6 +195,9 @@ static void literal_facts(MVMThreadContext *tc, MVMSpeshGraph *g, MVMSpeshIns *i
             return;
     }
     tgt_facts->flags |= MVM_SPESH_FACT_KNOWN_VALUE;
+    if (ins->info->opcode != MVM_OP_const_s && ins->info->opcode != MVM_OP_const_n32 &&
+            ins->info->opcode != MVM_OP_const_n64 && tgt_facts->value.i >= 0)
+        tgt_facts->flags |= MVM_SPESH_FACT_NON_NEGATIVE;
 }
 static void getstringfrom_facts(MVMThreadContext *tc, MVMSpeshGraph *g, MVMSpeshIns *ins) {
     MVMCompUnit *dep = (MVMCompUnit *)g->spesh_slots[ins->operands[1].lit_i16];
@@ -287,6 +290,12 @@ static void log_facts(MVMThreadContext *tc, MVMSpeshGraph *g, MVMSpeshBB *bb,
     MVMuint32 agg_type_object = 0;
     MVMuint32 agg_concrete = 0;
     MVMuint32 i;
+
+    /* If a guard here caused a deopt storm before, don't speculate. */
+    if (MVM_spesh_candidate_deopt_storm_at(tc, g->sf,
+            g->deopt_addrs[2 * deopt_one_ann->data.deopt_idx]))
+        return;
+
     for (i = 0; i < p->num_type_stats; i++) {
         MVMSpeshStatsByType *ts = p->type_stats[i];
         MVMuint32 j;
@@ -707,6 +716,14 @@ static void add_bb_facts(MVMThreadContext *tc, MVMSpeshGraph *g, MVMSpeshBB *bb,
                 g->sf->body.cu->body.hll_config->str_pos_ref);
             break;
 
+        case MVM_OP_elems:
+        case MVM_OP_chars:
+        case MVM_OP_graphs_s:
+        case MVM_OP_codes_s:
+            g->facts[ins->operands[0].reg.orig][ins->operands[0].reg.i].flags
+                |= MVM_SPESH_FACT_NON_NEGATIVE;
+            break;
+
         case MVM_OP_const_i64:
         case MVM_OP_const_i32:
         case MVM_OP_const_i16:
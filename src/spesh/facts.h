@@ -50,6 +50,7 @@ struct MVMSpeshFacts {
                                                     (mutually exclusive with HASH_ITER, but neither of them is necessarily set) */
 #define MVM_SPESH_FACT_KNOWN_BOX_SRC        2048 /* We know what register this value was boxed from */
 #define MVM_SPESH_FACT_RW_CONT              8192 /* Known to be an rw container */
+#define MVM_SPESH_FACT_NON_NEGATIVE         16384 /* Known to be an integer >= 0 */
 
 void MVM_spesh_facts_discover(MVMThreadContext *tc, MVMSpeshGraph *g, MVMSpeshPlanned *p,
     MVMuint32 is_specialized);
@@ -79,6 +79,10 @@ struct MVMSpeshGraph {
     MVMSpeshInline *inlines;
     MVMint32 num_inlines;
 
+    /* Total bytecode size inlined into this graph so far, which is counted
+     * against the inlining budget of the caller. */
+    MVMuint32 inlined_bytecode_size;
+
     /* Number of basic blocks we have. */
     MVMint32 num_bbs;
 
@@ -0,0 +1,458 @@
+#include "moar.h"
+
+/* Global value numbering, eliminating redundant computations. We walk the
+ * dominator tree, keeping a table of the instructions we have seen that are
+ * available at the current point. If an instruction computes the same thing
+ * as one that dominates it, it is turned into a `set` from the result of the
+ * earlier one (or, for guards that don't write a register, deleted). The
+ * post-inline set elimination and dead instruction elimination will then
+ * usually clean up after us. Since SSA versions of a register share storage,
+ * the earlier result may be overwritten by the time the later instruction
+ * runs, so the first time we reuse a result we have the instruction write it
+ * to a new register that nothing else writes, and copy it from there.
+ *
+ * Two values are considered equal if they are the same SSA version, or if
+ * one is copied from the other by a `set` or a guard. We consider three
+ * kinds of instruction:
+ *
+ * 1. Pure instructions that depend only on their operands (arithmetic,
+ *    comparisons, concreteness and null checks).
+ * 2. Reads of attributes and other object memory. These are only reused if
+ *    nothing that may write memory or run code has happened in between, so
+ *    we only carry them forward within a block and into blocks that are only
+ *    reachable from it.
+ * 3. Guards. A guard on a value that is dominated by an identical guard on
+ *    the same value can never fail, so is not needed.
+ */
+
+/* Kinds of instruction we can number. */
+#define GVN_NONE   0
+#define GVN_PURE   1
+#define GVN_MEMORY 2
+#define GVN_GUARD  3
+
+/* Number of buckets in the available instruction table. */
+#define GVN_BUCKETS 256
+
+/* An instruction available at the current point. */
+typedef struct GVNEntry GVNEntry;
+struct GVNEntry {
+    /* The instruction, the block it is in, and its hash. */
+    MVMSpeshIns *ins;
+    MVMSpeshBB *bb;
+    MVMuint32 hash;
+
+    /* Whether we moved its result into a register of its own yet. */
+    MVMuint32 split;
+
+    /* For memory reads, the memory epoch it was read in. */
+    MVMuint32 epoch;
+
+    /* The next entry in the bucket. */
+    GVNEntry *next;
+};
+
+/* State for the pass. */
+typedef struct {
+    /* Hash buckets of available instructions. */
+    GVNEntry *buckets[GVN_BUCKETS];
+
+    /* Entries in the order they were added, so we can remove those added in
+     * a dominator subtree when we leave it. */
+    MVM_VECTOR_DECL(GVNEntry *, added);
+
+    /* The current memory epoch, and the last one we handed out. Any
+     * instruction that may write to memory or run code starts a new one. */
+    MVMuint32 epoch;
+    MVMuint32 last_epoch;
+
+    /* Number of instructions we eliminated. */
+    MVMuint32 eliminated;
+} GVNState;
+
+/* Work out how we may number the instruction. */
+static MVMuint32 gvn_kind(MVMSpeshIns *ins) {
+    switch (ins->info->opcode) {
+        case MVM_OP_add_i:
+        case MVM_OP_sub_i:
+        case MVM_OP_mul_i:
+        case MVM_OP_neg_i:
+        case MVM_OP_abs_i:
+        case MVM_OP_band_i:
+        case MVM_OP_bor_i:
+        case MVM_OP_bxor_i:
+        case MVM_OP_bnot_i:
+        case MVM_OP_blshift_i:
+        case MVM_OP_brshift_i:
+        case MVM_OP_not_i:
+        case MVM_OP_eq_i:
+        case MVM_OP_ne_i:
+        case MVM_OP_lt_i:
+        case MVM_OP_le_i:
+        case MVM_OP_gt_i:
+        case MVM_OP_ge_i:
+        case MVM_OP_cmp_i:
+        case MVM_OP_add_n:
+        case MVM_OP_sub_n:
+        case MVM_OP_mul_n:
+        case MVM_OP_div_n:
+        case MVM_OP_neg_n:
+        case MVM_OP_abs_n:
+        case MVM_OP_eq_n:
+        case MVM_OP_ne_n:
+        case MVM_OP_lt_n:
+        case MVM_OP_le_n:
+        case MVM_OP_gt_n:
+        case MVM_OP_ge_n:
+        case MVM_OP_cmp_n:
+        case MVM_OP_coerce_in:
+        case MVM_OP_isconcrete:
+        case MVM_OP_isnull:
+        case MVM_OP_isnonnull:
+        case MVM_OP_eqaddr:
+            return GVN_PURE;
+        case MVM_OP_sp_p6oget_o:
+        case MVM_OP_sp_p6oget_i:
+        case MVM_OP_sp_p6oget_n:
+        case MVM_OP_sp_p6oget_s:
+        case MVM_OP_sp_p6oget_bi:
+        case MVM_OP_sp_p6oget_i32:
+        case MVM_OP_sp_get_o:
+        case MVM_OP_sp_get_i64:
+        case MVM_OP_sp_get_i32:
+        case MVM_OP_sp_get_i16:
+        case MVM_OP_sp_get_i8:
+        case MVM_OP_sp_get_n:
+        case MVM_OP_sp_get_s:
+            return GVN_MEMORY;
+        case MVM_OP_sp_guard:
+        case MVM_OP_sp_guardconc:
+        case MVM_OP_sp_guardtype:
+        case MVM_OP_sp_guardobj:
+        case MVM_OP_sp_guardnotobj:
+        case MVM_OP_sp_guardjustconc:
+        case MVM_OP_sp_guardjusttype:
+        case MVM_OP_sp_guardsf:
+        case MVM_OP_sp_guardsfouter:
+            return GVN_GUARD;
+        default:
+            return GVN_NONE;
+    }
+}
+
+/* Checks if the instruction may write to memory or run code, meaning that
+ * memory reads before it cannot be reused after it. */
+static MVMuint32 may_write(MVMSpeshIns *ins) {
+    switch (ins->info->opcode) {
+        case MVM_SSA_PHI:
+        case MVM_OP_set:
+        case MVM_OP_goto:
+        case MVM_OP_if_i:
+        case MVM_OP_unless_i:
+        case MVM_OP_if_n:
+        case MVM_OP_unless_n:
+            return 0;
+        default:
+            if (gvn_kind(ins) != GVN_NONE)
+                return 0;
+            return !ins->info->pure || (ins->info->jittivity & MVM_JIT_INFO_INVOKISH);
+    }
+}
+
+/* Follows sets and guards back to the value they copy, so we see through
+ * them when comparing operands. */
+static MVMSpeshOperand canonical(MVMThreadContext *tc, MVMSpeshGraph *g, MVMSpeshOperand o) {
+    while (1) {
+        MVMSpeshIns *writer = MVM_spesh_get_facts(tc, g, o)->writer;
+        if (!writer)
+            return o;
+        switch (writer->info->opcode) {
+            case MVM_OP_set:
+            case MVM_OP_sp_guard:
+            case MVM_OP_sp_guardconc:
+            case MVM_OP_sp_guardtype:
+            case MVM_OP_sp_guardobj:
+            case MVM_OP_sp_guardnotobj:
+            case MVM_OP_sp_guardjustconc:
+            case MVM_OP_sp_guardjusttype:
+                o = writer->operands[1];
+                break;
+            default:
+                return o;
+        }
+    }
+}
+
+/* Checks if an operand is part of the value being computed. Written
+ * registers are not, and nor is the deopt index of a guard. */
+static MVMuint32 is_key_operand(MVMSpeshIns *ins, MVMuint32 kind, MVMuint16 i) {
+    if ((ins->info->operands[i] & MVM_operand_rw_mask) == MVM_operand_write_reg)
+        return 0;
+    if (kind == GVN_GUARD && i == ins->info->num_operands - 1)
+        return 0;
+    return 1;
+}
+
+/* Hashes an instruction. */
+static MVMuint32 hash_ins(MVMThreadContext *tc, MVMSpeshGraph *g, MVMSpeshIns *ins,
+                          MVMuint32 kind) {
+    MVMuint32 hash = ins->info->opcode;
+    MVMuint16 i;
+    for (i = 0; i < ins->info->num_operands; i++) {
+        MVMuint8 flags = ins->info->operands[i];
+        if (!is_key_operand(ins, kind, i))
+            continue;
+        if ((flags & MVM_operand_rw_mask) == MVM_operand_read_reg) {
+            MVMSpeshOperand c = canonical(tc, g, ins->operands[i]);
+            hash = hash * 31 + c.reg.orig;
+            hash = hash * 31 + c.reg.i;
+        }
+        else if ((flags & MVM_operand_rw_mask) == MVM_operand_literal) {
+            switch (flags & MVM_operand_type_mask) {
+                case MVM_operand_int8:
+                case MVM_operand_uint8:
+                    hash = hash * 31 + (MVMuint8)ins->operands[i].lit_i8;
+                    break;
+                case MVM_operand_int16:
+                case MVM_operand_uint16:
+                case MVM_operand_spesh_slot:
+                case MVM_operand_coderef:
+                case MVM_operand_callsite:
+                    hash = hash * 31 + (MVMuint16)ins->operands[i].lit_i16;
+                    break;
+                case MVM_operand_int32:
+                case MVM_operand_uint32:
+                case MVM_operand_str:
+                    hash = hash * 31 + (MVMuint32)ins->operands[i].lit_i32;
+                    break;
+                default:
+                    hash = hash * 31 + (MVMuint32)ins->operands[i].lit_i64;
+                    break;
+            }
+        }
+    }
+    return hash;
+}
+
+/* Checks if two instructions compute the same thing. */
+static MVMuint32 same_computation(MVMThreadContext *tc, MVMSpeshGraph *g, MVMSpeshIns *a,
+                                  MVMSpeshIns *b, MVMuint32 kind) {
+    MVMuint16 i;
+    if (a->info != b->info)
+        return 0;
+    for (i = 0; i < a->info->num_operands; i++) {
+        MVMuint8 flags = a->info->operands[i];
+        if (!is_key_operand(a, kind, i))
+            continue;
+        if ((flags & MVM_operand_rw_mask) == MVM_operand_read_reg) {
+            MVMSpeshOperand ca = canonical(tc, g, a->operands[i]);
+            MVMSpeshOperand cb = canonical(tc, g, b->operands[i]);
+            if (ca.reg.orig != cb.reg.orig || ca.reg.i != cb.reg.i)
+                return 0;
+        }
+        else if ((flags & MVM_operand_rw_mask) == MVM_operand_literal) {
+            MVMSpeshOperand la = a->operands[i];
+            MVMSpeshOperand lb = b->operands[i];
+            switch (flags & MVM_operand_type_mask) {
+                case MVM_operand_int8:
+                case MVM_operand_uint8:
+                    if (la.lit_i8 != lb.lit_i8)
+                        return 0;
+                    break;
+                case MVM_operand_int16:
+                case MVM_operand_uint16:
+                case MVM_operand_spesh_slot:
+                case MVM_operand_coderef:
+                case MVM_operand_callsite:
+                    if (la.lit_i16 != lb.lit_i16)
+                        return 0;
+                    break;
+                case MVM_operand_int32:
+                case MVM_operand_uint32:
+                    if (la.lit_i32 != lb.lit_i32)
+                        return 0;
+                    break;
+                case MVM_operand_str:
+                    if (la.lit_str_idx != lb.lit_str_idx)
+                        return 0;
+                    break;
+                case MVM_operand_num32:
+                    if (memcmp(&la.lit_n32, &lb.lit_n32, sizeof(MVMnum32)) != 0)
+                        return 0;
+                    break;
+                case MVM_operand_num64:
+                    if (memcmp(&la.lit_n64, &lb.lit_n64, sizeof(MVMnum64)) != 0)
+                        return 0;
+                    break;
+                default:
+                    if (la.lit_i64 != lb.lit_i64)
+                        return 0;
+                    break;
+            }
+        }
+        else {
+            /* Lexical access and the like; we don't reason about those. */
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* Looks for an available instruction computing the same thing. */
+static GVNEntry * find_available(MVMThreadContext *tc, MVMSpeshGraph *g, GVNState *gs,
+                                    MVMSpeshIns *ins, MVMuint32 kind, MVMuint32 hash) {
+    GVNEntry *entry = gs->buckets[hash % GVN_BUCKETS];
+    while (entry) {
+        if (entry->hash == hash && (kind != GVN_MEMORY || entry->epoch == gs->epoch)
+                && same_computation(tc, g, entry->ins, ins, kind))
+            return entry;
+        entry = entry->next;
+    }
+    return NULL;
+}
+
+/* Makes an instruction available to those it dominates. */
+static void add_available(MVMThreadContext *tc, MVMSpeshGraph *g, GVNState *gs,
+                          MVMSpeshBB *bb, MVMSpeshIns *ins, MVMuint32 hash) {
+    GVNEntry *entry = MVM_spesh_alloc(tc, g, sizeof(GVNEntry));
+    entry->ins = ins;
+    entry->bb = bb;
+    entry->split = 0;
+    entry->hash = hash;
+    entry->epoch = gs->epoch;
+    entry->next = gs->buckets[hash % GVN_BUCKETS];
+    gs->buckets[hash % GVN_BUCKETS] = entry;
+    MVM_VECTOR_PUSH(gs->added, entry);
+}
+
+/* Makes the available instruction write its result to a new register that
+ * is written nowhere else, followed by a set into the original one. */
+static void split_result(MVMThreadContext *tc, MVMSpeshGraph *g, GVNEntry *entry) {
+    MVMSpeshIns *ins = entry->ins;
+    MVMSpeshOperand orig_result = ins->operands[0];
+    MVMSpeshOperand new_result;
+    MVMSpeshIns *set_ins = MVM_spesh_alloc(tc, g, sizeof(MVMSpeshIns));
+    MVMSpeshFacts *new_facts;
+
+    new_result.reg.orig = MVM_spesh_manipulate_get_unique_reg(tc, g,
+        (ins->info->operands[0] & MVM_operand_type_mask) >> 3);
+    new_result.reg.i = 0;
+    MVM_spesh_copy_facts(tc, g, new_result, orig_result);
+    new_facts = MVM_spesh_get_facts(tc, g, new_result);
+    new_facts->writer = ins;
+    new_facts->dead_writer = 0;
+    ins->operands[0] = new_result;
+
+    set_ins->info = MVM_op_get_op(MVM_OP_set);
+    set_ins->operands = MVM_spesh_alloc(tc, g, 2 * sizeof(MVMSpeshOperand));
+    set_ins->operands[0] = orig_result;
+    set_ins->operands[1] = new_result;
+    MVM_spesh_manipulate_insert_ins(tc, entry->bb, ins, set_ins);
+    MVM_spesh_get_facts(tc, g, orig_result)->writer = set_ins;
+    MVM_spesh_usages_add_by_reg(tc, g, new_result, set_ins);
+
+    entry->split = 1;
+}
+
+/* Replaces an instruction with the result of an earlier one that computes
+ * the same thing. */
+static void eliminate(MVMThreadContext *tc, MVMSpeshGraph *g, GVNState *gs, MVMSpeshBB *bb,
+                      MVMSpeshIns *ins, GVNEntry *entry) {
+    MVMSpeshIns *available = entry->ins;
+    MVMSpeshAnn *ann, *prev_ann;
+    MVMuint16 i;
+    if (MVM_spesh_debug_enabled(tc))
+        MVM_spesh_debug_printf(tc, "GVN: eliminated %s in BB %d\n", ins->info->name, bb->idx);
+    gs->eliminated++;
+
+    /* A guard that doesn't write a register can just go away. */
+    if (ins->info->num_operands == 0 ||
+            (ins->info->operands[0] & MVM_operand_rw_mask) != MVM_operand_write_reg) {
+        MVM_spesh_usages_delete_by_reg(tc, g, ins->operands[0], ins);
+        MVM_spesh_manipulate_delete_ins(tc, g, bb, ins);
+        return;
+    }
+
+    /* Otherwise, it becomes a set from the available result, dropping any
+     * deopt points it had as a guard. */
+    if (!entry->split)
+        split_result(tc, g, entry);
+    for (i = 1; i < ins->info->num_operands; i++)
+        if ((ins->info->operands[i] & MVM_operand_rw_mask) == MVM_operand_read_reg)
+            MVM_spesh_usages_delete_by_reg(tc, g, ins->operands[i], ins);
+    ins->info = MVM_op_get_op(MVM_OP_set);
+    ins->operands[1] = available->operands[0];
+    MVM_spesh_usages_add_by_reg(tc, g, ins->operands[1], ins);
+    prev_ann = NULL;
+    ann = ins->annotations;
+    while (ann) {
+        if (ann->type == MVM_SPESH_ANN_DEOPT_ONE_INS || ann->type == MVM_SPESH_ANN_DEOPT_SYNTH) {
+            if (prev_ann)
+                prev_ann->next = ann->next;
+            else
+                ins->annotations = ann->next;
+        }
+        else {
+            prev_ann = ann;
+        }
+        ann = ann->next;
+    }
+    MVM_spesh_graph_add_comment(tc, g, ins, "redundant %s eliminated by GVN",
+        available->info->name);
+}
+
+/* Visits a basic block, then its children in the dominator tree. */
+static void gvn_visit_bb(MVMThreadContext *tc, MVMSpeshGraph *g, GVNState *gs, MVMSpeshBB *bb) {
+    size_t added_before = MVM_VECTOR_ELEMS(gs->added);
+    MVMuint32 end_epoch;
+    MVMSpeshIns *ins = bb->first_ins;
+    MVMuint16 i;
+
+    while (ins) {
+        MVMSpeshIns *next = ins->next;
+        MVMuint32 kind = gvn_kind(ins);
+        if (kind != GVN_NONE) {
+            MVMuint32 hash = hash_ins(tc, g, ins, kind);
+            GVNEntry *available = find_available(tc, g, gs, ins, kind, hash);
+            if (available)
+                eliminate(tc, g, gs, bb, ins, available);
+            else
+                add_available(tc, g, gs, bb, ins, hash);
+        }
+        else if (may_write(ins)) {
+            gs->epoch = ++gs->last_epoch;
+        }
+        ins = next;
+    }
+
+    /* Memory reads stay available in children only reachable from here. */
+    end_epoch = gs->epoch;
+    for (i = 0; i < bb->num_children; i++) {
+        MVMSpeshBB *child = bb->children[i];
+        gs->epoch = child->num_pred == 1 && child->pred[0] == bb
+            ? end_epoch
+            : ++gs->last_epoch;
+        gvn_visit_bb(tc, g, gs, child);
+    }
+
+    /* Anything we added is no longer available once we leave this part of
+     * the dominator tree. Since buckets are stacks, we pop in reverse. */
+    while (MVM_VECTOR_ELEMS(gs->added) > added_before) {
+        GVNEntry *entry = MVM_VECTOR_POP(gs->added);
+        gs->buckets[entry->hash % GVN_BUCKETS] = entry->next;
+    }
+}
+
+/* Performs global value numbering on the graph. Must be run with the
+ * dominator tree up to date. */
+void MVM_spesh_gvn(MVMThreadContext *tc, MVMSpeshGraph *g) {
+    GVNState gs;
+    memset(gs.buckets, 0, sizeof(gs.buckets));
+    MVM_VECTOR_INIT(gs.added, 64);
+    gs.epoch = gs.last_epoch = 0;
+    gs.eliminated = 0;
+    gvn_visit_bb(tc, g, &gs, g->entry);
+    if (MVM_spesh_debug_enabled(tc) && gs.eliminated)
+        MVM_spesh_debug_printf(tc, "GVN: eliminated %u instructions\n", gs.eliminated);
+    MVM_VECTOR_DESTROY(gs.added);
+}
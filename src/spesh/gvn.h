@@ -0,0 +1 @@
+void MVM_spesh_gvn(MVMThreadContext *tc, MVMSpeshGraph *g);
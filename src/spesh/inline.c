@@ -227,6 +227,45 @@ int MVM_spesh_inline_get_max_size(MVMThreadContext *tc, MVMStaticFrame *sf) {
     return sf->body.cu->body.hll_config->max_inline_size;
 }
 
+/* Get the maximum inline size for a call site, weighting the language's limit
+ * by how often the site was hit relative to entries into the caller. Hot
+ * sites, such as those in loops, are allowed larger inlines, since the call
+ * overhead saved is multiplied; rarely reached ones get a smaller limit. If
+ * we have no statistics, the unweighted limit applies. */
+MVMuint32 MVM_spesh_inline_get_site_max_size(MVMThreadContext *tc, MVMStaticFrame *sf,
+                                             MVMuint32 site_hits, MVMuint32 caller_hits) {
+    MVMuint32 max_size = MVM_spesh_inline_get_max_size(tc, sf);
+    if (caller_hits == 0)
+        return max_size;
+    if ((MVMuint64)site_hits >= (MVMuint64)caller_hits * MVM_SPESH_INLINE_VERY_HOT_SITE_RATIO)
+        return 4 * max_size;
+    if ((MVMuint64)site_hits >= (MVMuint64)caller_hits * MVM_SPESH_INLINE_HOT_SITE_RATIO)
+        return 2 * max_size;
+    if ((MVMuint64)site_hits * MVM_SPESH_INLINE_COLD_SITE_RATIO < caller_hits)
+        return max_size / 2;
+    return max_size;
+}
+
+/* Get the total bytecode size that may be inlined into the specified graph,
+ * to limit code bloat from many inlines that are each within the limit. */
+MVMuint32 MVM_spesh_inline_get_budget(MVMThreadContext *tc, MVMSpeshGraph *inliner) {
+    MVMuint32 budget = inliner->sf->body.bytecode_size * MVM_SPESH_INLINE_BUDGET_FACTOR;
+    return budget < MVM_SPESH_INLINE_BUDGET_MIN ? MVM_SPESH_INLINE_BUDGET_MIN : budget;
+}
+
+/* Checks if inlining code of the specified size would exceed the inlining
+ * budget of the inliner. Sites that were granted a raised size limit may use
+ * some extra headroom, so that hot sites late in the caller are not starved
+ * by earlier inlines. */
+static MVMint32 exceeds_budget(MVMThreadContext *tc, MVMSpeshGraph *inliner,
+                               MVMStaticFrame *target_sf, MVMuint32 size,
+                               MVMuint32 max_size) {
+    MVMuint32 budget = MVM_spesh_inline_get_budget(tc, inliner);
+    if (max_size > (MVMuint32)MVM_spesh_inline_get_max_size(tc, target_sf))
+        budget += budget / 2;
+    return inliner->inlined_bytecode_size + size > budget;
+}
+
 /* Sees if it will be possible to inline the target code ref, given we could
  * already identify a spesh candidate. Returns NULL if no inlining is possible
  * or a graph ready to be merged if it will be possible. */
@@ -234,23 +273,47 @@ MVMSpeshGraph * MVM_spesh_inline_try_get_graph(MVMThreadContext *tc, MVMSpeshGra
                                                MVMStaticFrame *target_sf,
                                                MVMSpeshCandidate *cand,
                                                MVMSpeshIns *invoke_ins,
+                                               MVMuint32 max_size,
                                                char **no_inline_reason,
                                                MVMuint32 *effective_size,
                                                MVMOpInfo const **no_inline_info) {
     MVMSpeshGraph *ig;
     MVMSpeshIns **deopt_usage_ins = NULL;
 
-    /* Check bytecode size is within the inline limit. */
+    /* Check bytecode size is within the inline limit for this site. */
     *effective_size = get_effective_size(tc, cand);
-    if (*effective_size > MVM_spesh_inline_get_max_size(tc, target_sf)) {
+    if (*effective_size > max_size) {
         *no_inline_reason = "bytecode is too large to inline";
         return NULL;
     }
 
+    /* Check the inliner has enough budget left; this counts the full size,
+     * since the inlines of the candidate come along with it. */
+    if (exceeds_budget(tc, inliner, target_sf, cand->bytecode_size, max_size)) {
+        *no_inline_reason = "inlining budget of the caller is exhausted";
+        return NULL;
+    }
+
     /* Check the target is suitable for inlining. */
     if (!is_static_frame_inlineable(tc, inliner, target_sf, no_inline_reason))
         return NULL;
 
+    /* Don't inline a specialization that caused a deopt storm, or that has
+     * a guard at a place where one caused a deopt storm in another. */
+    if (cand->discarded) {
+        *no_inline_reason = "target specialization was discarded due to a deopt storm";
+        return NULL;
+    }
+    if (target_sf->body.spesh->body.deopt_storm_offsets) {
+        MVMuint32 i;
+        for (i = 0; i < cand->num_deopts; i++) {
+            if (MVM_spesh_candidate_deopt_storm_at(tc, target_sf, cand->deopts[2 * i])) {
+                *no_inline_reason = "target specialization speculates where a deopt storm happened";
+                return NULL;
+            }
+        }
+    }
+
     /* Build graph from the already-specialized bytecode and check if we can
      * inline the graph. */
     ig = MVM_spesh_graph_create_from_cand(tc, target_sf, cand, 0, &deopt_usage_ins);
@@ -284,7 +347,8 @@ MVMSpeshGraph * MVM_spesh_inline_try_get_graph(MVMThreadContext *tc, MVMSpeshGra
 /* Tries to get a spesh graph for a particular unspecialized candidate. */
 MVMSpeshGraph * MVM_spesh_inline_try_get_graph_from_unspecialized(MVMThreadContext *tc,
         MVMSpeshGraph *inliner, MVMStaticFrame *target_sf, MVMSpeshIns *invoke_ins,
-        MVMSpeshCallInfo *call_info, MVMSpeshStatsType *type_tuple, char **no_inline_reason, MVMOpInfo const **no_inline_info) {
+        MVMSpeshCallInfo *call_info, MVMSpeshStatsType *type_tuple, MVMuint32 max_size,
+        char **no_inline_reason, MVMOpInfo const **no_inline_info) {
     MVMSpeshGraph *ig;
 
     /* Cannot inline with flattening args. */
@@ -293,6 +357,13 @@ MVMSpeshGraph * MVM_spesh_inline_try_get_graph_from_unspecialized(MVMThreadConte
         return NULL;
     }
 
+    /* Check the inliner has enough budget left before we go to the effort
+     * of building a graph. */
+    if (exceeds_budget(tc, inliner, target_sf, target_sf->body.bytecode_size, max_size)) {
+        *no_inline_reason = "inlining budget of the caller is exhausted";
+        return NULL;
+    }
+
     /* Check the target is suitable for inlining. */
     if (!is_static_frame_inlineable(tc, inliner, target_sf, no_inline_reason))
         return NULL;
@@ -720,6 +791,15 @@ static MVMSpeshBB * merge_graph(MVMThreadContext *tc, MVMSpeshGraph *inliner,
         else {
             mi_new.attr_regs = NULL;
         }
+        if (mi_orig.key_sslots) {
+            mi_new.key_sslots = MVM_malloc(mi_new.num_attr_regs * sizeof(MVMuint16));
+            for (j = 0; j < mi_new.num_attr_regs; j++)
+                mi_new.key_sslots[j] = mi_orig.key_sslots[j] + inliner->num_spesh_slots;
+        }
+        else {
+            mi_new.key_sslots = NULL;
+        }
+        mi_new.unboxed_kind = mi_orig.unboxed_kind;
         MVM_VECTOR_PUSH(inliner->deopt_pea.materialize_info, mi_new);
     }
     for (i = 0; i < MVM_VECTOR_ELEMS(inlinee->deopt_pea.deopt_point); i++) {
@@ -1355,6 +1435,13 @@ void MVM_spesh_inline(MVMThreadContext *tc, MVMSpeshGraph *inliner,
         invoke_bb, invoke_ins, code_ref_reg, &inline_boundary_handler, bytecode_size,
         call_info->cs);
 
+    /* Count the inlined code against the inliner's budget. If we don't know
+     * the specialized size, go by the original bytecode and what was inlined
+     * into it. */
+    inliner->inlined_bytecode_size += bytecode_size
+        ? bytecode_size
+        : inlinee_sf->body.bytecode_size + inlinee->inlined_bytecode_size;
+
     /* If we're profiling, note it's an inline. */
     first_ins = find_first_instruction(tc, inlinee);
     if (first_ins->info->opcode == MVM_OP_prof_enterspesh) {
@@ -7,6 +7,20 @@
 #define MVM_SPESH_INLINE_MAX_LOCALS     512
 #define MVM_SPESH_INLINE_MAX_INLINES    128
 
+/* Call site weighting for the inline size limit. A site that is called at
+ * least HOT_SITE_RATIO times per entry into the caller gets twice the size
+ * limit, and VERY_HOT_SITE_RATIO times gets four times it. A site reached on
+ * less than one in COLD_SITE_RATIO entries only gets half of it. */
+#define MVM_SPESH_INLINE_HOT_SITE_RATIO         4
+#define MVM_SPESH_INLINE_VERY_HOT_SITE_RATIO    32
+#define MVM_SPESH_INLINE_COLD_SITE_RATIO        8
+
+/* The total bytecode size we are willing to inline into a single caller is
+ * its own size times BUDGET_FACTOR, but at least BUDGET_MIN. Sites with a
+ * raised size limit may go beyond that by half again. */
+#define MVM_SPESH_INLINE_BUDGET_MIN     2048
+#define MVM_SPESH_INLINE_BUDGET_FACTOR  4
+
 /* Inline table entry. The data is primarily used in deopt. */
 struct MVMSpeshInline {
     /* Start and end position in the bytecode where we're inside of this
@@ -57,12 +71,17 @@ struct MVMSpeshInline {
 
 MVMSpeshGraph * MVM_spesh_inline_try_get_graph(MVMThreadContext *tc,
     MVMSpeshGraph *inliner, MVMStaticFrame *target_sf, MVMSpeshCandidate *cand,
-    MVMSpeshIns *invoke_ins, char **no_inline_reason, MVMuint32 *effective_size, MVMOpInfo const **no_inline_info);
+    MVMSpeshIns *invoke_ins, MVMuint32 max_size, char **no_inline_reason,
+    MVMuint32 *effective_size, MVMOpInfo const **no_inline_info);
 MVMSpeshGraph * MVM_spesh_inline_try_get_graph_from_unspecialized(MVMThreadContext *tc,
     MVMSpeshGraph *inliner, MVMStaticFrame *target_sf, MVMSpeshIns *invoke_ins,
-    MVMSpeshCallInfo *call_info, MVMSpeshStatsType *type_tuple, char **no_inline_reason, MVMOpInfo const **no_inline_info);
+    MVMSpeshCallInfo *call_info, MVMSpeshStatsType *type_tuple, MVMuint32 max_size,
+    char **no_inline_reason, MVMOpInfo const **no_inline_info);
 void MVM_spesh_inline(MVMThreadContext *tc, MVMSpeshGraph *inliner,
     MVMSpeshCallInfo *call_info, MVMSpeshBB *invoke_bb,
     MVMSpeshIns *invoke, MVMSpeshGraph *inlinee, MVMStaticFrame *inlinee_sf,
     MVMSpeshOperand code_ref_reg, MVMuint32 proxy_deopt_idx, MVMuint16 bytecode_size);
 int MVM_spesh_inline_get_max_size(MVMThreadContext *tc, MVMStaticFrame *sf);
+MVMuint32 MVM_spesh_inline_get_site_max_size(MVMThreadContext *tc, MVMStaticFrame *sf,
+    MVMuint32 site_hits, MVMuint32 caller_hits);
+MVMuint32 MVM_spesh_inline_get_budget(MVMThreadContext *tc, MVMSpeshGraph *inliner);
@@ -0,0 +1,723 @@
+#include "moar.h"
+
+/* Loop-invariant code motion. We find natural loops using the dominator tree
+ * and, for those with a simple preheader (a single block from outside of the
+ * loop that falls through into its header), move instructions that compute
+ * the same thing on every iteration into the preheader. The original
+ * instruction is turned into a `set` from the hoisted result, which the set
+ * elimination in the post-inline pass will often get rid of.
+ *
+ * We hoist three kinds of instruction:
+ *
+ * 1. Pure instructions that cannot throw (simple arithmetic, comparisons,
+ *    and concreteness checks).
+ * 2. Reads of attributes from objects of a known concrete type, provided
+ *    that nothing in the loop may write to memory or invoke code.
+ * 3. Type and concreteness guards. These are hoisted only from blocks that
+ *    run on every iteration, and only in loops that have an OSR point, since
+ *    we need a place to deoptimize to: if the hoisted guard fails, we resume
+ *    in the interpreter at the head of the loop, before any of the loop body
+ *    has run.
+ */
+
+/* Kinds of instruction we know how to hoist. */
+#define HOIST_NONE  0
+#define HOIST_PURE  1
+#define HOIST_READ  2
+#define HOIST_GUARD 3
+
+/* A natural loop. */
+typedef struct {
+    /* The loop header, and the blocks that branch back to it. */
+    MVMSpeshBB *header;
+    MVM_VECTOR_DECL(MVMSpeshBB *, latches);
+
+    /* The blocks making up the loop, in reverse post-order. */
+    MVM_VECTOR_DECL(MVMSpeshBB *, blocks);
+} LICMLoop;
+
+/* State for the pass over the whole graph. */
+typedef struct {
+    /* Immediate dominator of each basic block, and whether a block is in
+     * the loop currently being processed, both indexed by basic block
+     * index. */
+    MVMSpeshBB **idom;
+    MVMuint8 *in_loop;
+    MVMint32 num_bbs;
+
+    /* The basic block each SSA version is written in, indexed by register
+     * then version; NULL if it has no writer. Registers added by hoisting
+     * are tacked on the end as we go. */
+    MVMSpeshBB ***def_bb;
+    MVMuint32 num_def_regs;
+
+    /* The loops we found. */
+    MVM_VECTOR_DECL(LICMLoop *, loops);
+} LICMState;
+
+/* Work out the kind of hoisting an instruction is eligible for. */
+static MVMuint32 hoist_kind(MVMSpeshIns *ins) {
+    switch (ins->info->opcode) {
+        case MVM_OP_add_i:
+        case MVM_OP_sub_i:
+        case MVM_OP_mul_i:
+        case MVM_OP_neg_i:
+        case MVM_OP_abs_i:
+        case MVM_OP_band_i:
+        case MVM_OP_bor_i:
+        case MVM_OP_bxor_i:
+        case MVM_OP_bnot_i:
+        case MVM_OP_eq_i:
+        case MVM_OP_ne_i:
+        case MVM_OP_lt_i:
+        case MVM_OP_le_i:
+        case MVM_OP_gt_i:
+        case MVM_OP_ge_i:
+        case MVM_OP_add_n:
+        case MVM_OP_sub_n:
+        case MVM_OP_mul_n:
+        case MVM_OP_div_n:
+        case MVM_OP_neg_n:
+        case MVM_OP_abs_n:
+        case MVM_OP_eq_n:
+        case MVM_OP_ne_n:
+        case MVM_OP_lt_n:
+        case MVM_OP_le_n:
+        case MVM_OP_gt_n:
+        case MVM_OP_ge_n:
+        case MVM_OP_coerce_in:
+        case MVM_OP_isconcrete:
+            return HOIST_PURE;
+        case MVM_OP_sp_p6oget_o:
+        case MVM_OP_sp_p6oget_i:
+        case MVM_OP_sp_p6oget_n:
+        case MVM_OP_sp_p6oget_s:
+        case MVM_OP_sp_p6oget_bi:
+        case MVM_OP_sp_p6oget_i32:
+        case MVM_OP_sp_get_o:
+        case MVM_OP_sp_get_i64:
+        case MVM_OP_sp_get_i32:
+        case MVM_OP_sp_get_i16:
+        case MVM_OP_sp_get_i8:
+        case MVM_OP_sp_get_n:
+        case MVM_OP_sp_get_s:
+            return HOIST_READ;
+        case MVM_OP_sp_guard:
+        case MVM_OP_sp_guardconc:
+        case MVM_OP_sp_guardtype:
+        case MVM_OP_sp_guardobj:
+        case MVM_OP_sp_guardnotobj:
+        case MVM_OP_sp_guardjustconc:
+        case MVM_OP_sp_guardjusttype:
+            return HOIST_GUARD;
+        default:
+            return HOIST_NONE;
+    }
+}
+
+/* Checks if the instruction is one that may write to memory or run code,
+ * which would prevent us from hoisting reads. */
+static MVMuint32 may_write(MVMSpeshIns *ins) {
+    switch (ins->info->opcode) {
+        case MVM_SSA_PHI:
+        case MVM_OP_set:
+        case MVM_OP_goto:
+        case MVM_OP_if_i:
+        case MVM_OP_unless_i:
+        case MVM_OP_if_n:
+        case MVM_OP_unless_n:
+            return 0;
+        default:
+            if (hoist_kind(ins) != HOIST_NONE)
+                return 0;
+            return !ins->info->pure || (ins->info->jittivity & MVM_JIT_INFO_INVOKISH);
+    }
+}
+
+/* Checks if dominator a dominates b. */
+static MVMuint32 dominates(LICMState *ls, MVMSpeshBB *a, MVMSpeshBB *b) {
+    while (b) {
+        if (a == b)
+            return 1;
+        b = ls->idom[b->idx];
+    }
+    return 0;
+}
+
+/* Record the immediate dominators by walking the dominator tree. */
+static void record_idoms(LICMState *ls, MVMSpeshBB *bb) {
+    MVMuint16 i;
+    for (i = 0; i < bb->num_children; i++) {
+        ls->idom[bb->children[i]->idx] = bb;
+        record_idoms(ls, bb->children[i]);
+    }
+}
+
+/* Record which block each SSA version is written in. */
+static void record_def_bbs(MVMThreadContext *tc, MVMSpeshGraph *g, LICMState *ls) {
+    MVMSpeshBB *bb = g->entry;
+    MVMuint32 i;
+    ls->num_def_regs = g->num_locals;
+    ls->def_bb = MVM_calloc(ls->num_def_regs, sizeof(MVMSpeshBB **));
+    for (i = 0; i < ls->num_def_regs; i++)
+        ls->def_bb[i] = MVM_calloc(g->fact_counts[i] ? g->fact_counts[i] : 1,
+            sizeof(MVMSpeshBB *));
+    while (bb) {
+        MVMSpeshIns *ins = bb->first_ins;
+        while (ins) {
+            MVMuint32 is_phi = ins->info->opcode == MVM_SSA_PHI;
+            MVMuint16 j;
+            for (j = 0; j < ins->info->num_operands; j++) {
+                if ((is_phi && j == 0) || (!is_phi &&
+                        (ins->info->operands[j] & MVM_operand_rw_mask) == MVM_operand_write_reg)) {
+                    MVMSpeshOperand o = ins->operands[j];
+                    if (o.reg.orig < ls->num_def_regs && o.reg.i < g->fact_counts[o.reg.orig])
+                        ls->def_bb[o.reg.orig][o.reg.i] = bb;
+                }
+            }
+            ins = ins->next;
+        }
+        bb = bb->linear_next;
+    }
+}
+static MVMSpeshBB * get_def_bb(LICMState *ls, MVMSpeshOperand o) {
+    return o.reg.orig < ls->num_def_regs ? ls->def_bb[o.reg.orig][o.reg.i] : NULL;
+}
+static void add_def_bb(LICMState *ls, MVMSpeshOperand o, MVMSpeshBB *bb) {
+    MVMuint32 i;
+    if (o.reg.orig >= ls->num_def_regs) {
+        ls->def_bb = MVM_realloc(ls->def_bb, (o.reg.orig + 1) * sizeof(MVMSpeshBB **));
+        for (i = ls->num_def_regs; i <= o.reg.orig; i++)
+            ls->def_bb[i] = MVM_calloc(1, sizeof(MVMSpeshBB *));
+        ls->num_def_regs = o.reg.orig + 1;
+    }
+    ls->def_bb[o.reg.orig][o.reg.i] = bb;
+}
+
+/* Finds the natural loops in the graph. Loops sharing a header are merged
+ * into a single loop. */
+static void find_loops(MVMThreadContext *tc, MVMSpeshGraph *g, LICMState *ls) {
+    MVMSpeshBB *bb = g->entry;
+    while (bb) {
+        MVMuint16 i;
+        for (i = 0; i < bb->num_succ; i++) {
+            MVMSpeshBB *header = bb->succ[i];
+            if (header != g->entry && dominates(ls, header, bb)) {
+                /* It's a back edge. Find or add the loop. */
+                LICMLoop *loop = NULL;
+                MVMuint32 j;
+                for (j = 0; j < MVM_VECTOR_ELEMS(ls->loops); j++) {
+                    if (ls->loops[j]->header == header) {
+                        loop = ls->loops[j];
+                        break;
+                    }
+                }
+                if (!loop) {
+                    loop = MVM_calloc(1, sizeof(LICMLoop));
+                    loop->header = header;
+                    MVM_VECTOR_INIT(loop->latches, 1);
+                    MVM_VECTOR_INIT(loop->blocks, 8);
+                    MVM_VECTOR_PUSH(ls->loops, loop);
+                }
+                MVM_VECTOR_PUSH(loop->latches, bb);
+            }
+        }
+        bb = bb->linear_next;
+    }
+}
+
+/* Works out the body of the loop, marking its blocks in in_loop. We walk
+ * backwards from the latches until we reach the header. The edges that the
+ * entry block has to OSR points are not really part of the control flow
+ * within the loop, so are not followed. */
+static void find_loop_body(MVMThreadContext *tc, MVMSpeshGraph *g, LICMState *ls,
+                           LICMLoop *loop) {
+    MVM_VECTOR_DECL(MVMSpeshBB *, worklist);
+    MVMuint32 i, j;
+    memset(ls->in_loop, 0, ls->num_bbs);
+    MVM_VECTOR_INIT(worklist, MVM_VECTOR_ELEMS(loop->latches));
+    ls->in_loop[loop->header->idx] = 1;
+    MVM_VECTOR_PUSH(loop->blocks, loop->header);
+    for (i = 0; i < MVM_VECTOR_ELEMS(loop->latches); i++)
+        MVM_VECTOR_PUSH(worklist, loop->latches[i]);
+    while (MVM_VECTOR_ELEMS(worklist)) {
+        MVMSpeshBB *bb = MVM_VECTOR_POP(worklist);
+        if (ls->in_loop[bb->idx] || bb == g->entry)
+            continue;
+        ls->in_loop[bb->idx] = 1;
+        MVM_VECTOR_PUSH(loop->blocks, bb);
+        for (i = 0; i < bb->num_pred; i++)
+            if (!ls->in_loop[bb->pred[i]->idx])
+                MVM_VECTOR_PUSH(worklist, bb->pred[i]);
+    }
+    MVM_VECTOR_DESTROY(worklist);
+
+    /* Sort into reverse post-order, so definitions are visited before their
+     * uses. Loops are small, so insertion sort does fine. */
+    for (i = 1; i < MVM_VECTOR_ELEMS(loop->blocks); i++) {
+        MVMSpeshBB *cur = loop->blocks[i];
+        j = i;
+        while (j > 0 && loop->blocks[j - 1]->rpo_idx > cur->rpo_idx) {
+            loop->blocks[j] = loop->blocks[j - 1];
+            j--;
+        }
+        loop->blocks[j] = cur;
+    }
+}
+
+/* Finds the preheader of a loop: its only predecessor from outside of the
+ * loop, not counting an OSR edge from the entry block. It must fall through
+ * to the loop header, so we have somewhere to put the hoisted code. */
+static MVMSpeshBB * find_preheader(MVMThreadContext *tc, MVMSpeshGraph *g,
+                                   LICMState *ls, LICMLoop *loop, MVMuint32 *has_osr_edge) {
+    MVMSpeshBB *header = loop->header;
+    MVMSpeshBB *preheader = NULL;
+    MVMSpeshIns *last;
+    MVMuint16 i;
+    *has_osr_edge = 0;
+    if (header->inlined || header->jumplist)
+        return NULL;
+    for (i = 0; i < header->num_pred; i++) {
+        MVMSpeshBB *pred = header->pred[i];
+        if (pred == g->entry)
+            *has_osr_edge = 1;
+        else if (!ls->in_loop[pred->idx]) {
+            if (preheader)
+                return NULL;
+            preheader = pred;
+        }
+    }
+    if (!preheader || preheader->inlined || preheader->jumplist ||
+            preheader->num_succ != 1 || preheader->linear_next != header)
+        return NULL;
+
+    /* Must either fall through or end in a goto; anything else that can
+     * branch rules it out. */
+    last = preheader->last_ins;
+    if (last && last->info->opcode != MVM_OP_goto) {
+        for (i = 0; i < last->info->num_operands; i++)
+            if ((last->info->operands[i] & MVM_operand_type_mask) == MVM_operand_ins)
+                return NULL;
+        if (last->info->jittivity & MVM_JIT_INFO_THROWISH)
+            return NULL;
+    }
+
+    /* Code placed in the preheader must not end up inside of an inline. */
+    if (header->first_ins) {
+        MVMSpeshAnn *ann = header->first_ins->annotations;
+        while (ann) {
+            if (ann->type == MVM_SPESH_ANN_INLINE_START || ann->type == MVM_SPESH_ANN_INLINE_END)
+                return NULL;
+            ann = ann->next;
+        }
+    }
+
+    return preheader;
+}
+
+/* Finds the OSR annotation in the loop header, if any. */
+static MVMSpeshAnn * find_osr_ann(MVMSpeshBB *header, MVMSpeshIns **ins_out) {
+    MVMSpeshIns *ins = header->first_ins;
+    while (ins) {
+        MVMSpeshAnn *ann = ins->annotations;
+        while (ann) {
+            if (ann->type == MVM_SPESH_ANN_DEOPT_OSR) {
+                *ins_out = ins;
+                return ann;
+            }
+            ann = ann->next;
+        }
+        ins = ins->next;
+    }
+    return NULL;
+}
+
+/* Finds the first deopt point in the loop header, so that the values it
+ * needs are kept alive for the deopt point of a hoisted guard too. Returns
+ * -1 if there is none. */
+static MVMint32 find_header_deopt_idx(MVMSpeshBB *header) {
+    MVMSpeshIns *ins = header->first_ins;
+    while (ins) {
+        MVMSpeshAnn *ann = ins->annotations;
+        while (ann) {
+            if (ann->type == MVM_SPESH_ANN_DEOPT_ONE_INS || ann->type == MVM_SPESH_ANN_DEOPT_ALL_INS)
+                return ann->data.deopt_idx;
+            ann = ann->next;
+        }
+        ins = ins->next;
+    }
+    return -1;
+}
+
+/* Given a register read inside the loop, sees if it has the same value on
+ * every iteration. If so, returns 1 and puts the version to read in the
+ * preheader into result. */
+static MVMuint32 invariant_version(MVMThreadContext *tc, MVMSpeshGraph *g,
+                                   LICMState *ls, LICMLoop *loop, MVMSpeshOperand o,
+                                   MVMSpeshOperand *result) {
+    MVMSpeshIns *writer = MVM_spesh_get_facts(tc, g, o)->writer;
+    MVMSpeshBB *def_bb = get_def_bb(ls, o);
+
+    /* Written outside of the loop (or not at all). */
+    if (!writer || !def_bb || !ls->in_loop[def_bb->idx]) {
+        *result = o;
+        return 1;
+    }
+
+    /* A set from an invariant value; this includes those that replace the
+     * instructions we hoisted. */
+    if (writer->info->opcode == MVM_OP_set)
+        return invariant_version(tc, g, ls, loop, writer->operands[1], result);
+
+    /* A phi in the loop header that only merges a value from outside of the
+     * loop with itself. If there is an OSR edge, there may be two values
+     * from outside; the one from the entry block has no writer. */
+    if (writer->info->opcode == MVM_SSA_PHI && def_bb == loop->header) {
+        MVMSpeshOperand found[2];
+        MVMuint32 num_found = 0;
+        MVMuint16 i;
+        for (i = 1; i < writer->info->num_operands; i++) {
+            MVMSpeshOperand cand = writer->operands[i];
+            MVMSpeshBB *cand_bb;
+            if (cand.reg.i == o.reg.i)
+                continue;
+            cand_bb = get_def_bb(ls, cand);
+            if (cand_bb && ls->in_loop[cand_bb->idx])
+                return 0;
+            if ((num_found > 0 && found[0].reg.i == cand.reg.i) ||
+                    (num_found > 1 && found[1].reg.i == cand.reg.i))
+                continue;
+            if (num_found == 2)
+                return 0;
+            found[num_found++] = cand;
+        }
+        if (num_found == 1) {
+            *result = found[0];
+            return 1;
+        }
+        if (num_found == 2) {
+            MVMuint32 written_0 = MVM_spesh_get_facts(tc, g, found[0])->writer != NULL;
+            MVMuint32 written_1 = MVM_spesh_get_facts(tc, g, found[1])->writer != NULL;
+            if (written_0 != written_1) {
+                *result = written_0 ? found[0] : found[1];
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/* Checks that an instruction has no annotations that tie it to where it is. */
+static MVMuint32 movable_annotations(MVMSpeshIns *ins, MVMuint32 kind) {
+    MVMSpeshAnn *ann = ins->annotations;
+    while (ann) {
+        switch (ann->type) {
+            case MVM_SPESH_ANN_LINENO:
+            case MVM_SPESH_ANN_COMMENT:
+                break;
+            case MVM_SPESH_ANN_DEOPT_ONE_INS:
+            case MVM_SPESH_ANN_DEOPT_SYNTH:
+                if (kind != HOIST_GUARD)
+                    return 0;
+                break;
+            default:
+                return 0;
+        }
+        ann = ann->next;
+    }
+    return 1;
+}
+
+/* Adds an annotation relating a deopt point to another one whose usages
+ * were recorded in the facts. */
+static void add_synthetic_deopt_annotation(MVMThreadContext *tc, MVMSpeshGraph *g,
+                                           MVMSpeshIns *ins, MVMuint32 deopt_index) {
+    MVMSpeshAnn *ann = MVM_spesh_alloc(tc, g, sizeof(MVMSpeshAnn));
+    ann->type = MVM_SPESH_ANN_DEOPT_SYNTH;
+    ann->data.deopt_idx = deopt_index;
+    ann->next = ins->annotations;
+    ins->annotations = ann;
+}
+
+/* Hoists an instruction into the preheader, replacing it with a set from
+ * the hoisted result. */
+static MVMSpeshIns * hoist(MVMThreadContext *tc, MVMSpeshGraph *g, LICMState *ls,
+                           MVMSpeshBB *preheader, MVMSpeshIns *ins,
+                           MVMSpeshOperand *new_reads, MVMuint32 kind,
+                           MVMint32 osr_deopt_idx, MVMint32 header_deopt_idx) {
+    MVMSpeshIns *hoisted = MVM_spesh_alloc(tc, g, sizeof(MVMSpeshIns));
+    MVMSpeshOperand result;
+    MVMSpeshFacts *result_facts;
+    MVMSpeshAnn *ann, *prev_ann;
+    MVMuint16 i;
+
+    /* Make the hoisted instruction, writing to a new register. */
+    result.reg.orig = MVM_spesh_manipulate_get_unique_reg(tc, g,
+        (ins->info->operands[0] & MVM_operand_type_mask) >> 3);
+    result.reg.i = 0;
+    hoisted->info = ins->info;
+    hoisted->operands = MVM_spesh_alloc(tc, g, ins->info->num_operands * sizeof(MVMSpeshOperand));
+    hoisted->operands[0] = result;
+    for (i = 1; i < ins->info->num_operands; i++) {
+        if ((ins->info->operands[i] & MVM_operand_rw_mask) == MVM_operand_read_reg) {
+            MVM_spesh_usages_delete_by_reg(tc, g, ins->operands[i], ins);
+            hoisted->operands[i] = new_reads[i];
+            MVM_spesh_usages_add_by_reg(tc, g, new_reads[i], hoisted);
+        }
+        else {
+            hoisted->operands[i] = ins->operands[i];
+        }
+    }
+    MVM_spesh_manipulate_insert_ins(tc, preheader,
+        preheader->last_ins && preheader->last_ins->info->opcode == MVM_OP_goto
+            ? preheader->last_ins->prev
+            : preheader->last_ins,
+        hoisted);
+    MVM_spesh_copy_facts(tc, g, result, ins->operands[0]);
+    result_facts = MVM_spesh_get_facts(tc, g, result);
+    result_facts->writer = hoisted;
+    result_facts->dead_writer = 0;
+    add_def_bb(ls, result, preheader);
+
+    /* A guard deoptimizes to the head of the loop. Its deopt point is
+     * related back to the one it had inside of the loop and to the first in
+     * the loop header, so that the values they need are kept alive. */
+    if (kind == HOIST_GUARD) {
+        MVMuint32 new_deopt_idx = MVM_spesh_graph_add_deopt_annotation(tc, g, hoisted,
+            g->deopt_addrs[2 * osr_deopt_idx], MVM_SPESH_ANN_DEOPT_ONE_INS);
+        MVMuint16 deopt_operand = ins->info->num_operands - 1;
+        add_synthetic_deopt_annotation(tc, g, hoisted, ins->operands[deopt_operand].lit_ui32);
+        if (header_deopt_idx >= 0)
+            add_synthetic_deopt_annotation(tc, g, hoisted, header_deopt_idx);
+        hoisted->operands[deopt_operand].lit_ui32 = new_deopt_idx;
+    }
+
+    /* Turn the original instruction into a set, dropping any deopt points
+     * it had but keeping line numbers and comments. */
+    ins->info = MVM_op_get_op(MVM_OP_set);
+    ins->operands[1] = result;
+    MVM_spesh_usages_add_by_reg(tc, g, result, ins);
+    prev_ann = NULL;
+    ann = ins->annotations;
+    while (ann) {
+        if (ann->type == MVM_SPESH_ANN_DEOPT_ONE_INS || ann->type == MVM_SPESH_ANN_DEOPT_SYNTH) {
+            if (prev_ann)
+                prev_ann->next = ann->next;
+            else
+                ins->annotations = ann->next;
+        }
+        else {
+            prev_ann = ann;
+        }
+        ann = ann->next;
+    }
+    MVM_spesh_graph_add_comment(tc, g, ins, "hoisted out of loop");
+
+    return hoisted;
+}
+
+/* Moves the OSR edge the entry block has to the loop header over to the
+ * preheader, since that is where OSR now enters the loop. */
+static void redirect_osr_edge(MVMThreadContext *tc, MVMSpeshGraph *g,
+                              MVMSpeshBB *header, MVMSpeshBB *preheader) {
+    MVMSpeshBB *entry = g->entry;
+    MVMSpeshBB **new_pred;
+    MVMuint16 i;
+
+    /* If the preheader is already a successor of the entry block (as it is
+     * when it starts the frame), the edge to the header just goes. */
+    for (i = 0; i < entry->num_succ; i++) {
+        if (entry->succ[i] == preheader) {
+            MVM_spesh_manipulate_remove_successor(tc, entry, header);
+            return;
+        }
+    }
+
+    /* Otherwise, swap it in place, so the entry block's successors stay in
+     * the same order. */
+    for (i = 0; i < entry->num_succ; i++)
+        if (entry->succ[i] == header)
+            entry->succ[i] = preheader;
+    for (i = 0; i < header->num_pred; i++)
+        if (header->pred[i] == entry)
+            break;
+    for (; i + 1 < header->num_pred; i++)
+        header->pred[i] = header->pred[i + 1];
+    header->num_pred--;
+    new_pred = MVM_spesh_alloc(tc, g, (preheader->num_pred + 1) * sizeof(MVMSpeshBB *));
+    if (preheader->num_pred)
+        memcpy(new_pred, preheader->pred, preheader->num_pred * sizeof(MVMSpeshBB *));
+    new_pred[preheader->num_pred] = entry;
+    preheader->pred = new_pred;
+    preheader->num_pred++;
+}
+
+/* Processes a loop, hoisting what we can out of it. Returns non-zero if the
+ * control flow graph was changed. */
+static MVMuint32 process_loop(MVMThreadContext *tc, MVMSpeshGraph *g, LICMState *ls,
+                              LICMLoop *loop) {
+    MVMSpeshBB *preheader;
+    MVMSpeshIns *osr_ins = NULL;
+    MVMSpeshAnn *osr_ann;
+    MVMSpeshIns *first_hoisted = NULL;
+    MVMSpeshOperand new_reads[MVM_MAX_OPERANDS];
+    MVMuint32 has_osr_edge, may_read, i, j;
+    MVMint32 header_deopt_idx;
+
+    find_loop_body(tc, g, ls, loop);
+    preheader = find_preheader(tc, g, ls, loop, &has_osr_edge);
+    if (!preheader) {
+        if (MVM_spesh_debug_enabled(tc))
+            MVM_spesh_debug_printf(tc, "LICM: loop with header BB %d has no usable preheader\n",
+                loop->header->idx);
+        return 0;
+    }
+
+    /* If the loop header is an OSR entry point, we'll need to move that to
+     * the hoisted code so it's run upon OSR also. */
+    osr_ann = find_osr_ann(loop->header, &osr_ins);
+    if (has_osr_edge && !osr_ann)
+        return 0;
+    header_deopt_idx = find_header_deopt_idx(loop->header);
+
+    /* We can only hoist reads if nothing in the loop may write. */
+    may_read = 1;
+    for (i = 0; i < MVM_VECTOR_ELEMS(loop->blocks) && may_read; i++) {
+        MVMSpeshIns *ins = loop->blocks[i]->first_ins;
+        while (ins) {
+            if (may_write(ins)) {
+                may_read = 0;
+                break;
+            }
+            ins = ins->next;
+        }
+    }
+
+    /* Look for instructions to hoist. */
+    for (i = 0; i < MVM_VECTOR_ELEMS(loop->blocks); i++) {
+        MVMSpeshBB *bb = loop->blocks[i];
+        MVMSpeshIns *ins = bb->first_ins;
+        MVMuint32 every_iteration = 1;
+        for (j = 0; j < MVM_VECTOR_ELEMS(loop->latches); j++) {
+            if (!dominates(ls, bb, loop->latches[j])) {
+                every_iteration = 0;
+                break;
+            }
+        }
+        while (ins) {
+            MVMSpeshIns *next = ins->next;
+            MVMuint32 kind = hoist_kind(ins);
+            MVMuint32 ok = kind != HOIST_NONE && movable_annotations(ins, kind);
+            if (ok && kind == HOIST_READ && !may_read)
+                ok = 0;
+            if (ok && kind == HOIST_GUARD && (!every_iteration || bb->inlined || !osr_ann))
+                ok = 0;
+            for (j = 1; ok && j < ins->info->num_operands; j++) {
+                if ((ins->info->operands[j] & MVM_operand_rw_mask) == MVM_operand_read_reg)
+                    ok = invariant_version(tc, g, ls, loop, ins->operands[j], &(new_reads[j]));
+                else if ((ins->info->operands[j] & MVM_operand_rw_mask) == MVM_operand_write_reg)
+                    ok = 0;
+            }
+            if (ok && kind == HOIST_READ) {
+                MVMSpeshFacts *obj_facts = MVM_spesh_get_facts(tc, g, new_reads[1]);
+                MVMuint32 needed = MVM_SPESH_FACT_KNOWN_TYPE | MVM_SPESH_FACT_CONCRETE;
+                ok = (obj_facts->flags & needed) == needed;
+            }
+            if (ok) {
+                MVMSpeshIns *hoisted = hoist(tc, g, ls, preheader, ins, new_reads, kind,
+                    osr_ann ? osr_ann->data.deopt_idx : -1, header_deopt_idx);
+                if (!first_hoisted)
+                    first_hoisted = hoisted;
+                if (MVM_spesh_debug_enabled(tc))
+                    MVM_spesh_debug_printf(tc, "LICM: hoisted %s from BB %d to BB %d\n",
+                        hoisted->info->name, bb->idx, preheader->idx);
+            }
+            ins = next;
+        }
+    }
+
+    /* Move OSR entry to the hoisted code, so it's run when we enter the loop
+     * that way, along with the OSR edge in the graph. */
+    if (first_hoisted && osr_ann) {
+        MVMSpeshAnn *ann = osr_ins->annotations;
+        if (ann == osr_ann) {
+            osr_ins->annotations = ann->next;
+        }
+        else {
+            while (ann->next != osr_ann)
+                ann = ann->next;
+            ann->next = osr_ann->next;
+        }
+        osr_ann->next = first_hoisted->annotations;
+        first_hoisted->annotations = osr_ann;
+        if (has_osr_edge) {
+            redirect_osr_edge(tc, g, loop->header, preheader);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Performs loop-invariant code motion on the graph. Must be run with the
+ * dominator tree up to date. */
+void MVM_spesh_licm(MVMThreadContext *tc, MVMSpeshGraph *g) {
+    LICMState ls;
+    MVMSpeshBB *bb;
+    MVMuint32 cfg_changed = 0;
+    MVMuint32 i, j;
+
+    /* Set up state, working out the dominators and loops. */
+    ls.num_bbs = 0;
+    bb = g->entry;
+    while (bb) {
+        if (bb->idx >= ls.num_bbs)
+            ls.num_bbs = bb->idx + 1;
+        bb = bb->linear_next;
+    }
+    ls.idom = MVM_calloc(ls.num_bbs, sizeof(MVMSpeshBB *));
+    ls.in_loop = MVM_malloc(ls.num_bbs);
+    record_idoms(&ls, g->entry);
+    MVM_VECTOR_INIT(ls.loops, 0);
+    find_loops(tc, g, &ls);
+
+    if (MVM_VECTOR_ELEMS(ls.loops)) {
+        /* Process inner loops before outer ones; a loop's body is always
+         * bigger than that of the loops nested inside of it. */
+        record_def_bbs(tc, g, &ls);
+        for (i = 0; i < MVM_VECTOR_ELEMS(ls.loops); i++)
+            find_loop_body(tc, g, &ls, ls.loops[i]);
+        for (i = 1; i < MVM_VECTOR_ELEMS(ls.loops); i++) {
+            LICMLoop *cur = ls.loops[i];
+            j = i;
+            while (j > 0 && MVM_VECTOR_ELEMS(ls.loops[j - 1]->blocks) > MVM_VECTOR_ELEMS(cur->blocks)) {
+                ls.loops[j] = ls.loops[j - 1];
+                j--;
+            }
+            ls.loops[j] = cur;
+        }
+        for (i = 0; i < MVM_VECTOR_ELEMS(ls.loops); i++) {
+            MVM_VECTOR_CLEAR(ls.loops[i]->blocks);
+            if (process_loop(tc, g, &ls, ls.loops[i]))
+                cfg_changed = 1;
+        }
+
+        for (i = 0; i < ls.num_def_regs; i++)
+            MVM_free(ls.def_bb[i]);
+        MVM_free(ls.def_bb);
+
+        /* Moving OSR edges changes who dominates the loop headers. */
+        if (cfg_changed)
+            MVM_spesh_graph_recompute_dominance(tc, g);
+    }
+
+    /* Clean up. */
+    for (i = 0; i < MVM_VECTOR_ELEMS(ls.loops); i++) {
+        MVM_VECTOR_DESTROY(ls.loops[i]->latches);
+        MVM_VECTOR_DESTROY(ls.loops[i]->blocks);
+        MVM_free(ls.loops[i]);
+    }
+    MVM_VECTOR_DESTROY(ls.loops);
+    MVM_free(ls.in_loop);
+    MVM_free(ls.idom);
+}
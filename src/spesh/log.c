@@ -4,10 +4,14 @@
  * current thread. */
 void MVM_spesh_log_initialize_thread(MVMThreadContext *tc, MVMint32 main_thread) {
     if (tc->instance->spesh_enabled) {
-        tc->spesh_log = MVM_spesh_log_create(tc, tc->thread_obj);
-        tc->spesh_log_quota = main_thread
+        MVMSpeshLogRing *ring = MVM_calloc(1, sizeof(MVMSpeshLogRing));
+        ring->quota = main_thread
             ? MVM_SPESH_LOG_QUOTA_MAIN_THREAD
             : MVM_SPESH_LOG_QUOTA;
+        ring->size = ring->quota + MVM_SPESH_LOG_MAX_COMPUNIT_EXTRA;
+        ring->logs = MVM_calloc(ring->size, sizeof(MVMSpeshLog *));
+        tc->thread_obj->body.spesh_log_ring = ring;
+        tc->spesh_log = MVM_spesh_log_create(tc, tc->thread_obj);
     }
 }
 
@@ -21,9 +25,52 @@ MVMSpeshLog * MVM_spesh_log_create(MVMThreadContext *tc, MVMThread *target_threa
     return result;
 }
 
-/* Increments the used count and - if it hits the limit - sends the log off
- * to the worker thread and NULLs it out. */
+/* Adds a log to the current thread's log ring, and makes sure the spesh
+ * worker knows to look at it. The log quota means there is always space. */
+static void ring_add(MVMThreadContext *tc, MVMSpeshLog *sl) {
+    MVMSpeshLogRing *ring = tc->thread_obj->body.spesh_log_ring;
+    AO_t head = MVM_load(&(ring->head));
+    MVM_ASSIGN_REF(tc, &(tc->thread_obj->common.header), ring->logs[head % ring->size], sl);
+    MVM_store(&(ring->head), head + 1);
+    MVM_incr(&(tc->instance->spesh_logs_waiting));
+    if (MVM_cas(&(ring->notified), 0, 1) == 0)
+        MVM_repr_push_o(tc, tc->instance->spesh_queue, (MVMObject *)tc->thread_obj);
+}
+
+/* Takes the oldest log out of a thread's log ring, or returns NULL if it is
+ * empty. Only to be called by the spesh worker. */
+MVMSpeshLog * MVM_spesh_log_ring_take(MVMThreadContext *tc, MVMSpeshLogRing *ring) {
+    AO_t tail = MVM_load(&(ring->tail));
+    MVMSpeshLog *sl;
+    if (tail == MVM_load(&(ring->head)))
+        return NULL;
+    sl = ring->logs[tail % ring->size];
+    ring->logs[tail % ring->size] = NULL;
+    MVM_store(&(ring->tail), tail + 1);
+    MVM_decr(&(tc->instance->spesh_logs_waiting));
+    return sl;
+}
+
+/* Marks the logs in a log ring. */
+void MVM_spesh_log_ring_gc_mark(MVMThreadContext *tc, MVMSpeshLogRing *ring, MVMGCWorklist *worklist) {
+    if (ring) {
+        MVMuint32 i;
+        for (i = 0; i < ring->size; i++)
+            MVM_gc_worklist_add(tc, worklist, &(ring->logs[i]));
+    }
+}
+
+/* Frees the memory associated with a log ring. */
+void MVM_spesh_log_ring_destroy(MVMThreadContext *tc, MVMSpeshLogRing *ring) {
+    MVM_free(ring->logs);
+    MVM_free(ring);
+}
+
+/* Sends a log off to the worker thread and, provided the thread has quota
+ * left, gives it a fresh one to write into. Otherwise, logging stops until
+ * the worker has processed one of the thread's logs and restores it. */
 void send_log(MVMThreadContext *tc, MVMSpeshLog *sl) {
+    MVMSpeshLogRing *ring = tc->thread_obj->body.spesh_log_ring;
     if (tc->instance->spesh_blocking) {
         uv_mutex_t *block_mutex;
         uv_cond_t *block_condvar;
@@ -33,7 +80,7 @@ void send_log(MVMThreadContext *tc, MVMSpeshLog *sl) {
         uv_cond_init(sl->body.block_condvar);
         uv_mutex_lock(sl->body.block_mutex);
         MVMROOT(tc, sl, {
-            MVM_repr_push_o(tc, tc->instance->spesh_queue, (MVMObject *)sl);
+            ring_add(tc, sl);
             MVM_gc_mark_thread_blocked(tc);
             while (!MVM_load(&(sl->body.completed)))
                 uv_cond_wait(block_condvar, block_mutex);
@@ -42,13 +89,17 @@ void send_log(MVMThreadContext *tc, MVMSpeshLog *sl) {
         uv_mutex_unlock(sl->body.block_mutex);
     }
     else {
-        MVM_repr_push_o(tc, tc->instance->spesh_queue, (MVMObject *)sl);
+        ring_add(tc, sl);
     }
-    if (MVM_decr(&(tc->spesh_log_quota)) > 1) {
+    if (MVM_decr(&(ring->quota)) > 1) {
         tc->spesh_log = MVM_spesh_log_create(tc, tc->thread_obj);
     }
     else {
+        MVM_incr(&(ring->quota_exhausted));
+        MVM_incr(&(tc->instance->spesh_log_quota_exhausted));
         MVM_telemetry_timestamp(tc, "ran out of spesh log quota");
+        if (tc->instance->profiling)
+            MVM_profiler_log_spesh_log_quota_exhausted(tc);
         tc->spesh_log = NULL;
     }
 }
@@ -63,15 +114,16 @@ void commit_entry(MVMThreadContext *tc, MVMSpeshLog *sl) {
  * enough data recorded for a tight outer loop in a benchmark. Either grant a
  * bonus log or send the log early so we can have a fresh one. */
 void MVM_spesh_log_new_compunit(MVMThreadContext *tc) {
-    if (tc->num_compunit_extra_logs < 5) {
+    MVMSpeshLogRing *ring = tc->thread_obj->body.spesh_log_ring;
+    if (ring->num_compunit_extra_logs < MVM_SPESH_LOG_MAX_COMPUNIT_EXTRA) {
         if (tc->spesh_log)
             if (tc->spesh_log->body.used > tc->spesh_log->body.limit / 4)
                 send_log(tc, tc->spesh_log);
         if (!tc->spesh_log) {
-            if (MVM_incr(&(tc->spesh_log_quota)) == 0) {
+            if (MVM_incr(&(ring->quota)) == 0) {
                 tc->spesh_log = MVM_spesh_log_create(tc, tc->thread_obj);
                 tc->spesh_log->body.was_compunit_bumped = 1;
-                MVM_incr(&(tc->num_compunit_extra_logs));
+                MVM_incr(&(ring->num_compunit_extra_logs));
             }
         }
     }
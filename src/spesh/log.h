@@ -19,6 +19,44 @@ struct MVMSpeshLogGuard {
 #define MVM_SPESH_LOG_QUOTA_MAIN_THREAD 3
 #define MVM_SPESH_LOG_QUOTA 2
 
+/* The number of extra logs that may be granted beyond the quota on entering
+ * a new compilation unit, and not yet processed by the worker. */
+#define MVM_SPESH_LOG_MAX_COMPUNIT_EXTRA 5
+
+/* A ring of spesh logs that a thread sent and the spesh worker has yet to
+ * process. Only the sending thread moves the head and only the worker moves
+ * the tail, so neither needs a lock; the head and tail just count up, and
+ * are taken modulo the size to index the logs. It is big enough for all the
+ * logs the quota and the compilation unit extra logs allow, so never fills
+ * up; instead, the thread stops logging when it runs out of quota, and the
+ * worker gives it a fresh log once it takes one out of the ring. */
+struct MVMSpeshLogRing {
+    MVMSpeshLog **logs;
+    MVMuint32 size;
+    AO_t head;
+    AO_t tail;
+
+    /* Set by the sending thread when it sends the thread to the worker to
+     * say there are logs in the ring, and cleared by the worker before it
+     * takes them, so the thread is queued at most once at a time. */
+    AO_t notified;
+
+    /* How many spesh logs the thread can produce, inclusive of the current
+     * one. */
+    AO_t quota;
+
+    /* We try to do better at OSR by creating a fresh log when we enter a new
+     * compilation unit. However, for things that EVAL or do a ton of BEGIN,
+     * we risk high memory use. Use this to throttle it by limiting the number
+     * of such extra logs that might exist at a time. */
+    AO_t num_compunit_extra_logs;
+
+    /* The number of times the thread ran out of quota and stopped logging,
+     * and the number of those the worker reported already. */
+    AO_t quota_exhausted;
+    MVMuint64 quota_exhausted_reported;
+};
+
 /* The number of logged invocations before we decide we've enough data for
  * the time being; should be at least the maximum threshold value in
  * thresholds.c, but we set it higher to allow more data collection. */
@@ -38,6 +76,9 @@ MVM_STATIC_INLINE MVMint32 MVM_spesh_log_is_caller_logging(MVMThreadContext *tc)
 void MVM_spesh_log_initialize_thread(MVMThreadContext *tc, MVMint32 main_thread);
 MVMSpeshLog * MVM_spesh_log_create(MVMThreadContext *tc, MVMThread *target_thread);
 void MVM_spesh_log_new_compunit(MVMThreadContext *tc);
+MVMSpeshLog * MVM_spesh_log_ring_take(MVMThreadContext *tc, MVMSpeshLogRing *ring);
+void MVM_spesh_log_ring_gc_mark(MVMThreadContext *tc, MVMSpeshLogRing *ring, MVMGCWorklist *worklist);
+void MVM_spesh_log_ring_destroy(MVMThreadContext *tc, MVMSpeshLogRing *ring);
 void MVM_spesh_log_entry(MVMThreadContext *tc, MVMint32 cid, MVMStaticFrame *sf,
         MVMCallsite *cs, MVMRegister *args);
 void MVM_spesh_log_osr(MVMThreadContext *tc);
@@ -10,14 +10,15 @@ static void optimize_bb(MVMThreadContext *tc, MVMSpeshGraph *g, MVMSpeshBB *bb,
 /* Logging of whether we can or can't inline. */
 static void log_inline(MVMThreadContext *tc, MVMSpeshGraph *g, MVMStaticFrame *target_sf,
                        MVMSpeshGraph *inline_graph, MVMuint32 bytecode_size,
-                       char *no_inline_reason, MVMint32 unspecialized, const MVMOpInfo *no_inline_info) {
+                       char *no_inline_reason, MVMint32 unspecialized, const MVMOpInfo *no_inline_info,
+                       MVMuint32 max_size, MVMuint32 site_hits, MVMuint32 caller_hits) {
     if (tc->instance->spesh_inline_log) {
         char *c_name_i = MVM_string_utf8_encode_C_string(tc, target_sf->body.name);
         char *c_cuid_i = MVM_string_utf8_encode_C_string(tc, target_sf->body.cuuid);
         char *c_name_t = MVM_string_utf8_encode_C_string(tc, g->sf->body.name);
         char *c_cuid_t = MVM_string_utf8_encode_C_string(tc, g->sf->body.cuuid);
         if (inline_graph) {
-            fprintf(stderr, "Can inline %s%s (%s) with bytecode size %u into %s (%s)\n",
+            fprintf(stderr, "Can inline %s%s (%s) with bytecode size %u into %s (%s)",
                 unspecialized ? "unspecialized " : "",
                 c_name_i, c_cuid_i,
                 bytecode_size, c_name_t, c_cuid_t);
@@ -28,17 +29,32 @@ static void log_inline(MVMThreadContext *tc, MVMSpeshGraph *g, MVMStaticFrame *t
             if (no_inline_info) {
                 fprintf(stderr, " - ins: %s", no_inline_info->name);
             }
-            fprintf(stderr, "\n");
         }
+        fprintf(stderr, " [limit %u, site hits %u, caller hits %u, budget used %u of %u]\n",
+            max_size, site_hits, caller_hits, g->inlined_bytecode_size,
+            MVM_spesh_inline_get_budget(tc, g));
         MVM_free(c_name_i);
         MVM_free(c_cuid_i);
         MVM_free(c_name_t);
         MVM_free(c_cuid_t);
     }
-    if (inline_graph && MVM_spesh_debug_enabled(tc)) {
-        char *dump = MVM_spesh_dump(tc, inline_graph);
-        MVM_spesh_debug_printf(tc, "Inlining graph\n%s\n", dump);
-        MVM_free(dump);
+    if (MVM_spesh_debug_enabled(tc)) {
+        char *c_name_i = MVM_string_utf8_encode_C_string(tc, target_sf->body.name);
+        char *c_cuid_i = MVM_string_utf8_encode_C_string(tc, target_sf->body.cuuid);
+        MVM_spesh_debug_printf(tc,
+            "Inline decision for %s%s (%s): %s (size %u, limit %u, site hits %u, "
+            "caller hits %u, budget used %u of %u)\n",
+            unspecialized ? "unspecialized " : "", c_name_i, c_cuid_i,
+            inline_graph ? "inlined" : no_inline_reason,
+            bytecode_size, max_size, site_hits, caller_hits,
+            g->inlined_bytecode_size, MVM_spesh_inline_get_budget(tc, g));
+        MVM_free(c_name_i);
+        MVM_free(c_cuid_i);
+        if (inline_graph) {
+            char *dump = MVM_spesh_dump(tc, inline_graph);
+            MVM_spesh_debug_printf(tc, "Inlining graph\n%s\n", dump);
+            MVM_free(dump);
+        }
     }
 }
 
@@ -1503,6 +1519,35 @@ MVMuint32 find_invoke_offset(MVMThreadContext *tc, MVMSpeshIns *ins) {
     return 0;
 }
 
+/* Given an invoke instruction, totals up how many times the call site was
+ * hit and how many times the caller was entered, according to the stats the
+ * plan was made from. Both are left zero if we have no stats. */
+static void find_call_site_hits(MVMThreadContext *tc, MVMSpeshIns *ins, MVMSpeshPlanned *p,
+                                MVMuint32 *site_hits_out, MVMuint32 *caller_hits_out) {
+    MVMuint32 site_hits = 0;
+    MVMuint32 caller_hits = 0;
+    MVMuint32 invoke_offset = find_invoke_offset(tc, ins);
+    if (p && invoke_offset) {
+        MVMuint32 i;
+        for (i = 0; i < p->num_type_stats; i++) {
+            MVMSpeshStatsByType *ts = p->type_stats[i];
+            MVMuint32 j;
+            caller_hits += ts->hits + ts->osr_hits;
+            for (j = 0; j < ts->num_by_offset; j++) {
+                if (ts->by_offset[j].bytecode_offset == invoke_offset) {
+                    MVMSpeshStatsByOffset *by_offset = &(ts->by_offset[j]);
+                    MVMuint32 k;
+                    for (k = 0; k < by_offset->num_invokes; k++)
+                        site_hits += by_offset->invokes[k].count;
+                    break;
+                }
+            }
+        }
+    }
+    *site_hits_out = site_hits;
+    *caller_hits_out = caller_hits;
+}
+
 /* Given an instruction, finds the deopt target on it. Panics if there is not
  * one there. */
 void find_deopt_target_and_index(MVMThreadContext *tc, MVMSpeshGraph *g, MVMSpeshIns *ins,
@@ -1850,11 +1895,13 @@ static void optimize_call(MVMThreadContext *tc, MVMSpeshGraph *g, MVMSpeshBB *bb
          * a static value. */
         code = callee_facts->value.o;
     }
-    else if (p) {
+    else if (p && !MVM_spesh_candidate_deopt_storm_at(tc, g->sf,
+                g->deopt_addrs[2 * prepargs_deopt_idx])) {
         /* See if there is a stable static frame at the callsite. If so, add
          * the resolution and guard instruction. Note that we must keep the
          * temporary alive throughout the whole guard and invocation sequence,
-         * as an inline may use it during deopt to find the code ref. */
+         * as an inline may use it during deopt to find the code ref. (We
+         * don't when such guards caused a deopt storm here before.) */
         target_sf = find_invokee_static_frame(tc, p, ins);
         if (target_sf) {
             code_temp = MVM_spesh_manipulate_get_temp_reg(tc, g, MVM_reg_obj);
@@ -1870,7 +1917,8 @@ static void optimize_call(MVMThreadContext *tc, MVMSpeshGraph *g, MVMSpeshBB *bb
      * this if the callsite isn't too big for arg_info. */
     num_arg_slots = arg_info->cs->num_pos +
         2 * (arg_info->cs->flag_count - arg_info->cs->num_pos);
-    if (p) {
+    if (p && !MVM_spesh_candidate_deopt_storm_at(tc, g->sf,
+            g->deopt_addrs[2 * prepargs_deopt_idx])) {
         stable_type_tuple = num_arg_slots <= MAX_ARGS_FOR_OPT
             ? find_invokee_type_tuple(tc, g, bb, ins, p, arg_info->cs)
             : NULL;
@@ -1993,6 +2041,12 @@ static void optimize_call(MVMThreadContext *tc, MVMSpeshGraph *g, MVMSpeshBB *bb
     if (target_sf->body.instrumentation_level == tc->instance->instrumentation_level) {
         MVMint32 spesh_cand = try_find_spesh_candidate(tc, target_sf, arg_info,
             stable_type_tuple);
+
+        /* Weigh the size we're willing to inline by how hot the site is. */
+        MVMuint32 site_hits, caller_hits, max_inline_size;
+        find_call_site_hits(tc, ins, p, &site_hits, &caller_hits);
+        max_inline_size = MVM_spesh_inline_get_site_max_size(tc, target_sf,
+            site_hits, caller_hits);
         if (spesh_cand >= 0) {
             /* Yes. Will we be able to inline? */
             char *no_inline_reason = NULL;
@@ -2000,8 +2054,9 @@ static void optimize_call(MVMThreadContext *tc, MVMSpeshGraph *g, MVMSpeshBB *bb
             MVMuint32 effective_size;
             MVMSpeshGraph *inline_graph = MVM_spesh_inline_try_get_graph(tc, g,
                 target_sf, target_sf->body.spesh->body.spesh_candidates[spesh_cand],
-                ins, &no_inline_reason, &effective_size, &no_inline_info);
-            log_inline(tc, g, target_sf, inline_graph, effective_size, no_inline_reason, 0, no_inline_info);
+                ins, max_inline_size, &no_inline_reason, &effective_size, &no_inline_info);
+            log_inline(tc, g, target_sf, inline_graph, effective_size, no_inline_reason, 0,
+                no_inline_info, max_inline_size, site_hits, caller_hits);
             if (inline_graph) {
                 /* Yes, have inline graph, so go ahead and do it. Make sure we
                  * keep the code ref reg alive by giving it a usage count as
@@ -2081,13 +2136,14 @@ static void optimize_call(MVMThreadContext *tc, MVMSpeshGraph *g, MVMSpeshBB *bb
 
         /* We know what we're calling, but there's no specialization available
          * to us. If it's small, then we could produce one and inline it. */
-        else if (target_sf->body.bytecode_size < MVM_spesh_inline_get_max_size(tc, target_sf)) {
+        else if (target_sf->body.bytecode_size < max_inline_size) {
             char *no_inline_reason = NULL;
             const MVMOpInfo *no_inline_info = NULL;
             MVMSpeshGraph *inline_graph = MVM_spesh_inline_try_get_graph_from_unspecialized(
-                    tc, g, target_sf, ins, arg_info, stable_type_tuple, &no_inline_reason, &no_inline_info);
+                    tc, g, target_sf, ins, arg_info, stable_type_tuple, max_inline_size,
+                    &no_inline_reason, &no_inline_info);
             log_inline(tc, g, target_sf, inline_graph, target_sf->body.bytecode_size,
-                    no_inline_reason, 1, no_inline_info);
+                    no_inline_reason, 1, no_inline_info, max_inline_size, site_hits, caller_hits);
             if (inline_graph) {
                 MVMSpeshOperand code_ref_reg = ins->info->opcode == MVM_OP_invoke_v
                         ? ins->operands[0]
@@ -2104,7 +2160,7 @@ static void optimize_call(MVMThreadContext *tc, MVMSpeshGraph *g, MVMSpeshBB *bb
         else {
             log_inline(tc, g, target_sf, NULL, target_sf->body.bytecode_size,
                 "no spesh candidate available and bytecode too large to produce an inline",
-                0, NULL);
+                0, NULL, max_inline_size, site_hits, caller_hits);
         }
     }
 
@@ -3340,17 +3396,41 @@ void MVM_spesh_optimize(MVMThreadContext *tc, MVMSpeshGraph *g, MVMSpeshPlanned
     MVM_spesh_graph_recompute_dominance(tc, g);
     eliminate_unused_log_guards(tc, g);
     eliminate_pointless_gotos(tc, g);
+
+    /* Eliminate redundant computations and guards, hoist loop-invariant code
+     * out of loops, and then drop bounds checks on native array accesses
+     * that are known to be in range (which is easier to see once the element
+     * count read is out of the loop). These rely on the dominator tree being
+     * up to date, and must happen before unused deopt usages are removed,
+     * since hoisted guards relate their new deopt points to those they had
+     * before. */
+    if (tc->instance->spesh_gvn_enabled)
+        MVM_spesh_gvn(tc, g);
+    if (tc->instance->spesh_licm_enabled)
+        MVM_spesh_licm(tc, g);
+    if (tc->instance->spesh_bce_enabled)
+        MVM_spesh_range_bce(tc, g);
     MVM_spesh_usages_remove_unused_deopt(tc, g);
     MVM_spesh_eliminate_dead_ins(tc, g);
 
     merge_bbs(tc, g);
 
+    /* Replace simple counted loops over native arrays with ops that do the
+     * whole loop at once, now their bodies are in a single basic block. */
+    if (tc->instance->spesh_vec_enabled)
+        MVM_spesh_vectorize(tc, g);
+
     /* Perform partial escape analysis at this point, which may make more
      * information available, or give more `set` instructions for the `set`
      * elimination in the post-inline pass to get rid of. */
     if (tc->instance->spesh_pea_enabled)
         MVM_spesh_pea(tc, g);
 
+    /* Keep boxed numbers flowing around loops unboxed, leaving the boxes
+     * that are no longer needed to the dead instruction elimination. */
+    if (tc->instance->spesh_unbox_enabled)
+        MVM_spesh_unbox(tc, g);
+
     /* Make a post-inline pass through the graph doing things that are better
      * done after inlinings have taken place. Note that these things must not
      * add new fact dependencies. Do a final dead instruction elimination pass
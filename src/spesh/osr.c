@@ -3,27 +3,101 @@
 /* Writes to stderr about each OSR that we perform. */
 #define MVM_LOG_OSR 0
 
-/* Locates deopt index matching OSR point. */
-static MVMint32 get_osr_deopt_index(MVMThreadContext *tc, MVMSpeshCandidate *cand) {
-    /* Calculate offset. */
-    MVMint32 offset = (*(tc->interp_cur_op) - *(tc->interp_bytecode_start));
-
-    /* Locate it in the deopt table. */
-    MVMint32 i;
-    for (i = 0; i < cand->num_deopts; i++)
-        if (cand->deopts[2 * i] == offset)
-            return i;
-
-    /* If we couldn't locate it, something is really very wrong. */
-    MVM_oops(tc, "Spesh: get_osr_deopt_index failed");
+/* Gets the bytecode offset of the OSR point we are at. */
+static MVMuint32 get_osr_offset(MVMThreadContext *tc) {
+    return *(tc->interp_cur_op) - *(tc->interp_bytecode_start);
 }
 
-/* Does the jump into the optimized code. */
-void perform_osr(MVMThreadContext *tc, MVMSpeshCandidate *specialized) {
+/* Locates the entry point of a candidate matching the OSR point we are at,
+ * returning NULL if it has none (for example, if the loop was optimized
+ * away). */
+static MVMSpeshOSREntry * find_osr_entry(MVMThreadContext *tc, MVMSpeshCandidate *cand) {
+    MVMuint32 offset = get_osr_offset(tc);
+    MVMuint32 lo = 0;
+    MVMuint32 hi = cand->num_osr_entries;
+    while (lo < hi) {
+        MVMuint32 mid = lo + (hi - lo) / 2;
+        MVMSpeshOSREntry *entry = &(cand->osr_entries[mid]);
+        if (entry->bytecode_offset == offset)
+            return entry;
+        if (entry->bytecode_offset < offset)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return NULL;
+}
+
+/* Checks if a boxed integer holds a big integer, which we may not be able
+ * to unbox without losing its value. */
+static MVMint32 is_big_int(MVMThreadContext *tc, MVMObject *obj) {
+    MVMP6bigintBody *body = NULL;
+    if (REPR(obj)->ID == MVM_REPR_ID_P6bigint) {
+        body = (MVMP6bigintBody *)OBJECT_BODY(obj);
+    }
+    else if (REPR(obj)->ID == MVM_REPR_ID_P6opaque) {
+        MVMuint16 offset = MVM_p6opaque_get_bigint_offset(tc, STABLE(obj));
+        if (offset)
+            body = (MVMP6bigintBody *)((char *)MVM_p6opaque_real_data(tc, OBJECT_BODY(obj))
+                + offset - sizeof(MVMObject));
+    }
+    return body && MVM_BIGINT_IS_BIG(body);
+}
+
+/* The specialization may keep boxed values unboxed in the loop we are
+ * entering. Checks that the values in the registers at this point are
+ * boxes of the type it expects, and that they can be unboxed. */
+static MVMint32 can_unbox_for_osr(MVMThreadContext *tc, MVMSpeshCandidate *cand,
+                                  MVMint32 osr_index) {
+    MVMuint32 i;
+    for (i = 0; i < MVM_VECTOR_ELEMS(cand->deopt_pea.osr_unbox); i++) {
+        MVMSpeshPEAOSRUnbox *ou = &(cand->deopt_pea.osr_unbox[i]);
+        if (ou->deopt_idx == osr_index) {
+            MVMObject *obj = tc->cur_frame->work[ou->obj_reg].o;
+            MVMSTable *st = (MVMSTable *)cand->spesh_slots[ou->stable_sslot];
+            if (!obj || !IS_CONCRETE(obj) || STABLE(obj) != st)
+                return 0;
+            if (ou->kind == MVM_reg_int64 && is_big_int(tc, obj))
+                return 0;
+        }
+    }
+    return 1;
+}
+
+/* Unboxes the values the specialization keeps unboxed into their native
+ * registers; the work area must already have been resized. */
+static void unbox_for_osr(MVMThreadContext *tc, MVMSpeshCandidate *cand,
+                          MVMint32 osr_index) {
+    MVMuint32 i;
+    for (i = 0; i < MVM_VECTOR_ELEMS(cand->deopt_pea.osr_unbox); i++) {
+        MVMSpeshPEAOSRUnbox *ou = &(cand->deopt_pea.osr_unbox[i]);
+        if (ou->deopt_idx == osr_index) {
+            MVMObject *obj = tc->cur_frame->work[ou->obj_reg].o;
+            if (ou->kind == MVM_reg_num64)
+                tc->cur_frame->work[ou->native_reg].n64 = MVM_repr_get_num(tc, obj);
+            else
+                tc->cur_frame->work[ou->native_reg].i64 = MVM_repr_get_int(tc, obj);
+        }
+    }
+}
+
+/* Does the jump into the optimized code. Returns zero if the candidate can
+ * not be entered at this OSR point, in which case we stay where we are. */
+static MVMint32 perform_osr(MVMThreadContext *tc, MVMSpeshCandidate *specialized) {
     MVMJitCode *jit_code;
     MVMint32 num_locals;
-    /* Work out the OSR deopt index, to locate the entry point. */
-    MVMint32 osr_index = get_osr_deopt_index(tc, specialized);
+    MVMint32 osr_index;
+
+    /* Find the entry point for the loop we are in. */
+    MVMSpeshOSREntry *entry = find_osr_entry(tc, specialized);
+    if (!entry)
+        return 0;
+    osr_index = entry->deopt_idx;
+
+    /* If values the specialization keeps unboxed can't be unboxed, then we
+     * stay in the unoptimized code. */
+    if (!can_unbox_for_osr(tc, specialized, osr_index))
+        return 0;
 #if MVM_LOG_OSR
     fprintf(stderr, "Performing OSR of frame '%s' (cuid: %s) at index %d\n",
         MVM_string_utf8_encode_C_string(tc, tc->cur_frame->static_info->body.name),
@@ -87,6 +161,9 @@ void perform_osr(MVMThreadContext *tc, MVMSpeshCandidate *specialized) {
         memset((char *)tc->cur_frame->env + keep_bytes, 0, to_null);
     }
 
+    /* Unbox any values kept unboxed in the optimized code. */
+    unbox_for_osr(tc, specialized, osr_index);
+
     /* Set up frame to point to spesh candidate/slots. */
     tc->cur_frame->effective_spesh_slots = specialized->spesh_slots;
     tc->cur_frame->spesh_cand            = specialized;
@@ -94,18 +171,11 @@ void perform_osr(MVMThreadContext *tc, MVMSpeshCandidate *specialized) {
     /* Move into the optimized (and maybe JIT-compiled) code. */
 
     if (jit_code && jit_code->num_deopts) {
-        MVMint32 i;
+        if (entry->jit_label < 0)
+            MVM_oops(tc, "JIT: Could not find OSR label");
         *(tc->interp_bytecode_start)   = jit_code->bytecode;
         *(tc->interp_cur_op)           = jit_code->bytecode;
-        for (i = 0; i < jit_code->num_deopts; i++) {
-            if (jit_code->deopts[i].idx == osr_index) {
-                tc->cur_frame->jit_entry_label = jit_code->labels[jit_code->deopts[i].label];
-                break;
-            }
-        }
-
-        if (i == jit_code->num_deopts)
-            MVM_oops(tc, "JIT: Could not find OSR label");
+        tc->cur_frame->jit_entry_label = jit_code->labels[entry->jit_label];
         if (tc->instance->profiling)
             MVM_profiler_log_osr(tc, 1);
     } else {
@@ -116,14 +186,19 @@ void perform_osr(MVMThreadContext *tc, MVMSpeshCandidate *specialized) {
             MVM_profiler_log_osr(tc, 0);
     }
     *(tc->interp_reg_base) = tc->cur_frame->work;
+    return 1;
 }
 
-/* Polls for an optimization and, when one is produced, jumps into it. */
+/* Polls for an optimization and, when one is produced, jumps into it. Each
+ * loop header of the frame is an entry point, so if the candidate can't be
+ * entered at the loop we are in, we try again when we reach another. */
 void MVM_spesh_osr_poll_for_result(MVMThreadContext *tc) {
     MVMStaticFrameSpesh *spesh = tc->cur_frame->static_info->body.spesh;
     MVMint32 num_cands = spesh->body.num_spesh_candidates;
     MVMint32 seq_nr = tc->cur_frame->sequence_nr;
-    if (seq_nr != tc->osr_hunt_frame_nr || num_cands != tc->osr_hunt_num_spesh_candidates) {
+    if (seq_nr != tc->osr_hunt_frame_nr || num_cands != tc->osr_hunt_num_spesh_candidates ||
+            (tc->osr_hunt_failed_offset && tc->osr_hunt_failed_offset != get_osr_offset(tc))) {
+        tc->osr_hunt_failed_offset = 0;
         /* Provided OSR is enabled... */
         if (tc->instance->spesh_osr_enabled) {
             /* Check if there's a candidate available and install it if so. */
@@ -136,8 +211,8 @@ void MVM_spesh_osr_poll_for_result(MVMThreadContext *tc) {
                 (cs && cs->is_interned ? cs : NULL),
                 (caller ? caller->args : NULL),
                 NULL);
-            if (ag_result >= 0)
-                perform_osr(tc, spesh->body.spesh_candidates[ag_result]);
+            if (ag_result >= 0 && !perform_osr(tc, spesh->body.spesh_candidates[ag_result]))
+                tc->osr_hunt_failed_offset = get_osr_offset(tc);
         }
 
         /* Update state for avoiding checks in the common case. */
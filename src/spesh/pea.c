@@ -22,6 +22,10 @@ static void pea_log(char *fmt, ...) {
 #define TRANSFORM_ADD_DEOPT_POINT   5
 #define TRANSFORM_ADD_DEOPT_USAGE   6
 #define TRANSFORM_PROF_ALLOCATED    7
+#define TRANSFORM_PUSH_TO_SET       8
+#define TRANSFORM_BINDPOS_TO_SET    9
+#define TRANSFORM_ATPOS_TO_SET      10
+#define TRANSFORM_ELEMS_TO_CONST    11
 typedef struct {
     /* The allocation that this transform relates to eliminating. */
     MVMSpeshPEAAllocation *allocation;
@@ -48,6 +52,7 @@ typedef struct {
         struct {
             MVMint32 deopt_point_idx;
             MVMuint16 target_reg;
+            MVMuint16 num_elems;
         } dp;
         struct {
             MVMint32 deopt_point_idx;
@@ -56,6 +61,10 @@ typedef struct {
         struct {
             MVMSpeshIns *ins;
         } prof;
+        struct {
+            MVMSpeshIns *ins;
+            MVMint16 value;
+        } cnst;
     };
 } Transformation;
 
@@ -133,25 +142,64 @@ MVMint32 flattened_type_to_register_kind(MVMThreadContext *tc, MVMSTable *st) {
     }
 }
 
+/* Turns the slot type of a VMArray into a register type to allocate for its
+ * elements, if possible. Should it not be possible, returns a negative
+ * value. */
+static MVMint32 array_slot_type_to_register_kind(MVMThreadContext *tc, MVMSTable *st) {
+    switch (((MVMArrayREPRData *)st->REPR_data)->slot_type) {
+        case MVM_ARRAY_OBJ: return MVM_reg_obj;
+        case MVM_ARRAY_STR: return MVM_reg_str;
+        case MVM_ARRAY_I64: return MVM_reg_int64;
+        case MVM_ARRAY_N64: return MVM_reg_num64;
+        default:            return -1;
+    }
+}
+
+/* Gets the REPR ID of a tracked allocation. */
+static MVMuint32 allocation_repr_id(MVMSpeshPEAAllocation *alloc) {
+    return alloc->type->st->REPR->ID;
+}
+
+/* Gets the number of registers that hold the parts of a tracked object at
+ * the point the analysis has reached. */
+static MVMuint32 num_replaced_regs(MVMSpeshPEAAllocation *alloc) {
+    if (allocation_repr_id(alloc) == MVM_REPR_ID_P6opaque)
+        return ((MVMP6opaqueREPRData *)alloc->type->st->REPR_data)->num_attributes;
+    return alloc->num_elems;
+}
+
 /* Gets, allocating if needed, the deopt materialization info index of a
- * particular tracked object. */
+ * particular tracked object. For a VMArray or MVMHash, the info depends on
+ * the number of elements it has at the deopt point. */
 static MVMuint16 get_deopt_materialization_info(MVMThreadContext *tc, MVMSpeshGraph *g,
-                                                GraphState *gs, MVMSpeshPEAAllocation *alloc) {
-    if (alloc->has_deopt_materialization_idx) {
+                                                GraphState *gs, MVMSpeshPEAAllocation *alloc,
+                                                MVMuint16 num_elems) {
+    MVMuint32 is_p6o = allocation_repr_id(alloc) == MVM_REPR_ID_P6opaque;
+    if (alloc->has_deopt_materialization_idx &&
+            (is_p6o || alloc->deopt_materialization_elems == num_elems)) {
         return alloc->deopt_materialization_idx;
     }
     else {
         MVMSpeshPEAMaterializeInfo mi;
 
-        /* Build up information about registers containing attribute data. */
-        MVMP6opaqueREPRData *repr_data = (MVMP6opaqueREPRData *)alloc->type->st->REPR_data;
-        MVMuint32 num_attrs = repr_data->num_attributes;
+        /* Build up information about registers containing attribute data,
+         * and for hashes the keys. */
+        MVMuint32 num_attrs = is_p6o
+            ? ((MVMP6opaqueREPRData *)alloc->type->st->REPR_data)->num_attributes
+            : num_elems;
         MVMuint16 *attr_regs;
+        MVMuint16 *key_sslots = NULL;
         if (num_attrs > 0) {
             MVMuint32 i;
             attr_regs = MVM_malloc(num_attrs * sizeof(MVMuint16));
             for (i = 0; i < num_attrs; i++)
                 attr_regs[i] = gs->attr_regs[alloc->hypothetical_attr_reg_idxs[i]];
+            if (allocation_repr_id(alloc) == MVM_REPR_ID_MVMHash) {
+                key_sslots = MVM_malloc(num_attrs * sizeof(MVMuint16));
+                for (i = 0; i < num_attrs; i++)
+                    key_sslots[i] = MVM_spesh_add_spesh_slot_try_reuse(tc, g,
+                        (MVMCollectable *)alloc->keys[i]);
+            }
         }
         else {
             attr_regs = NULL;
@@ -161,7 +209,10 @@ static MVMuint16 get_deopt_materialization_info(MVMThreadContext *tc, MVMSpeshGr
         mi.stable_sslot = MVM_spesh_add_spesh_slot_try_reuse(tc, g, (MVMCollectable *)alloc->type->st);
         mi.num_attr_regs = num_attrs;
         mi.attr_regs = attr_regs;
+        mi.key_sslots = key_sslots;
+        mi.unboxed_kind = 0;
         alloc->deopt_materialization_idx = MVM_VECTOR_ELEMS(g->deopt_pea.materialize_info);
+        alloc->deopt_materialization_elems = num_elems;
         alloc->has_deopt_materialization_idx = 1;
         MVM_VECTOR_PUSH(g->deopt_pea.materialize_info, mi);
 
@@ -181,13 +232,26 @@ static void apply_transform(MVMThreadContext *tc, MVMSpeshGraph *g, GraphState *
     switch (t->transform) {
         case TRANSFORM_DELETE_FASTCREATE: {
             MVMSTable *st = t->fastcreate.st;
-            MVMP6opaqueREPRData *repr_data = (MVMP6opaqueREPRData *)st->REPR_data;
             MVMSpeshPEAAllocation *alloc = t->allocation;
             MVMuint32 i;
-            for (i = 0; i < repr_data->num_attributes; i++) {
-                MVMuint32 idx = alloc->hypothetical_attr_reg_idxs[i];
-                gs->attr_regs[idx] = MVM_spesh_manipulate_get_unique_reg(tc, g,
-                    flattened_type_to_register_kind(tc, repr_data->flattened_stables[i]));
+            if (st->REPR->ID == MVM_REPR_ID_P6opaque) {
+                MVMP6opaqueREPRData *repr_data = (MVMP6opaqueREPRData *)st->REPR_data;
+                for (i = 0; i < repr_data->num_attributes; i++) {
+                    MVMuint32 idx = alloc->hypothetical_attr_reg_idxs[i];
+                    gs->attr_regs[idx] = MVM_spesh_manipulate_get_unique_reg(tc, g,
+                        flattened_type_to_register_kind(tc, repr_data->flattened_stables[i]));
+                }
+            }
+            else {
+                /* The analysis is complete, so we know how many elements the
+                 * array or hash ends up with. */
+                MVMint32 kind = st->REPR->ID == MVM_REPR_ID_VMArray
+                    ? array_slot_type_to_register_kind(tc, st)
+                    : MVM_reg_obj;
+                for (i = 0; i < alloc->num_elems; i++) {
+                    MVMuint32 idx = alloc->hypothetical_attr_reg_idxs[i];
+                    gs->attr_regs[idx] = MVM_spesh_manipulate_get_unique_reg(tc, g, kind);
+                }
             }
             pea_log("OPT: eliminated an allocation of %s into r%d(%d)",
                     st->debug_name, t->fastcreate.ins->operands[0].reg.orig,
@@ -236,7 +300,8 @@ static void apply_transform(MVMThreadContext *tc, MVMSpeshGraph *g, GraphState *
         case TRANSFORM_ADD_DEOPT_POINT: {
             MVMSpeshPEADeoptPoint dp;
             dp.deopt_point_idx = t->dp.deopt_point_idx;
-            dp.materialize_info_idx = get_deopt_materialization_info(tc, g, gs, t->allocation);
+            dp.materialize_info_idx = get_deopt_materialization_info(tc, g, gs, t->allocation,
+                t->dp.num_elems);
             dp.target_reg = t->dp.target_reg;
             MVM_VECTOR_PUSH(g->deopt_pea.deopt_point, dp);
             break;
@@ -256,6 +321,50 @@ static void apply_transform(MVMThreadContext *tc, MVMSpeshGraph *g, GraphState *
                     (MVMCollectable *)STABLE(t->allocation->type));
             break;
         }
+        case TRANSFORM_PUSH_TO_SET:
+        case TRANSFORM_BINDPOS_TO_SET: {
+            /* As with attribute binds, this relies on all of the writes to
+             * elements being in the allocating basic block. */
+            MVMSpeshIns *ins = t->attr.ins;
+            MVM_spesh_usages_delete_by_reg(tc, g, ins->operands[0], ins);
+            if (t->transform == TRANSFORM_BINDPOS_TO_SET) {
+                MVM_spesh_usages_delete_by_reg(tc, g, ins->operands[1], ins);
+                ins->operands[1] = ins->operands[2];
+            }
+            ins->info = MVM_op_get_op(MVM_OP_set);
+            ins->operands[0] = MVM_spesh_manipulate_new_version(tc, g,
+                gs->attr_regs[t->attr.hypothetical_reg_idx]);
+            MVM_spesh_get_facts(tc, g, ins->operands[0])->writer = ins;
+            MVM_spesh_graph_add_comment(tc, g, ins, "write of scalar-replaced element");
+            break;
+        }
+        case TRANSFORM_ATPOS_TO_SET: {
+            MVMSpeshIns *ins = t->attr.ins;
+            MVM_spesh_usages_delete_by_reg(tc, g, ins->operands[1], ins);
+            MVM_spesh_usages_delete_by_reg(tc, g, ins->operands[2], ins);
+            ins->info = MVM_op_get_op(MVM_OP_set);
+            ins->operands[1].reg.orig = gs->attr_regs[t->attr.hypothetical_reg_idx];
+            ins->operands[1].reg.i = MVM_spesh_manipulate_get_current_version(tc, g,
+                ins->operands[1].reg.orig);
+            MVM_spesh_usages_add_by_reg(tc, g, ins->operands[1], ins);
+            MVM_spesh_graph_add_comment(tc, g, ins, "read of scalar-replaced element");
+            break;
+        }
+        case TRANSFORM_ELEMS_TO_CONST: {
+            MVMSpeshIns *ins = t->cnst.ins;
+            MVMSpeshFacts *tgt_facts = MVM_spesh_get_facts(tc, g, ins->operands[0]);
+            MVMuint16 i;
+            for (i = 1; i < ins->info->num_operands; i++)
+                if ((ins->info->operands[i] & MVM_operand_rw_mask) == MVM_operand_read_reg)
+                    MVM_spesh_usages_delete_by_reg(tc, g, ins->operands[i], ins);
+            MVM_spesh_graph_add_comment(tc, g, ins, "%s of scalar-replaced %s",
+                ins->info->name, t->allocation->type->st->REPR->name);
+            ins->info = MVM_op_get_op(MVM_OP_const_i64_16);
+            ins->operands[1].lit_i16 = t->cnst.value;
+            tgt_facts->flags |= MVM_SPESH_FACT_KNOWN_VALUE | MVM_SPESH_FACT_NON_NEGATIVE;
+            tgt_facts->value.i = t->cnst.value;
+            break;
+        }
         default:
             MVM_oops(tc, "Unimplemented partial escape analysis transform");
     }
@@ -273,8 +382,9 @@ static void add_tracked_register(MVMThreadContext *tc, GraphState *gs, MVMSpeshO
 /* Sees if this is something we can potentially avoid really allocating. If
  * it is, sets up the allocation tracking state that we need. */
 static MVMSpeshPEAAllocation * try_track_allocation(MVMThreadContext *tc, MVMSpeshGraph *g,
-        GraphState *gs, MVMSpeshIns *alloc_ins, MVMSTable *st) {
-    if (st->REPR->ID == MVM_REPR_ID_P6opaque) {
+        GraphState *gs, MVMSpeshBB *bb, MVMSpeshIns *alloc_ins, MVMSTable *st) {
+    MVMuint32 repr_id = st->REPR->ID;
+    if (repr_id == MVM_REPR_ID_P6opaque) {
         MVMP6opaqueREPRData *repr_data = (MVMP6opaqueREPRData *)st->REPR_data;
         MVMSpeshPEAAllocation *alloc = MVM_spesh_alloc(tc, g, sizeof(MVMSpeshPEAAllocation));
         MVMuint32 i;
@@ -294,6 +404,24 @@ static MVMSpeshPEAAllocation * try_track_allocation(MVMThreadContext *tc, MVMSpe
         add_tracked_register(tc, gs, alloc_ins->operands[0], alloc);
         return alloc;
     }
+    else if ((repr_id == MVM_REPR_ID_VMArray && array_slot_type_to_register_kind(tc, st) >= 0)
+            || repr_id == MVM_REPR_ID_MVMHash) {
+        /* Arrays and hashes start out empty; we set aside hypothetical
+         * registers for as many elements as we are willing to handle. */
+        MVMSpeshPEAAllocation *alloc = MVM_spesh_alloc(tc, g, sizeof(MVMSpeshPEAAllocation));
+        MVMuint32 i;
+        alloc->allocator = alloc_ins;
+        alloc->type = st->WHAT;
+        alloc->bb = bb;
+        alloc->hypothetical_attr_reg_idxs = MVM_spesh_alloc(tc, g,
+                MVM_SPESH_PEA_MAX_ELEMS * sizeof(MVMuint16));
+        for (i = 0; i < MVM_SPESH_PEA_MAX_ELEMS; i++)
+            alloc->hypothetical_attr_reg_idxs[i] = gs->latest_hypothetical_reg_idx++;
+        if (repr_id == MVM_REPR_ID_MVMHash)
+            alloc->keys = MVM_spesh_alloc(tc, g, MVM_SPESH_PEA_MAX_ELEMS * sizeof(MVMString *));
+        add_tracked_register(tc, gs, alloc_ins->operands[0], alloc);
+        return alloc;
+    }
     return NULL;
 }
 
@@ -392,9 +520,9 @@ static void real_object_required(MVMThreadContext *tc, MVMSpeshGraph *g, MVMSpes
 static void add_scalar_replacement_deopt_usages(MVMThreadContext *tc, MVMSpeshGraph *g, MVMSpeshBB *bb,
                                                 GraphState *gs, MVMSpeshPEAAllocation *alloc,
                                                 MVMint32 deopt_idx) {
-    MVMP6opaqueREPRData *repr_data = (MVMP6opaqueREPRData *)alloc->type->st->REPR_data;
+    MVMuint32 num_regs = num_replaced_regs(alloc);
     MVMuint32 i;
-    for (i = 0; i < repr_data->num_attributes; i++) {
+    for (i = 0; i < num_regs; i++) {
         Transformation *tran = MVM_spesh_alloc(tc, g, sizeof(Transformation));
         tran->allocation = alloc;
         tran->transform = TRANSFORM_ADD_DEOPT_USAGE;
@@ -418,6 +546,7 @@ static void add_deopt_materializations_idx(MVMThreadContext *tc, MVMSpeshGraph *
                 tran->transform = TRANSFORM_ADD_DEOPT_POINT;
                 tran->dp.deopt_point_idx = deopt_idx;
                 tran->dp.target_reg = gs->tracked_registers[i].reg.reg.orig;
+                tran->dp.num_elems = alloc->num_elems;
                 add_transform_for_bb(tc, gs, bb, tran);
                 add_scalar_replacement_deopt_usages(tc, g, bb, gs, alloc, deopt_user_idx);
             }
@@ -458,6 +587,77 @@ static void add_deopt_materializations_ins(MVMThreadContext *tc, MVMSpeshGraph *
     }
 }
 
+/* Marks a tracked allocation as impossible to scalar replace, because of an
+ * operation on it that we don't know how to replace. */
+static void mark_irreplaceable(MVMSpeshPEAAllocation *alloc, MVMSpeshIns *ins) {
+    if (!alloc->irreplaceable) {
+        alloc->irreplaceable = 1;
+        pea_log("replacement impossible due to %s", ins->info->name);
+    }
+}
+
+/* Checks if the register kind of an operand of an instruction that reads or
+ * writes an element matches that of the elements of an array or hash. */
+static MVMuint32 element_kind_matches(MVMThreadContext *tc, MVMSpeshPEAAllocation *alloc,
+        MVMSpeshIns *ins, MVMuint16 operand) {
+    MVMint32 kind = (ins->info->operands[operand] & MVM_operand_type_mask) >> 3;
+    return kind == (allocation_repr_id(alloc) == MVM_REPR_ID_VMArray
+        ? array_slot_type_to_register_kind(tc, alloc->type->st)
+        : MVM_reg_obj);
+}
+
+/* Gets the value of an integer index operand, if it is known. */
+static MVMuint32 known_index(MVMThreadContext *tc, MVMSpeshGraph *g, MVMSpeshOperand o,
+        MVMint64 *idx) {
+    MVMSpeshFacts *facts = MVM_spesh_get_facts(tc, g, o);
+    if (facts->flags & MVM_SPESH_FACT_KNOWN_VALUE) {
+        *idx = facts->value.i;
+        return 1;
+    }
+    return 0;
+}
+
+/* Looks up a hash key operand among the keys of a tracked hash. Returns the
+ * element index, -1 if the key is known but not in the hash, or -2 if the
+ * key is not known. */
+#define KEY_ABSENT  -1
+#define KEY_UNKNOWN -2
+static MVMint32 find_key(MVMThreadContext *tc, MVMSpeshGraph *g, MVMSpeshPEAAllocation *alloc,
+        MVMSpeshOperand o) {
+    MVMSpeshFacts *facts = MVM_spesh_get_facts(tc, g, o);
+    MVMuint32 i;
+    if (!(facts->flags & MVM_SPESH_FACT_KNOWN_VALUE) || !facts->value.s)
+        return KEY_UNKNOWN;
+    for (i = 0; i < alloc->num_elems; i++)
+        if (MVM_string_equal(tc, alloc->keys[i], facts->value.s))
+            return i;
+    return KEY_ABSENT;
+}
+
+/* Adds a transform of an access to an element of a tracked array or hash. */
+static void add_element_transform(MVMThreadContext *tc, MVMSpeshGraph *g, GraphState *gs,
+        MVMSpeshBB *bb, MVMSpeshPEAAllocation *alloc, MVMSpeshIns *ins,
+        MVMuint16 transform, MVMuint32 elem_idx) {
+    Transformation *tran = MVM_spesh_alloc(tc, g, sizeof(Transformation));
+    tran->allocation = alloc;
+    tran->transform = transform;
+    tran->attr.ins = ins;
+    tran->attr.hypothetical_reg_idx = alloc->hypothetical_attr_reg_idxs[elem_idx];
+    add_transform_for_bb(tc, gs, bb, tran);
+}
+
+/* Adds a transform of an instruction into a constant, for element counts and
+ * key existence checks. */
+static void add_const_transform(MVMThreadContext *tc, MVMSpeshGraph *g, GraphState *gs,
+        MVMSpeshBB *bb, MVMSpeshPEAAllocation *alloc, MVMSpeshIns *ins, MVMint16 value) {
+    Transformation *tran = MVM_spesh_alloc(tc, g, sizeof(Transformation));
+    tran->allocation = alloc;
+    tran->transform = TRANSFORM_ELEMS_TO_CONST;
+    tran->cnst.ins = ins;
+    tran->cnst.value = value;
+    add_transform_for_bb(tc, gs, bb, tran);
+}
+
 /* Performs the analysis phase of partial escape anslysis, figuring out what
  * rewrites we can do on the graph to achieve scalar replacement of objects
  * and, perhaps, some guard eliminations. */
@@ -522,7 +722,7 @@ static MVMuint32 analyze(MVMThreadContext *tc, MVMSpeshGraph *g, GraphState *gs)
             switch (opcode) {
                 case MVM_OP_sp_fastcreate: {
                     MVMSTable *st = (MVMSTable *)g->spesh_slots[ins->operands[2].lit_i16];
-                    MVMSpeshPEAAllocation *alloc = try_track_allocation(tc, g, gs, ins, st);
+                    MVMSpeshPEAAllocation *alloc = try_track_allocation(tc, g, gs, bb, ins, st);
                     if (alloc) {
                         MVMSpeshFacts *target = MVM_spesh_get_facts(tc, g, ins->operands[0]);
                         Transformation *tran = MVM_spesh_alloc(tc, g, sizeof(Transformation));
@@ -565,7 +765,10 @@ static MVMuint32 analyze(MVMThreadContext *tc, MVMSpeshGraph *g, GraphState *gs)
                      * tracked object into a set. */
                     MVMSpeshFacts *target = MVM_spesh_get_facts(tc, g, ins->operands[0]);
                     MVMSpeshPEAAllocation *alloc = target->pea.allocation;
-                    if (allocation_tracked(alloc)) {
+                    if (allocation_tracked(alloc) && allocation_repr_id(alloc) != MVM_REPR_ID_P6opaque) {
+                        mark_irreplaceable(alloc, ins);
+                    }
+                    else if (allocation_tracked(alloc)) {
                         MVMint32 is_p6o_op = opcode == MVM_OP_sp_p6obind_i ||
                             opcode == MVM_OP_sp_p6obind_n ||
                             opcode == MVM_OP_sp_p6obind_s ||
@@ -604,7 +807,10 @@ static MVMuint32 analyze(MVMThreadContext *tc, MVMSpeshGraph *g, GraphState *gs)
                 case MVM_OP_sp_p6ogetvt_o: {
                     MVMSpeshFacts *target = MVM_spesh_get_facts(tc, g, ins->operands[1]);
                     MVMSpeshPEAAllocation *alloc = target->pea.allocation;
-                    if (allocation_tracked(alloc)) {
+                    if (allocation_tracked(alloc) && allocation_repr_id(alloc) != MVM_REPR_ID_P6opaque) {
+                        mark_irreplaceable(alloc, ins);
+                    }
+                    else if (allocation_tracked(alloc)) {
                         MVMuint16 hypothetical_reg = attribute_offset_to_reg(tc, alloc,
                                 ins->operands[2].lit_i16);
                         Transformation *tran = MVM_spesh_alloc(tc, g, sizeof(Transformation));
@@ -627,6 +833,140 @@ static MVMuint32 analyze(MVMThreadContext *tc, MVMSpeshGraph *g, GraphState *gs)
                     }
                     break;
                 }
+                case MVM_OP_push_i:
+                case MVM_OP_push_n:
+                case MVM_OP_push_s:
+                case MVM_OP_push_o: {
+                    /* Pushes onto a tracked array become writes of a new
+                     * element register, provided they happen in the block
+                     * that allocated it, so we know the number of elements
+                     * everywhere else. */
+                    MVMSpeshFacts *target = MVM_spesh_get_facts(tc, g, ins->operands[0]);
+                    MVMSpeshPEAAllocation *alloc = target->pea.allocation;
+                    if (allocation_tracked(alloc)) {
+                        if (allocation_repr_id(alloc) == MVM_REPR_ID_VMArray &&
+                                alloc->bb == bb &&
+                                alloc->num_elems < MVM_SPESH_PEA_MAX_ELEMS &&
+                                element_kind_matches(tc, alloc, ins, 1))
+                            add_element_transform(tc, g, gs, bb, alloc, ins,
+                                TRANSFORM_PUSH_TO_SET, alloc->num_elems++);
+                        else
+                            mark_irreplaceable(alloc, ins);
+                    }
+                    if (opcode == MVM_OP_push_o)
+                        real_object_required(tc, g, ins, ins->operands[1]);
+                    break;
+                }
+                case MVM_OP_bindpos_i:
+                case MVM_OP_bindpos_n:
+                case MVM_OP_bindpos_s:
+                case MVM_OP_bindpos_o:
+                case MVM_OP_sp_bindpos_i64:
+                case MVM_OP_sp_bindpos_n: {
+                    /* Binds at a known index that is either in range or just
+                     * past the end likewise become element writes. */
+                    MVMSpeshFacts *target = MVM_spesh_get_facts(tc, g, ins->operands[0]);
+                    MVMSpeshPEAAllocation *alloc = target->pea.allocation;
+                    if (allocation_tracked(alloc)) {
+                        MVMint64 idx;
+                        if (allocation_repr_id(alloc) == MVM_REPR_ID_VMArray &&
+                                alloc->bb == bb &&
+                                element_kind_matches(tc, alloc, ins, 2) &&
+                                known_index(tc, g, ins->operands[1], &idx) &&
+                                idx >= 0 && idx <= alloc->num_elems &&
+                                idx < MVM_SPESH_PEA_MAX_ELEMS) {
+                            if (idx == alloc->num_elems)
+                                alloc->num_elems++;
+                            add_element_transform(tc, g, gs, bb, alloc, ins,
+                                TRANSFORM_BINDPOS_TO_SET, idx);
+                        }
+                        else {
+                            mark_irreplaceable(alloc, ins);
+                        }
+                    }
+                    if (opcode == MVM_OP_bindpos_o)
+                        real_object_required(tc, g, ins, ins->operands[2]);
+                    break;
+                }
+                case MVM_OP_atpos_i:
+                case MVM_OP_atpos_n:
+                case MVM_OP_atpos_s:
+                case MVM_OP_atpos_o:
+                case MVM_OP_sp_atpos_i64:
+                case MVM_OP_sp_atpos_n: {
+                    MVMSpeshFacts *target = MVM_spesh_get_facts(tc, g, ins->operands[1]);
+                    MVMSpeshPEAAllocation *alloc = target->pea.allocation;
+                    if (allocation_tracked(alloc)) {
+                        MVMint64 idx;
+                        if (allocation_repr_id(alloc) == MVM_REPR_ID_VMArray &&
+                                element_kind_matches(tc, alloc, ins, 0) &&
+                                known_index(tc, g, ins->operands[2], &idx) &&
+                                idx >= 0 && idx < alloc->num_elems)
+                            add_element_transform(tc, g, gs, bb, alloc, ins,
+                                TRANSFORM_ATPOS_TO_SET, idx);
+                        else
+                            mark_irreplaceable(alloc, ins);
+                    }
+                    break;
+                }
+                case MVM_OP_bindkey_o: {
+                    /* Hash binds with a known key become element writes. */
+                    MVMSpeshFacts *target = MVM_spesh_get_facts(tc, g, ins->operands[0]);
+                    MVMSpeshPEAAllocation *alloc = target->pea.allocation;
+                    if (allocation_tracked(alloc)) {
+                        MVMint32 key_idx = allocation_repr_id(alloc) == MVM_REPR_ID_MVMHash
+                            ? find_key(tc, g, alloc, ins->operands[1])
+                            : KEY_UNKNOWN;
+                        if (alloc->bb == bb && key_idx == KEY_ABSENT &&
+                                alloc->num_elems < MVM_SPESH_PEA_MAX_ELEMS) {
+                            key_idx = alloc->num_elems++;
+                            alloc->keys[key_idx] = MVM_spesh_get_facts(tc, g,
+                                ins->operands[1])->value.s;
+                        }
+                        if (alloc->bb == bb && key_idx >= 0)
+                            add_element_transform(tc, g, gs, bb, alloc, ins,
+                                TRANSFORM_BINDPOS_TO_SET, key_idx);
+                        else
+                            mark_irreplaceable(alloc, ins);
+                    }
+                    real_object_required(tc, g, ins, ins->operands[2]);
+                    break;
+                }
+                case MVM_OP_atkey_o:
+                case MVM_OP_existskey: {
+                    MVMSpeshFacts *target = MVM_spesh_get_facts(tc, g, ins->operands[1]);
+                    MVMSpeshPEAAllocation *alloc = target->pea.allocation;
+                    if (allocation_tracked(alloc)) {
+                        MVMint32 key_idx = allocation_repr_id(alloc) == MVM_REPR_ID_MVMHash
+                            ? find_key(tc, g, alloc, ins->operands[2])
+                            : KEY_UNKNOWN;
+                        if (opcode == MVM_OP_existskey && key_idx != KEY_UNKNOWN)
+                            add_const_transform(tc, g, gs, bb, alloc, ins, key_idx >= 0);
+                        else if (opcode == MVM_OP_atkey_o && key_idx >= 0)
+                            add_element_transform(tc, g, gs, bb, alloc, ins,
+                                TRANSFORM_ATPOS_TO_SET, key_idx);
+                        else
+                            mark_irreplaceable(alloc, ins);
+                    }
+                    break;
+                }
+                case MVM_OP_elems:
+                case MVM_OP_sp_get_i64: {
+                    /* The number of elements is known statically. */
+                    MVMSpeshFacts *target = MVM_spesh_get_facts(tc, g, ins->operands[1]);
+                    MVMSpeshPEAAllocation *alloc = target->pea.allocation;
+                    if (allocation_tracked(alloc)) {
+                        MVMuint32 repr_id = allocation_repr_id(alloc);
+                        if (opcode == MVM_OP_elems
+                                ? repr_id == MVM_REPR_ID_VMArray || repr_id == MVM_REPR_ID_MVMHash
+                                : repr_id == MVM_REPR_ID_VMArray &&
+                                  ins->operands[2].lit_i16 == offsetof(MVMArray, body.elems))
+                            add_const_transform(tc, g, gs, bb, alloc, ins, alloc->num_elems);
+                        else
+                            mark_irreplaceable(alloc, ins);
+                    }
+                    break;
+                }
                 case MVM_OP_prof_allocated: {
                     MVMSpeshFacts *target = MVM_spesh_get_facts(tc, g, ins->operands[0]);
                     MVMSpeshPEAAllocation *alloc = target->pea.allocation;
@@ -717,8 +1057,11 @@ void MVM_spesh_pea(MVMThreadContext *tc, MVMSpeshGraph *g) {
 /* Clean up any deopt info. */
 void MVM_spesh_pea_destroy_deopt_info(MVMThreadContext *tc, MVMSpeshPEADeopt *deopt_pea) {
     MVMint32 i;
-    for (i = 0; i < MVM_VECTOR_ELEMS(deopt_pea->materialize_info); i++)
+    for (i = 0; i < MVM_VECTOR_ELEMS(deopt_pea->materialize_info); i++) {
         MVM_free(deopt_pea->materialize_info[i].attr_regs);
+        MVM_free(deopt_pea->materialize_info[i].key_sslots);
+    }
     MVM_VECTOR_DESTROY(deopt_pea->materialize_info);
     MVM_VECTOR_DESTROY(deopt_pea->deopt_point);
+    MVM_VECTOR_DESTROY(deopt_pea->osr_unbox);
 }
@@ -1,3 +1,7 @@
+/* The maximum number of elements a VMArray or MVMHash may have for us to
+ * scalar replace it. */
+#define MVM_SPESH_PEA_MAX_ELEMS 8
+
 /* Information about an allocation we are tracking in partial escape analysis. */
 struct MVMSpeshPEAAllocation {
     /* The allocating instruction. */
@@ -7,9 +11,17 @@ struct MVMSpeshPEAAllocation {
    MVMObject *type; 
 
     /* The set of indexes for registers we will hypothetically allocate for
-     * the attributes of this type. */
+     * the attributes of this type (or the elements, for a VMArray or an
+     * MVMHash). */
     MVMuint16 *hypothetical_attr_reg_idxs;
 
+    /* For a VMArray or MVMHash, the basic block it is allocated in (we only
+     * allow elements to be added in there), the number of elements it has
+     * at the point the analysis has reached, and for a hash their keys. */
+    MVMSpeshBB *bb;
+    MVMuint16 num_elems;
+    MVMString **keys;
+
     /* Have we seen something that invalidates our ability to scalar replace
      * this? */
     MVMuint8 irreplaceable;
@@ -17,6 +29,10 @@ struct MVMSpeshPEAAllocation {
     /* The deopt materialization index, and whether we have allocated one yet. */
     MVMuint8 has_deopt_materialization_idx;
     MVMuint16 deopt_materialization_idx;
+
+    /* The number of elements the deopt materialization was made for, since
+     * that may differ between deopt points. */
+    MVMuint16 deopt_materialization_elems;
 };
 
 /* Information held per SSA value. */
@@ -40,6 +56,10 @@ struct MVMSpeshPEADeopt {
     /* Pairings of deoptimization points and objects to materialize at those
      * point. */
     MVM_VECTOR_DECL(MVMSpeshPEADeoptPoint, deopt_point);
+
+    /* Boxed values that were kept unboxed in a loop, and so need to be
+     * unboxed when entering the specialization through OSR. */
+    MVM_VECTOR_DECL(MVMSpeshPEAOSRUnbox, osr_unbox);
 };
 
 /* The information needed to materialize a particular replaced allocation
@@ -53,8 +73,17 @@ struct MVMSpeshPEAMaterializeInfo {
     MVMuint16 num_attr_regs;
 
     /* A list of the registers holding the attributes to put into the
-     * materialized object. */
+     * materialized object (or the elements, for a VMArray or MVMHash). */
     MVMuint16 *attr_regs;
+
+    /* For an MVMHash, the spesh slots holding the key of each element;
+     * NULL otherwise. */
+    MVMuint16 *key_sslots;
+
+    /* If this is a box that was kept unboxed, the register kind of the
+     * native value (held in the single attribute register) to box; 0 for
+     * any other kind of object. */
+    MVMuint16 unboxed_kind;
 };
 
 /* Information about that needs to be materialized at a particular deopt
@@ -71,5 +100,22 @@ struct MVMSpeshPEADeoptPoint {
     MVMuint16 target_reg;
 };
 
+/* A boxed value that has to be unboxed into a native register when entering
+ * through an OSR point. */
+struct MVMSpeshPEAOSRUnbox {
+    /* The index of the OSR deopt point this applies to. */
+    MVMint32 deopt_idx;
+
+    /* The register holding the box, and the one to unbox it into. */
+    MVMuint16 obj_reg;
+    MVMuint16 native_reg;
+
+    /* The kind of the native register. */
+    MVMuint16 kind;
+
+    /* The spesh slot holding the STable the box must have. */
+    MVMuint16 stable_sslot;
+};
+
 void MVM_spesh_pea(MVMThreadContext *tc, MVMSpeshGraph *g);
 void MVM_spesh_pea_destroy_deopt_info(MVMThreadContext *tc, MVMSpeshPEADeopt *deopt_pea);
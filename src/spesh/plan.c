@@ -9,6 +9,7 @@ void add_planned(MVMThreadContext *tc, MVMSpeshPlan *plan, MVMSpeshPlannedKind k
                  MVMuint32 num_type_stats) {
     MVMSpeshPlanned *p;
     if (sf->body.bytecode_size > MVM_SPESH_MAX_BYTECODE_SIZE ||
+        sf->body.spesh->body.num_deopt_storms >= MVM_SPESH_DEOPT_STORM_MAX_DISCARDS ||
         MVM_spesh_arg_guard_exists(tc, sf->body.spesh->body.spesh_arg_guard, cs_stats->cs, type_tuple)) {
         /* Clean up allocated memory.
          * NB - the only caller is plan_for_cs, which means that we could do the
@@ -33,12 +34,16 @@ void add_planned(MVMThreadContext *tc, MVMSpeshPlan *plan, MVMSpeshPlannedKind k
     if (num_type_stats) {
         MVMuint32 i;
         p->max_depth = type_stats[0]->max_depth;
-        for (i = 1; i < num_type_stats; i++)
+        p->hotness = type_stats[0]->hits + type_stats[0]->osr_hits;
+        for (i = 1; i < num_type_stats; i++) {
             if (type_stats[i]->max_depth > p->max_depth)
                 p->max_depth = type_stats[i]->max_depth;
+            p->hotness += type_stats[i]->hits + type_stats[i]->osr_hits;
+        }
     }
     else {
         p->max_depth = cs_stats->max_depth;
+        p->hotness = cs_stats->hits + cs_stats->osr_hits;
     }
 }
 
@@ -163,16 +168,24 @@ void twiddle_stack_depths(MVMThreadContext *tc, MVMSpeshPlanned *planned, MVMuin
     }
 }
 
-/* Sorts the plan in descending order of maximum call depth. */
+/* Determines if planned specialization a should be produced ahead of b: the
+ * deepest go first, and amongst those of equal depth the hottest. */
+static MVMint32 planned_before(MVMSpeshPlanned *a, MVMSpeshPlanned *b) {
+    return a->max_depth > b->max_depth ||
+        (a->max_depth == b->max_depth && a->hotness > b->hotness);
+}
+
+/* Sorts the plan in descending order of maximum call depth, and then in
+ * descending order of hotness. */
 void sort_plan(MVMThreadContext *tc, MVMSpeshPlanned *planned, MVMuint32 n) {
     if (n >= 2) {
         MVMSpeshPlanned pivot = planned[n / 2];
         MVMuint32 i, j;
         for (i = 0, j = n - 1; ; i++, j--) {
             MVMSpeshPlanned temp;
-            while (planned[i].max_depth > pivot.max_depth)
+            while (planned_before(&(planned[i]), &pivot))
                 i++;
-            while (planned[j].max_depth < pivot.max_depth)
+            while (planned_before(&pivot, &(planned[j])))
                 j--;
             if (i >= j)
                 break;
@@ -49,6 +49,12 @@ struct MVMSpeshPlanned {
      * ahead of callers. */
     MVMuint32 max_depth;
 
+    /* The number of hits (including OSR hits) the statistics that led to
+     * this specialization being planned received. Used to order planned
+     * specializations of the same depth, so that with several workers the
+     * hottest code gets specialized first. */
+    MVMuint32 hotness;
+
     /* The static frame with the code to specialize. */
     MVMStaticFrame *sf;
 
@@ -54,10 +54,11 @@ static MVMSpeshPluginGuardSet * guard_set_for_position(MVMThreadContext *tc,
     return NULL;
 }
 
-/* Looks through a guard set and returns any result that matches. */
-static MVMObject * evaluate_guards(MVMThreadContext *tc, MVMSpeshPluginGuardSet *gs,
-        MVMCallsite *callsite, MVMuint16 *guard_offset) {
-    MVMuint32 pos = 0;
+/* Evaluates guards starting from the specified position, returning any
+ * result that matches. If single_chain is set, gives up at the first guard
+ * that fails rather than moving on to the next chain. */
+static MVMObject * evaluate_guards_from(MVMThreadContext *tc, MVMSpeshPluginGuardSet *gs,
+        MVMCallsite *callsite, MVMuint32 pos, MVMuint32 single_chain, MVMuint16 *guard_offset) {
     MVMuint32 end = gs->num_guards;
     MVMRegister *args = tc->cur_frame->args;
     MVMuint32 arg_end = callsite->flag_count;
@@ -111,6 +112,8 @@ static MVMObject * evaluate_guards(MVMThreadContext *tc, MVMSpeshPluginGuardSet
                 pos += 1;
             }
             else {
+                if (single_chain)
+                    return NULL;
                 pos += gs->guards[pos].skip_on_fail;
                 if (!MVM_is_null(tc, collected_objects))
                     MVM_repr_pos_set_elems(tc, collected_objects, 0);
@@ -120,6 +123,68 @@ static MVMObject * evaluate_guards(MVMThreadContext *tc, MVMSpeshPluginGuardSet
     return NULL;
 }
 
+/* Uses the guard set index to find the chains that may match the arguments,
+ * and evaluates those in order. */
+static MVMObject * evaluate_indexed_guards(MVMThreadContext *tc, MVMSpeshPluginGuardSet *gs,
+        MVMCallsite *callsite, MVMuint16 *guard_offset) {
+    MVMSpeshPluginGuardIndex *index = gs->index;
+    MVMObject *test = tc->cur_frame->args[index->test_idx].o;
+    MVMuint64 type_cache_id = STABLE(test)->type_cache_id;
+    MVMuint8 concreteness = IS_CONCRETE(test)
+        ? MVM_SPESH_PLUGIN_INDEX_CONC
+        : MVM_SPESH_PLUGIN_INDEX_TYPEOBJ;
+    MVMuint32 keyed, unkeyed;
+
+    /* Binary search for the first entry with the type. */
+    MVMuint32 l = 0;
+    MVMuint32 r = index->num_entries;
+    while (l < r) {
+        MVMuint32 m = l + (r - l) / 2;
+        if (index->entries[m].type_cache_id < type_cache_id)
+            l = m + 1;
+        else
+            r = m;
+    }
+
+    /* Walk the keyed chains for the type and the unkeyed chains in chain
+     * order, so we pick the same result as the linear guard walk would. */
+    keyed = l;
+    unkeyed = 0;
+    while (1) {
+        MVMuint32 chain_start;
+        MVMObject *result;
+        MVMuint32 have_keyed = keyed < index->num_entries &&
+            index->entries[keyed].type_cache_id == type_cache_id;
+        MVMuint32 have_unkeyed = unkeyed < index->num_unkeyed;
+        if (have_keyed && (!have_unkeyed ||
+                index->entries[keyed].chain_start < index->unkeyed[unkeyed])) {
+            MVMuint8 wanted = index->entries[keyed].concreteness;
+            chain_start = index->entries[keyed].chain_start;
+            keyed++;
+            if (wanted != MVM_SPESH_PLUGIN_INDEX_ANY && wanted != concreteness)
+                continue;
+        }
+        else if (have_unkeyed) {
+            chain_start = index->unkeyed[unkeyed];
+            unkeyed++;
+        }
+        else {
+            return NULL;
+        }
+        result = evaluate_guards_from(tc, gs, callsite, chain_start, 1, guard_offset);
+        if (result)
+            return result;
+    }
+}
+
+/* Looks through a guard set and returns any result that matches. */
+static MVMObject * evaluate_guards(MVMThreadContext *tc, MVMSpeshPluginGuardSet *gs,
+        MVMCallsite *callsite, MVMuint16 *guard_offset) {
+    if (gs->index)
+        return evaluate_indexed_guards(tc, gs, callsite, guard_offset);
+    return evaluate_guards_from(tc, gs, callsite, 0, 0, guard_offset);
+}
+
 /* Tries to resolve a plugin by looking at the guards for the position. */
 static MVMObject * resolve_using_guards(MVMThreadContext *tc, MVMuint32 cur_position,
         MVMCallsite *callsite, MVMuint16 *guard_offset, MVMStaticFrame *sf) {
@@ -134,6 +199,117 @@ static MVMObject * resolve_using_guards(MVMThreadContext *tc, MVMuint32 cur_posi
     return result;
 }
 
+/* Sort comparator for guard set index entries. */
+static int compare_index_entries(const void *a, const void *b) {
+    const MVMSpeshPluginGuardIndexEntry *ea = (const MVMSpeshPluginGuardIndexEntry *)a;
+    const MVMSpeshPluginGuardIndexEntry *eb = (const MVMSpeshPluginGuardIndexEntry *)b;
+    if (ea->type_cache_id != eb->type_cache_id)
+        return ea->type_cache_id < eb->type_cache_id ? -1 : 1;
+    if (ea->chain_start != eb->chain_start)
+        return ea->chain_start < eb->chain_start ? -1 : 1;
+    return 0;
+}
+
+/* Gets the position just past the end of the chain starting at pos. */
+static MVMuint32 chain_end(MVMSpeshPluginGuardSet *gs, MVMuint32 pos) {
+    while (gs->guards[pos].kind != MVM_SPESH_PLUGIN_GUARD_RESULT)
+        pos++;
+    return pos + 1;
+}
+
+/* Builds an index over the chains in a guard set, if it has enough of them
+ * that start with a type guard on the same argument to be worth it. */
+static void build_guard_index(MVMThreadContext *tc, MVMSpeshPluginGuardSet *gs) {
+    MVMSpeshPluginGuardIndex *index;
+    MVMuint32 pos, num_chains, num_keyed, best_keyed, entry, unkeyed;
+    MVMuint16 test_idx, best_test_idx;
+
+    /* Find the argument that the most chains start out by type testing.
+     * There are only ever a handful of arguments, so just try each one that
+     * we see. */
+    best_keyed = 0;
+    best_test_idx = 0;
+    num_chains = 0;
+    for (pos = 0; pos < gs->num_guards; pos = chain_end(gs, pos)) {
+        num_chains++;
+        if (gs->guards[pos].kind == MVM_SPESH_PLUGIN_GUARD_TYPE) {
+            MVMuint32 other;
+            test_idx = gs->guards[pos].test_idx;
+            if (test_idx == best_test_idx && best_keyed)
+                continue;
+            num_keyed = 0;
+            for (other = 0; other < gs->num_guards; other = chain_end(gs, other))
+                if (gs->guards[other].kind == MVM_SPESH_PLUGIN_GUARD_TYPE &&
+                        gs->guards[other].test_idx == test_idx)
+                    num_keyed++;
+            if (num_keyed > best_keyed) {
+                best_keyed = num_keyed;
+                best_test_idx = test_idx;
+            }
+        }
+    }
+    if (best_keyed < MVM_SPESH_PLUGIN_INDEX_MIN_CHAINS)
+        return;
+
+    /* Set up the index. */
+    index = MVM_fixed_size_alloc(tc, tc->instance->fsa, sizeof(MVMSpeshPluginGuardIndex));
+    index->test_idx = best_test_idx;
+    index->num_entries = best_keyed;
+    index->entries = MVM_fixed_size_alloc(tc, tc->instance->fsa,
+            best_keyed * sizeof(MVMSpeshPluginGuardIndexEntry));
+    index->num_unkeyed = num_chains - best_keyed;
+    index->unkeyed = index->num_unkeyed
+        ? MVM_fixed_size_alloc(tc, tc->instance->fsa, index->num_unkeyed * sizeof(MVMuint32))
+        : NULL;
+
+    /* Populate it. Any concreteness guard on the keyed argument is part of
+     * the key; GETATTR results are never at an argument index, so we need
+     * not worry about confusing those with it. */
+    entry = 0;
+    unkeyed = 0;
+    for (pos = 0; pos < gs->num_guards; pos = chain_end(gs, pos)) {
+        if (gs->guards[pos].kind == MVM_SPESH_PLUGIN_GUARD_TYPE &&
+                gs->guards[pos].test_idx == best_test_idx) {
+            MVMuint8 concreteness = MVM_SPESH_PLUGIN_INDEX_ANY;
+            MVMuint32 i;
+            for (i = pos + 1; gs->guards[i].kind != MVM_SPESH_PLUGIN_GUARD_RESULT; i++) {
+                if (gs->guards[i].test_idx != best_test_idx)
+                    continue;
+                if (gs->guards[i].kind == MVM_SPESH_PLUGIN_GUARD_CONC)
+                    concreteness = MVM_SPESH_PLUGIN_INDEX_CONC;
+                else if (gs->guards[i].kind == MVM_SPESH_PLUGIN_GUARD_TYPEOBJ)
+                    concreteness = MVM_SPESH_PLUGIN_INDEX_TYPEOBJ;
+            }
+            index->entries[entry].type_cache_id = gs->guards[pos].u.type->type_cache_id;
+            index->entries[entry].chain_start = pos;
+            index->entries[entry].concreteness = concreteness;
+            entry++;
+        }
+        else {
+            index->unkeyed[unkeyed++] = pos;
+        }
+    }
+    qsort(index->entries, index->num_entries, sizeof(MVMSpeshPluginGuardIndexEntry),
+            compare_index_entries);
+    gs->index = index;
+}
+
+/* Frees a guard set index, either immediately or at the next safepoint. */
+static void free_guard_index(MVMThreadContext *tc, MVMSpeshPluginGuardIndex *index,
+        MVMuint32 at_safepoint) {
+    void (*free_fn)(MVMThreadContext *, MVMFixedSizeAlloc *, size_t, void *) = at_safepoint
+        ? MVM_fixed_size_free_at_safepoint
+        : MVM_fixed_size_free;
+    if (index) {
+        free_fn(tc, tc->instance->fsa,
+                index->num_entries * sizeof(MVMSpeshPluginGuardIndexEntry), index->entries);
+        if (index->unkeyed)
+            free_fn(tc, tc->instance->fsa, index->num_unkeyed * sizeof(MVMuint32),
+                    index->unkeyed);
+        free_fn(tc, tc->instance->fsa, sizeof(MVMSpeshPluginGuardIndex), index);
+    }
+}
+
 /* Produces an updated guard set with the given resolution result. Returns
  * the base guard set if we already having a matching guard (which means two
  * threads raced to do this resolution). */
@@ -198,6 +374,8 @@ static MVMSpeshPluginGuardSet * append_guard(MVMThreadContext *tc,
         result->guards[insert_pos].kind = MVM_SPESH_PLUGIN_GUARD_RESULT;
         MVM_ASSIGN_REF(tc, &(barrier->common.header),
                 result->guards[insert_pos].u.result, resolved);
+        result->index = NULL;
+        build_guard_index(tc, result);
     }
     return result;
 }
@@ -258,6 +436,7 @@ MVMSpeshPluginState * updated_state(MVMThreadContext *tc, MVMSpeshPluginState *b
 /* Schedules replaced guards to be freed. */
 void free_dead_guards(MVMThreadContext *tc, MVMSpeshPluginGuardSet *gs) {
     if (gs) {
+        free_guard_index(tc, gs->index, 1);
         MVM_fixed_size_free_at_safepoint(tc, tc->instance->fsa,
                 gs->num_guards * sizeof(MVMSpeshPluginGuard), gs->guards);
         MVM_fixed_size_free_at_safepoint(tc, tc->instance->fsa,
@@ -985,6 +1164,7 @@ void MVM_spesh_plugin_state_free(MVMThreadContext *tc, MVMSpeshPluginState *ps)
     if (ps) {
         MVMuint32 i;
         for (i = 0; i < ps->num_positions; i++) {
+            free_guard_index(tc, ps->positions[i].guard_set->index, 0);
             MVM_fixed_size_free(tc, tc->instance->fsa,
                     ps->positions[i].guard_set->num_guards * sizeof(MVMSpeshPluginGuard),
                     ps->positions[i].guard_set->guards);
@@ -24,8 +24,51 @@ struct MVMSpeshPluginPosition {
 struct MVMSpeshPluginGuardSet {
     MVMSpeshPluginGuard *guards;
     MVMuint32 num_guards;
+
+    /* Index over the guard chains, so that megamorphic positions need not
+     * evaluate every chain; NULL if there are too few chains to need one. */
+    MVMSpeshPluginGuardIndex *index;
+};
+
+/* The index is keyed on the type and concreteness of the argument that most
+ * chains start out by type-testing. Looking up an argument's type gives the
+ * chains that may match it; those are evaluated in order, interleaved with
+ * any chains that could not be keyed, so the result is the same as that of
+ * a linear walk over the guards. */
+struct MVMSpeshPluginGuardIndex {
+    /* Keyed chains, sorted by type cache ID and then chain start. */
+    MVMSpeshPluginGuardIndexEntry *entries;
+    MVMuint32 num_entries;
+
+    /* Start positions of chains that could not be keyed, in order. */
+    MVMuint32 *unkeyed;
+    MVMuint32 num_unkeyed;
+
+    /* The argument that the index is keyed on. */
+    MVMuint16 test_idx;
 };
 
+/* An entry in the guard set index. */
+struct MVMSpeshPluginGuardIndexEntry {
+    /* The type cache ID of the type the chain tests for. We key on this
+     * rather than the STable, since the STable may be moved by the GC. */
+    MVMuint64 type_cache_id;
+
+    /* Position of the first guard of the chain. */
+    MVMuint32 chain_start;
+
+    /* The concreteness that the chain requires, if any. */
+    MVMuint8 concreteness;
+};
+
+/* Concreteness requirements of a guard set index entry. */
+#define MVM_SPESH_PLUGIN_INDEX_ANY      0
+#define MVM_SPESH_PLUGIN_INDEX_CONC     1
+#define MVM_SPESH_PLUGIN_INDEX_TYPEOBJ  2
+
+/* The number of keyed chains a guard set needs before we index it. */
+#define MVM_SPESH_PLUGIN_INDEX_MIN_CHAINS   8
+
 /* The maximum number of guards a spesh plugin can set up. */
 #define MVM_SPESH_PLUGIN_GUARD_LIMIT    16
 
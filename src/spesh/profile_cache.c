@@ -0,0 +1,734 @@
+#include "moar.h"
+#include <sha1.h>
+
+/* The specialization profile cache. Enabled by setting MVM_SPESH_PROFILE_CACHE
+ * to a filename. It is loaded once spesh is set up at startup, and saved by
+ * MVM_vm_exit or MVM_vm_destroy_instance; in between, the specialization
+ * workers record every specialization they produce, and the first invocation
+ * of a frame with a cached profile sends the frame to the worker, which seeds
+ * the frame's statistics from the cache and plans from them right away.
+ *
+ * If a specialization was also JIT compiled last time, the first invocation
+ * waits (for a bounded time) for the worker to produce it again, so that
+ * even the first call runs JIT compiled code.
+ *
+ * The file is a line-based text format. Strings are written as their length
+ * in bytes, a colon, and then the bytes, with a zero length meaning there is
+ * no string:
+ *
+ *   MoarVM spesh profile cache <format version> <version> <op set hash>
+ *   unit <bytecode SHA-1> <age> <number of entries>
+ *   entry <cuuid> <hits> <osr hits> <max depth> <jitted> <flag count>
+ *         <flags...> <name count> <names...> <has types>
+ *   type <sc handle> <idx> <concrete> <decont sc handle> <decont idx>
+ *        <decont concrete> <rw cont>
+ *
+ * With one type line per callsite flag following an entry that has types.
+ * Anything unexpected in the file causes it to be ignored as a whole, as is
+ * a file written by another version of MoarVM or one with a different set
+ * of ops, since what it specializes and JIT compiles may differ. */
+
+#define CACHE_FORMAT_VERSION 3
+
+/* Hashes the name, operands and properties of every op, including the
+ * specialized ones, into the cache's op set hash. */
+static void hash_op_set(MVMThreadContext *tc, MVMSpeshProfileCache *cache) {
+    SHA1Context context;
+    char hash[80];
+    const MVMOpInfo *info;
+    MVMuint16 op = 0;
+    SHA1Init(&context);
+    while ((info = MVM_op_get_op(op++))) {
+        MVMuint8 props[8];
+        props[0] = info->pure;
+        props[1] = info->deopt_point;
+        props[2] = info->may_cause_deopt;
+        props[3] = info->logged;
+        props[4] = info->no_inline;
+        props[5] = info->jittivity;
+        props[6] = info->uses_hll;
+        props[7] = info->specializable;
+        SHA1Update(&context, (const unsigned char *)info->name, strlen(info->name) + 1);
+        SHA1Update(&context, info->operands, info->num_operands);
+        SHA1Update(&context, props, sizeof(props));
+    }
+    SHA1Final(&context, hash);
+    memcpy(cache->op_set_hash, hash, 40);
+    cache->op_set_hash[40] = '\0';
+}
+
+/* Frees the memory held by a cache entry. */
+static void destroy_entry(MVMThreadContext *tc, MVMSpeshProfileCacheEntry *e) {
+    MVMuint32 i;
+    MVM_free(e->cuuid);
+    MVM_free(e->arg_flags);
+    for (i = 0; i < e->num_names; i++)
+        MVM_free(e->arg_names[i]);
+    MVM_free(e->arg_names);
+    if (e->types) {
+        for (i = 0; i < e->flag_count; i++) {
+            MVM_free(e->types[i].sc_handle);
+            MVM_free(e->types[i].decont_sc_handle);
+        }
+        MVM_free(e->types);
+    }
+}
+
+/* Frees the memory held by a unit and its entries. */
+static void destroy_unit(MVMThreadContext *tc, MVMSpeshProfileCacheUnit *unit) {
+    MVMuint32 i;
+    for (i = 0; i < unit->entries_num; i++)
+        destroy_entry(tc, &(unit->entries[i]));
+    MVM_VECTOR_DESTROY(unit->entries);
+    MVM_free(unit);
+}
+
+/* Checks if two, possibly NULL, C strings are equal. */
+static MVMint32 c_str_equal(const char *a, const char *b) {
+    if (!a || !b)
+        return a == b;
+    return strcmp(a, b) == 0;
+}
+
+/* Checks if two entries are for the same frame, callsite and types. */
+static MVMint32 same_profile(MVMSpeshProfileCacheEntry *a, MVMSpeshProfileCacheEntry *b) {
+    MVMuint32 i;
+    if (a->flag_count != b->flag_count || a->num_names != b->num_names)
+        return 0;
+    if (!c_str_equal(a->cuuid, b->cuuid))
+        return 0;
+    if (a->flag_count && memcmp(a->arg_flags, b->arg_flags, a->flag_count) != 0)
+        return 0;
+    for (i = 0; i < a->num_names; i++)
+        if (!c_str_equal(a->arg_names[i], b->arg_names[i]))
+            return 0;
+    if (!a->types || !b->types)
+        return a->types == b->types;
+    for (i = 0; i < a->flag_count; i++) {
+        MVMSpeshProfileCacheType *ta = &(a->types[i]);
+        MVMSpeshProfileCacheType *tb = &(b->types[i]);
+        if (!c_str_equal(ta->sc_handle, tb->sc_handle) || ta->idx != tb->idx ||
+                ta->concrete != tb->concrete || ta->rw_cont != tb->rw_cont ||
+                !c_str_equal(ta->decont_sc_handle, tb->decont_sc_handle) ||
+                ta->decont_idx != tb->decont_idx ||
+                ta->decont_concrete != tb->decont_concrete)
+            return 0;
+    }
+    return 1;
+}
+
+/* Reader over the cache file contents. */
+typedef struct {
+    char   *pos;
+    char   *limit;
+    MVMint32 failed;
+} CacheReader;
+
+static void skip_space(CacheReader *r) {
+    while (r->pos < r->limit && (*r->pos == ' ' || *r->pos == '\n' || *r->pos == '\r'))
+        r->pos++;
+}
+
+static void expect_word(CacheReader *r, const char *word) {
+    size_t len = strlen(word);
+    skip_space(r);
+    if (r->failed || (size_t)(r->limit - r->pos) < len || memcmp(r->pos, word, len) != 0)
+        r->failed = 1;
+    else
+        r->pos += len;
+}
+
+static MVMuint32 read_uint(CacheReader *r) {
+    MVMuint64 result = 0;
+    MVMint32 digits = 0;
+    skip_space(r);
+    while (!r->failed && r->pos < r->limit && *r->pos >= '0' && *r->pos <= '9') {
+        result = result * 10 + (*r->pos - '0');
+        if (result > 0xFFFFFFFF)
+            r->failed = 1;
+        r->pos++;
+        digits++;
+    }
+    if (!digits)
+        r->failed = 1;
+    return r->failed ? 0 : (MVMuint32)result;
+}
+
+static char * read_str(CacheReader *r) {
+    MVMuint32 len = read_uint(r);
+    char *result;
+    if (r->failed || r->pos >= r->limit || *r->pos != ':') {
+        r->failed = 1;
+        return NULL;
+    }
+    r->pos++;
+    if (len == 0)
+        return NULL;
+    if ((size_t)(r->limit - r->pos) < len) {
+        r->failed = 1;
+        return NULL;
+    }
+    result = MVM_malloc(len + 1);
+    memcpy(result, r->pos, len);
+    result[len] = '\0';
+    r->pos += len;
+    return result;
+}
+
+/* Reads an entry from the cache file; returns zero on failure. */
+static MVMint32 read_entry(MVMThreadContext *tc, CacheReader *r, MVMSpeshProfileCacheEntry *e) {
+    MVMuint32 i, has_types;
+    memset(e, 0, sizeof(MVMSpeshProfileCacheEntry));
+    expect_word(r, "entry");
+    e->cuuid = read_str(r);
+    e->hits = read_uint(r);
+    e->osr_hits = read_uint(r);
+    e->max_depth = read_uint(r);
+    e->jitted = read_uint(r);
+    e->flag_count = read_uint(r);
+    if (r->failed || e->flag_count >= MVM_INTERN_ARITY_LIMIT)
+        return 0;
+    if (e->flag_count) {
+        e->arg_flags = MVM_malloc(e->flag_count);
+        for (i = 0; i < e->flag_count; i++)
+            e->arg_flags[i] = (MVMCallsiteEntry)read_uint(r);
+    }
+    e->num_names = read_uint(r);
+    if (r->failed || e->num_names > e->flag_count) {
+        e->num_names = 0;
+        return 0;
+    }
+    if (e->num_names) {
+        e->arg_names = MVM_calloc(e->num_names, sizeof(char *));
+        for (i = 0; i < e->num_names; i++)
+            e->arg_names[i] = read_str(r);
+    }
+    has_types = read_uint(r);
+    if (!r->failed && has_types) {
+        e->types = MVM_calloc(e->flag_count, sizeof(MVMSpeshProfileCacheType));
+        for (i = 0; i < e->flag_count; i++) {
+            MVMSpeshProfileCacheType *t = &(e->types[i]);
+            expect_word(r, "type");
+            t->sc_handle = read_str(r);
+            t->idx = read_uint(r);
+            t->concrete = read_uint(r);
+            t->decont_sc_handle = read_str(r);
+            t->decont_idx = read_uint(r);
+            t->decont_concrete = read_uint(r);
+            t->rw_cont = read_uint(r);
+        }
+    }
+    return !r->failed;
+}
+
+/* Parses the cache file contents into the cache; returns zero on failure. */
+static MVMint32 parse_cache(MVMThreadContext *tc, MVMSpeshProfileCache *cache, CacheReader *r) {
+    expect_word(r, "MoarVM spesh profile cache");
+    if (read_uint(r) != CACHE_FORMAT_VERSION)
+        return 0;
+    expect_word(r, MVM_VERSION);
+    expect_word(r, cache->op_set_hash);
+    skip_space(r);
+    while (!r->failed && r->pos < r->limit) {
+        MVMSpeshProfileCacheUnit *unit = MVM_calloc(1, sizeof(MVMSpeshProfileCacheUnit));
+        MVMuint32 num_entries, i;
+        char *hash;
+        MVM_VECTOR_PUSH(cache->units, unit);
+        expect_word(r, "unit");
+        hash = read_str(r);
+        if (!hash || strlen(hash) != 40) {
+            MVM_free(hash);
+            return 0;
+        }
+        strcpy(unit->hash, hash);
+        MVM_free(hash);
+        unit->age = read_uint(r);
+        num_entries = read_uint(r);
+        if (r->failed)
+            return 0;
+        /* The count comes from the file, so may be anything; grow the
+         * entries as they are read rather than trusting it up front. */
+        MVM_VECTOR_INIT(unit->entries, 0);
+        for (i = 0; i < num_entries; i++) {
+            MVMSpeshProfileCacheEntry e;
+            if (!read_entry(tc, r, &e)) {
+                destroy_entry(tc, &e);
+                return 0;
+            }
+            MVM_VECTOR_PUSH(unit->entries, e);
+        }
+        skip_space(r);
+    }
+    return !r->failed;
+}
+
+/* Creates the profile cache, loading any profiles previously saved to the
+ * file. A missing or unreadable file just results in an empty cache. */
+MVMSpeshProfileCache * MVM_spesh_profile_cache_load(MVMThreadContext *tc, const char *filename) {
+    MVMSpeshProfileCache *cache = MVM_calloc(1, sizeof(MVMSpeshProfileCache));
+    FILE *fh;
+    cache->filename = strdup(filename);
+    uv_mutex_init(&(cache->mutex));
+    MVM_VECTOR_INIT(cache->units, 16);
+    hash_op_set(tc, cache);
+
+    fh = fopen(filename, "rb");
+    if (fh) {
+        char *contents = NULL;
+        size_t size = 0;
+        if (fseek(fh, 0, SEEK_END) == 0) {
+            long end = ftell(fh);
+            if (end > 0 && fseek(fh, 0, SEEK_SET) == 0) {
+                contents = MVM_malloc(end);
+                size = fread(contents, 1, end, fh);
+            }
+        }
+        fclose(fh);
+        if (contents) {
+            CacheReader r;
+            r.pos = contents;
+            r.limit = contents + size;
+            r.failed = 0;
+            if (!parse_cache(tc, cache, &r)) {
+                /* Corrupt, or from another version; start afresh. */
+                MVMuint32 i;
+                for (i = 0; i < cache->units_num; i++)
+                    destroy_unit(tc, cache->units[i]);
+                cache->units_num = 0;
+            }
+            MVM_free(contents);
+        }
+    }
+
+    return cache;
+}
+
+static void write_str(FILE *fh, const char *str) {
+    if (str)
+        fprintf(fh, " %"PRIu64":%s", (MVMuint64)strlen(str), str);
+    else
+        fprintf(fh, " 0:");
+}
+
+/* Saves the profile cache to its file, if it was not saved already. Units
+ * not used for too many runs are left out. The cache is written to a
+ * temporary file and then renamed into place, so concurrently exiting
+ * processes will not corrupt it. */
+void MVM_spesh_profile_cache_save(MVMThreadContext *tc) {
+    MVMSpeshProfileCache *cache = tc->instance->spesh_profile_cache;
+    char *temp_filename;
+    FILE *fh;
+    MVMuint32 i, j, k;
+    if (!cache || MVM_cas(&(cache->saved), 0, 1) != 0)
+        return;
+
+    temp_filename = MVM_malloc(strlen(cache->filename) + 32);
+    sprintf(temp_filename, "%s.%"PRId64, cache->filename, MVM_proc_getpid(tc));
+    fh = fopen(temp_filename, "wb");
+    if (!fh) {
+        MVM_free(temp_filename);
+        return;
+    }
+
+    uv_mutex_lock(&(cache->mutex));
+    fprintf(fh, "MoarVM spesh profile cache %d %s %s\n", CACHE_FORMAT_VERSION,
+        MVM_VERSION, cache->op_set_hash);
+    for (i = 0; i < cache->units_num; i++) {
+        MVMSpeshProfileCacheUnit *unit = cache->units[i];
+        MVMuint32 age = unit->used ? 0 : unit->age + 1;
+        if (unit->entries_num == 0 || age > MVM_SPESH_PROFILE_CACHE_MAX_AGE)
+            continue;
+        fprintf(fh, "unit");
+        write_str(fh, unit->hash);
+        fprintf(fh, " %u %u\n", age, (MVMuint32)unit->entries_num);
+        for (j = 0; j < unit->entries_num; j++) {
+            MVMSpeshProfileCacheEntry *e = &(unit->entries[j]);
+            fprintf(fh, "entry");
+            write_str(fh, e->cuuid);
+            fprintf(fh, " %u %u %u %u %u", e->hits, e->osr_hits, e->max_depth,
+                e->jitted, e->flag_count);
+            for (k = 0; k < e->flag_count; k++)
+                fprintf(fh, " %u", e->arg_flags[k]);
+            fprintf(fh, " %u", e->num_names);
+            for (k = 0; k < e->num_names; k++)
+                write_str(fh, e->arg_names[k]);
+            fprintf(fh, " %d\n", e->types ? 1 : 0);
+            if (e->types) {
+                for (k = 0; k < e->flag_count; k++) {
+                    MVMSpeshProfileCacheType *t = &(e->types[k]);
+                    fprintf(fh, "type");
+                    write_str(fh, t->sc_handle);
+                    fprintf(fh, " %u %u", t->idx, t->concrete);
+                    write_str(fh, t->decont_sc_handle);
+                    fprintf(fh, " %u %u %u\n", t->decont_idx, t->decont_concrete, t->rw_cont);
+                }
+            }
+        }
+    }
+    uv_mutex_unlock(&(cache->mutex));
+
+    if (fclose(fh) == 0) {
+        if (rename(temp_filename, cache->filename) != 0) {
+            /* Some platforms refuse to rename over an existing file. */
+            remove(cache->filename);
+            if (rename(temp_filename, cache->filename) != 0)
+                remove(temp_filename);
+        }
+    }
+    else {
+        remove(temp_filename);
+    }
+    MVM_free(temp_filename);
+}
+
+/* Frees all memory associated with the profile cache. */
+void MVM_spesh_profile_cache_destroy(MVMThreadContext *tc, MVMSpeshProfileCache *cache) {
+    MVMuint32 i;
+    for (i = 0; i < cache->units_num; i++)
+        destroy_unit(tc, cache->units[i]);
+    MVM_VECTOR_DESTROY(cache->units);
+    uv_mutex_destroy(&(cache->mutex));
+    MVM_free(cache->filename);
+    MVM_free(cache);
+}
+
+/* Called the first time a compilation unit is invoked. Hashes its bytecode
+ * and associates it with the matching unit in the cache, creating one if
+ * needed so that specializations of its frames can be recorded. */
+void MVM_spesh_profile_cache_compunit_invoked(MVMThreadContext *tc, MVMCompUnit *cu) {
+    MVMSpeshProfileCache *cache = tc->instance->spesh_profile_cache;
+    MVMSpeshProfileCacheUnit *unit = NULL;
+    SHA1Context context;
+    char hash[80];
+    MVMuint32 i;
+
+    SHA1Init(&context);
+    SHA1Update(&context, cu->body.data_start, cu->body.data_size);
+    SHA1Final(&context, hash);
+
+    uv_mutex_lock(&(cache->mutex));
+    for (i = 0; i < cache->units_num; i++) {
+        if (memcmp(cache->units[i]->hash, hash, 40) == 0) {
+            unit = cache->units[i];
+            break;
+        }
+    }
+    if (!unit) {
+        unit = MVM_calloc(1, sizeof(MVMSpeshProfileCacheUnit));
+        memcpy(unit->hash, hash, 40);
+        unit->hash[40] = '\0';
+        MVM_VECTOR_INIT(unit->entries, 0);
+        MVM_VECTOR_PUSH(cache->units, unit);
+    }
+    unit->used = 1;
+    uv_mutex_unlock(&(cache->mutex));
+
+    cu->body.spesh_profile_unit = unit;
+}
+
+/* Finds the cached entries for a static frame, copying them (shallowly; the
+ * strings are never freed while the cache lives) into a newly allocated
+ * array. Returns the number of entries found. */
+static MVMuint32 entries_for(MVMThreadContext *tc, MVMStaticFrame *sf,
+                             MVMSpeshProfileCacheEntry **result) {
+    MVMSpeshProfileCache *cache = tc->instance->spesh_profile_cache;
+    MVMSpeshProfileCacheUnit *unit = sf->body.cu->body.spesh_profile_unit;
+    char *cuuid;
+    MVMuint32 i, found = 0;
+    *result = NULL;
+    if (!cache || !unit)
+        return 0;
+    cuuid = MVM_string_utf8_encode_C_string(tc, sf->body.cuuid);
+    uv_mutex_lock(&(cache->mutex));
+    for (i = 0; i < unit->entries_num; i++) {
+        if (c_str_equal(unit->entries[i].cuuid, cuuid)) {
+            *result = MVM_realloc(*result, (found + 1) * sizeof(MVMSpeshProfileCacheEntry));
+            (*result)[found++] = unit->entries[i];
+        }
+    }
+    uv_mutex_unlock(&(cache->mutex));
+    MVM_free(cuuid);
+    return found;
+}
+
+/* Waits until the specialization worker has seeded the frame, or until we've
+ * waited long enough, either for this frame or for the run as a whole. The
+ * frame's spesh object is allocated in gen2, so it will not move while we
+ * are blocked. */
+static void wait_for_seed(MVMThreadContext *tc, MVMStaticFrameSpesh *spesh) {
+    MVMInstance *instance = tc->instance;
+    MVMSpeshProfileCache *cache = instance->spesh_profile_cache;
+    MVMuint64 waited = MVM_load(&(cache->waited_ns));
+    MVMuint64 start, deadline;
+    if (waited >= MVM_SPESH_PROFILE_CACHE_WAIT_BUDGET_NS)
+        return;
+    start = uv_hrtime();
+    deadline = start + (MVM_SPESH_PROFILE_CACHE_WAIT_BUDGET_NS - waited < MVM_SPESH_PROFILE_CACHE_MAX_WAIT_NS
+        ? MVM_SPESH_PROFILE_CACHE_WAIT_BUDGET_NS - waited
+        : MVM_SPESH_PROFILE_CACHE_MAX_WAIT_NS);
+    MVM_gc_mark_thread_blocked(tc);
+    uv_mutex_lock(&(instance->mutex_spesh_sync));
+    while (!spesh->body.profile_cache_seeded) {
+        MVMuint64 now = uv_hrtime();
+        if (now >= deadline ||
+                uv_cond_timedwait(&(instance->cond_spesh_sync), &(instance->mutex_spesh_sync),
+                    deadline - now) == UV_ETIMEDOUT)
+            break;
+    }
+    uv_mutex_unlock(&(instance->mutex_spesh_sync));
+    MVM_gc_mark_thread_unblocked(tc);
+    MVM_add(&(cache->waited_ns), uv_hrtime() - start);
+}
+
+/* Called the first time a static frame is invoked. If there are cached
+ * profiles for it, sends it to the specialization worker to seed its
+ * statistics from them. If any of them was JIT compiled last time, and the
+ * worker has nothing else queued to get through first, waits for it, so
+ * this invocation already gets to run the JIT compiled specialization. */
+void MVM_spesh_profile_cache_frame_prepared(MVMThreadContext *tc, MVMStaticFrame *sf) {
+    MVMSpeshProfileCacheEntry *entries;
+    MVMuint32 num_entries = entries_for(tc, sf, &entries);
+    if (num_entries) {
+        MVMStaticFrameSpesh *spesh = sf->body.spesh;
+        MVMint32 jitted = 0;
+        MVMint32 wait;
+        MVMuint32 i;
+        for (i = 0; i < num_entries; i++)
+            if (entries[i].jitted)
+                jitted = 1;
+        MVM_free(entries);
+        wait = jitted && tc->instance->jit_enabled && tc->instance->spesh_thread &&
+            MVM_repr_elems(tc, tc->instance->spesh_queue) == 0;
+        MVM_repr_push_o(tc, tc->instance->spesh_queue, (MVMObject *)sf);
+        if (wait)
+            wait_for_seed(tc, spesh);
+    }
+}
+
+/* Called by the specialization worker when it is done seeding a frame and
+ * producing its specializations. */
+void MVM_spesh_profile_cache_seeded(MVMThreadContext *tc, MVMStaticFrameSpesh *spesh) {
+    MVMInstance *instance = tc->instance;
+    uv_mutex_lock(&(instance->mutex_spesh_sync));
+    spesh->body.profile_cache_seeded = 1;
+    uv_cond_broadcast(&(instance->cond_spesh_sync));
+    uv_mutex_unlock(&(instance->mutex_spesh_sync));
+}
+
+/* Checks if an SC handle matches a C string, without allocating. Handles
+ * are always ASCII. */
+static MVMint32 handle_matches(MVMThreadContext *tc, MVMString *handle, const char *c_handle) {
+    MVMuint32 len = MVM_string_graphs_nocheck(tc, handle);
+    MVMuint32 i;
+    if (strlen(c_handle) != len)
+        return 0;
+    for (i = 0; i < len; i++)
+        if (MVM_string_get_grapheme_at_nocheck(tc, handle, i) != (MVMGrapheme32)(unsigned char)c_handle[i])
+            return 0;
+    return 1;
+}
+
+/* Resolves a cached type to the type object, provided the SC it lives in is
+ * loaded and has deserialized it. Does not allocate. The SC list is grown by
+ * mutator threads as they load SCs, so we scan it holding the SC registry
+ * lock. */
+static MVMObject * resolve_type(MVMThreadContext *tc, const char *c_handle, MVMuint32 idx) {
+    MVMObject *result = NULL;
+    MVMuint32 i;
+    uv_mutex_lock(&tc->instance->mutex_sc_registry);
+    for (i = 1; i < tc->instance->all_scs_next_idx; i++) {
+        MVMSerializationContextBody *scb = tc->instance->all_scs[i];
+        if (scb && scb->sc && scb->handle && handle_matches(tc, scb->handle, c_handle)) {
+            result = MVM_sc_try_get_object(tc, scb->sc, idx);
+            break;
+        }
+    }
+    uv_mutex_unlock(&tc->instance->mutex_sc_registry);
+    return result;
+}
+
+/* Resolves a cached type tuple. Returns NULL if any type can't be resolved
+ * yet. Does not allocate on the GC heap. */
+static MVMSpeshStatsType * resolve_type_tuple(MVMThreadContext *tc, MVMSpeshProfileCacheEntry *e) {
+    MVMSpeshStatsType *result = MVM_calloc(e->flag_count, sizeof(MVMSpeshStatsType));
+    MVMuint32 i;
+    for (i = 0; i < e->flag_count; i++) {
+        MVMSpeshProfileCacheType *t = &(e->types[i]);
+        if (t->sc_handle) {
+            result[i].type = resolve_type(tc, t->sc_handle, t->idx);
+            if (!result[i].type)
+                goto unresolved;
+            result[i].type_concrete = t->concrete;
+            result[i].rw_cont = t->rw_cont;
+        }
+        if (t->decont_sc_handle) {
+            result[i].decont_type = resolve_type(tc, t->decont_sc_handle, t->decont_idx);
+            if (!result[i].decont_type)
+                goto unresolved;
+            result[i].decont_type_concrete = t->decont_concrete;
+        }
+    }
+    return result;
+  unresolved:
+    MVM_free(result);
+    return NULL;
+}
+
+/* Finds the interned callsite matching a cached entry. We only look for one
+ * that is already interned; if it isn't, nothing could have made a call with
+ * it yet. */
+static MVMCallsite * find_interned_callsite(MVMThreadContext *tc, MVMSpeshProfileCacheEntry *e) {
+    MVMCallsiteInterns *interns = tc->instance->callsite_interns;
+    MVMCallsite *result = NULL;
+    MVMint32 i;
+    if (e->flag_count >= MVM_INTERN_ARITY_LIMIT)
+        return NULL;
+    uv_mutex_lock(&tc->instance->mutex_callsite_interns);
+    for (i = 0; i < interns->num_by_arity[e->flag_count] && !result; i++) {
+        MVMCallsite *cs = interns->by_arity[e->flag_count][i];
+        MVMuint32 j;
+        if (e->flag_count && memcmp(cs->arg_flags, e->arg_flags, e->flag_count) != 0)
+            continue;
+        if (MVM_callsite_num_nameds(tc, cs) != e->num_names)
+            continue;
+        for (j = 0; j < e->num_names; j++) {
+            char *name = MVM_string_utf8_encode_C_string(tc, cs->arg_names[j]);
+            MVMint32 matches = c_str_equal(name, e->arg_names[j]);
+            MVM_free(name);
+            if (!matches)
+                break;
+        }
+        if (j == e->num_names)
+            result = cs;
+    }
+    uv_mutex_unlock(&tc->instance->mutex_callsite_interns);
+    return result;
+}
+
+/* Seeds the statistics of a static frame from its cached profiles, on the
+ * specialization worker. Those with types go first, so that the hits of
+ * certain specializations can be set to cover them. */
+void MVM_spesh_profile_cache_seed(MVMThreadContext *tc, MVMStaticFrame *sf, MVMObject *sf_updated) {
+    MVMSpeshProfileCacheEntry *entries;
+    MVMuint32 num_entries = entries_for(tc, sf, &entries);
+    MVMuint32 pass, i;
+    MVMROOT2(tc, sf, sf_updated, {
+        for (pass = 0; pass < 2; pass++) {
+            for (i = 0; i < num_entries; i++) {
+                MVMSpeshProfileCacheEntry *e = &(entries[i]);
+                MVMSpeshStatsType *arg_types = NULL;
+                MVMCallsite *cs;
+                if ((pass == 0) != (e->types != NULL))
+                    continue;
+                cs = find_interned_callsite(tc, e);
+                if (!cs)
+                    continue;
+                if (e->types) {
+                    arg_types = resolve_type_tuple(tc, e);
+                    if (!arg_types)
+                        continue;
+                }
+                MVM_spesh_stats_seed(tc, sf, cs, arg_types, e->hits, e->osr_hits,
+                    e->max_depth, sf_updated);
+            }
+        }
+    });
+    MVM_free(entries);
+}
+
+/* Identifies a type by its SC and index in it. Returns zero if it is not in
+ * an SC, in which case we can't cache it. */
+static MVMint32 identify_type(MVMThreadContext *tc, MVMObject *type, char **handle,
+                              MVMuint32 *idx) {
+    MVMSerializationContext *sc = MVM_sc_get_obj_sc(tc, type);
+    if (!sc)
+        return 0;
+    *idx = MVM_sc_get_idx_in_sc(&(type->header));
+    if (*idx == (MVMuint32)~0)
+        return 0;
+    *handle = MVM_string_utf8_encode_C_string(tc, MVM_sc_get_handle(tc, sc));
+    return 1;
+}
+
+/* Records a specialization that was produced in the cache, on the
+ * specialization worker, along with whether it was JIT compiled. If it is
+ * already there, the counts are updated. */
+void MVM_spesh_profile_cache_record(MVMThreadContext *tc, MVMSpeshPlanned *p, MVMint32 jitted) {
+    MVMSpeshProfileCache *cache = tc->instance->spesh_profile_cache;
+    MVMSpeshProfileCacheUnit *unit = p->sf->body.cu->body.spesh_profile_unit;
+    MVMCallsite *cs = p->cs_stats->cs;
+    MVMSpeshProfileCacheEntry e;
+    MVMuint32 i;
+    if (!cache || !unit || !cs || cs->flag_count >= MVM_INTERN_ARITY_LIMIT)
+        return;
+
+    /* Form the entry. */
+    memset(&e, 0, sizeof(MVMSpeshProfileCacheEntry));
+    e.cuuid = MVM_string_utf8_encode_C_string(tc, p->sf->body.cuuid);
+    e.flag_count = cs->flag_count;
+    if (e.flag_count) {
+        e.arg_flags = MVM_malloc(e.flag_count);
+        memcpy(e.arg_flags, cs->arg_flags, e.flag_count);
+    }
+    e.num_names = MVM_callsite_num_nameds(tc, cs);
+    if (e.num_names) {
+        e.arg_names = MVM_calloc(e.num_names, sizeof(char *));
+        for (i = 0; i < e.num_names; i++)
+            e.arg_names[i] = MVM_string_utf8_encode_C_string(tc, cs->arg_names[i]);
+    }
+    if (p->type_tuple) {
+        e.types = MVM_calloc(e.flag_count, sizeof(MVMSpeshProfileCacheType));
+        for (i = 0; i < e.flag_count; i++) {
+            MVMSpeshStatsType *stt = &(p->type_tuple[i]);
+            MVMSpeshProfileCacheType *t = &(e.types[i]);
+            if (stt->type) {
+                if (!identify_type(tc, stt->type, &(t->sc_handle), &(t->idx))) {
+                    destroy_entry(tc, &e);
+                    return;
+                }
+                t->concrete = stt->type_concrete;
+                t->rw_cont = stt->rw_cont;
+            }
+            if (stt->decont_type) {
+                if (!identify_type(tc, stt->decont_type, &(t->decont_sc_handle), &(t->decont_idx))) {
+                    destroy_entry(tc, &e);
+                    return;
+                }
+                t->decont_concrete = stt->decont_type_concrete;
+            }
+        }
+    }
+    if (p->num_type_stats) {
+        for (i = 0; i < p->num_type_stats; i++) {
+            e.hits += p->type_stats[i]->hits;
+            e.osr_hits += p->type_stats[i]->osr_hits;
+        }
+    }
+    else {
+        e.hits = p->cs_stats->hits;
+        e.osr_hits = p->cs_stats->osr_hits;
+    }
+    e.max_depth = p->max_depth;
+    e.jitted = jitted ? 1 : 0;
+
+    /* Add it, or update the existing entry. */
+    uv_mutex_lock(&(cache->mutex));
+    for (i = 0; i < unit->entries_num; i++) {
+        MVMSpeshProfileCacheEntry *existing = &(unit->entries[i]);
+        if (same_profile(existing, &e)) {
+            if (e.hits > existing->hits)
+                existing->hits = e.hits;
+            if (e.osr_hits > existing->osr_hits)
+                existing->osr_hits = e.osr_hits;
+            if (e.max_depth > existing->max_depth)
+                existing->max_depth = e.max_depth;
+            existing->jitted = e.jitted;
+            break;
+        }
+    }
+    if (i == unit->entries_num)
+        MVM_VECTOR_PUSH(unit->entries, e);
+    else
+        destroy_entry(tc, &e);
+    uv_mutex_unlock(&(cache->mutex));
+}
@@ -0,0 +1,101 @@
+/* The specialization profile cache is an opt-in, on-disk record of the
+ * specializations produced during a run (callsite, argument types, and how
+ * hot they were), keyed by a hash of the compilation unit bytecode. On the
+ * next run, the first invocation of a frame that has a cached profile seeds
+ * its statistics, so it can be specialized right away without waiting for
+ * enough logs to arrive. Specializations that were JIT compiled are waited
+ * for, so that the first call already runs JIT compiled code. */
+
+/* The number of runs a unit in the cache may go unused before it is thrown
+ * out (for example, because the bytecode changed). */
+#define MVM_SPESH_PROFILE_CACHE_MAX_AGE 10
+
+/* The longest the first invocation of a frame waits for the worker to
+ * produce its JIT compiled specializations, in nanoseconds. */
+#define MVM_SPESH_PROFILE_CACHE_MAX_WAIT_NS 100000000
+
+/* The longest all invocations together wait for the worker over the whole
+ * run, in nanoseconds; once it is spent, frames no longer wait. */
+#define MVM_SPESH_PROFILE_CACHE_WAIT_BUDGET_NS 1000000000
+
+/* A type in a cached type tuple. Types are identified by the handle of the
+ * serialization context they live in and their index in it; a NULL handle
+ * means there is no type (a non-object argument, or no decont type). */
+struct MVMSpeshProfileCacheType {
+    char      *sc_handle;
+    MVMuint32  idx;
+    MVMuint8   concrete;
+    char      *decont_sc_handle;
+    MVMuint32  decont_idx;
+    MVMuint8   decont_concrete;
+    MVMuint8   rw_cont;
+};
+
+/* A cached profile of a specialization that was produced. */
+struct MVMSpeshProfileCacheEntry {
+    /* The compilation unit unique ID of the static frame. */
+    char *cuuid;
+
+    /* The shape of the callsite: its flags and the names of any nameds. */
+    MVMCallsiteEntry *arg_flags;
+    char **arg_names;
+    MVMuint16 flag_count;
+    MVMuint16 num_names;
+
+    /* The argument types, one per callsite flag, or NULL if this was a
+     * certain specialization. */
+    MVMSpeshProfileCacheType *types;
+
+    /* Hits, OSR hits, and the maximum stack depth they were seen at. */
+    MVMuint32 hits;
+    MVMuint32 osr_hits;
+    MVMuint32 max_depth;
+
+    /* Whether the specialization was JIT compiled. */
+    MVMuint32 jitted;
+};
+
+/* Cached profiles for a compilation unit, identified by the SHA-1 of its
+ * bytecode. */
+struct MVMSpeshProfileCacheUnit {
+    char hash[41];
+
+    /* How many runs ago the unit was last used, and whether it was used in
+     * this run. */
+    MVMuint32 age;
+    MVMuint32 used;
+
+    MVM_VECTOR_DECL(MVMSpeshProfileCacheEntry, entries);
+};
+
+/* The profile cache, hung off the instance. */
+struct MVMSpeshProfileCache {
+    /* The file we load from and save to. */
+    char *filename;
+
+    /* SHA-1 of the op set of this build; the file is only used if it was
+     * written by the same version with the same ops. */
+    char op_set_hash[41];
+
+    /* Lock protecting the units and their entries, which are looked at by
+     * mutator threads and added to by the specialization workers. */
+    uv_mutex_t mutex;
+
+    MVM_VECTOR_DECL(MVMSpeshProfileCacheUnit *, units);
+
+    /* The total time spent waiting for the worker to seed frames, in
+     * nanoseconds. */
+    AO_t waited_ns;
+
+    /* Set once the cache has been saved, so it is only saved once. */
+    AO_t saved;
+};
+
+MVMSpeshProfileCache * MVM_spesh_profile_cache_load(MVMThreadContext *tc, const char *filename);
+void MVM_spesh_profile_cache_save(MVMThreadContext *tc);
+void MVM_spesh_profile_cache_destroy(MVMThreadContext *tc, MVMSpeshProfileCache *cache);
+void MVM_spesh_profile_cache_compunit_invoked(MVMThreadContext *tc, MVMCompUnit *cu);
+void MVM_spesh_profile_cache_frame_prepared(MVMThreadContext *tc, MVMStaticFrame *sf);
+void MVM_spesh_profile_cache_seed(MVMThreadContext *tc, MVMStaticFrame *sf, MVMObject *sf_updated);
+void MVM_spesh_profile_cache_seeded(MVMThreadContext *tc, MVMStaticFrameSpesh *spesh);
+void MVM_spesh_profile_cache_record(MVMThreadContext *tc, MVMSpeshPlanned *p, MVMint32 jitted);
@@ -0,0 +1,463 @@
+#include "moar.h"
+
+/* Bounds check elimination for native arrays. An atpos_i/atpos_n/bindpos_i/
+ * bindpos_n on a VMArray has to check the index against the number of
+ * elements, handle negative indexes, and (for binds) be ready to grow the
+ * array. In loops of the form:
+ *
+ *     my int $i = 0;
+ *     while $i < nqp::elems(@a) { ... nqp::atpos_i(@a, $i) ...; $i++ }
+ *
+ * we can often show that none of this is needed: the index is not negative,
+ * and the access only happens along a branch where it was compared to be
+ * less than the element count of the same array, with nothing in between
+ * that might have shrunk it. Such accesses are turned into sp_atpos_* and
+ * sp_bindpos_* ops, which index straight into the slots.
+ *
+ * An index is known to be non-negative if it is a non-negative constant or
+ * an element count, or if it is a loop induction variable (a PHI) whose
+ * initial values are such things and that is only ever stepped up by small
+ * constant amounts. We assume such an induction variable will not be stepped
+ * enough times to overflow.
+ */
+
+/* The largest step we accept for an induction variable, and how deep we go
+ * looking through PHIs. */
+#define MAX_INDUCTION_STEP 64
+#define MAX_PHI_DEPTH      8
+
+/* State for the pass over the whole graph. */
+typedef struct {
+    /* Immediate dominator of each basic block, and scratch marks used when
+     * looking for paths between an element count and an access, all indexed
+     * by basic block index. */
+    MVMSpeshBB **idom;
+    MVMuint8 *fwd;
+    MVMuint8 *bwd;
+    MVMint32 num_bbs;
+
+    /* PHIs that we are currently trying to prove non-negative, and so may
+     * assume to be when they are reached again through a back edge. */
+    MVMSpeshIns *assumed[MAX_PHI_DEPTH];
+    MVMuint32 num_assumed;
+
+    MVM_VECTOR_DECL(MVMSpeshBB *, worklist);
+} RangeState;
+
+/* Record the immediate dominators by walking the dominator tree. */
+static void record_idoms(RangeState *rs, MVMSpeshBB *bb) {
+    MVMuint16 i;
+    for (i = 0; i < bb->num_children; i++) {
+        rs->idom[bb->children[i]->idx] = bb;
+        record_idoms(rs, bb->children[i]);
+    }
+}
+
+/* Looks through `set` instructions to find where a value came from. */
+static MVMSpeshOperand canonical(MVMThreadContext *tc, MVMSpeshGraph *g, MVMSpeshOperand o) {
+    MVMSpeshIns *writer = MVM_spesh_get_facts(tc, g, o)->writer;
+    while (writer && writer->info->opcode == MVM_OP_set) {
+        o = writer->operands[1];
+        writer = MVM_spesh_get_facts(tc, g, o)->writer;
+    }
+    return o;
+}
+static MVMuint32 same_value(MVMThreadContext *tc, MVMSpeshGraph *g, MVMSpeshOperand a,
+        MVMSpeshOperand b) {
+    a = canonical(tc, g, a);
+    b = canonical(tc, g, b);
+    return a.reg.orig == b.reg.orig && a.reg.i == b.reg.i;
+}
+
+/* Checks if an object register is known to hold a concrete VMArray; if a
+ * slot type is given, the array must also have that slot type. */
+static MVMuint32 is_known_vmarray(MVMThreadContext *tc, MVMSpeshGraph *g,
+        MVMSpeshOperand o, MVMint32 slot_type) {
+    MVMSpeshFacts *facts = MVM_spesh_get_facts(tc, g, o);
+    MVMSTable *st;
+    if ((facts->flags & (MVM_SPESH_FACT_KNOWN_TYPE | MVM_SPESH_FACT_CONCRETE)) !=
+            (MVM_SPESH_FACT_KNOWN_TYPE | MVM_SPESH_FACT_CONCRETE) || !facts->type)
+        return 0;
+    st = STABLE(facts->type);
+    if (st->REPR->ID != MVM_REPR_ID_VMArray || !st->REPR_data)
+        return 0;
+    return slot_type < 0 ||
+        ((MVMArrayREPRData *)st->REPR_data)->slot_type == slot_type;
+}
+
+/* Checks if an integer register is known to never be negative. */
+static MVMuint32 non_negative(MVMThreadContext *tc, MVMSpeshGraph *g, RangeState *rs,
+        MVMSpeshOperand o);
+static MVMuint32 small_step(MVMThreadContext *tc, MVMSpeshGraph *g, MVMSpeshOperand o) {
+    MVMSpeshFacts *facts = MVM_spesh_get_facts(tc, g, o);
+    return (facts->flags & MVM_SPESH_FACT_KNOWN_VALUE) &&
+        facts->value.i >= 0 && facts->value.i <= MAX_INDUCTION_STEP;
+}
+static MVMuint32 induction_step(MVMThreadContext *tc, MVMSpeshGraph *g, RangeState *rs,
+        MVMSpeshOperand o) {
+    MVMSpeshIns *writer = MVM_spesh_get_facts(tc, g, canonical(tc, g, o))->writer;
+    MVMuint32 i;
+    if (!writer || writer->info->opcode != MVM_OP_add_i)
+        return 0;
+    for (i = 0; i < rs->num_assumed; i++) {
+        MVMSpeshOperand phi = rs->assumed[i]->operands[0];
+        if (same_value(tc, g, writer->operands[1], phi) && small_step(tc, g, writer->operands[2]))
+            return 1;
+        if (same_value(tc, g, writer->operands[2], phi) && small_step(tc, g, writer->operands[1]))
+            return 1;
+    }
+    return 0;
+}
+static MVMuint32 non_negative(MVMThreadContext *tc, MVMSpeshGraph *g, RangeState *rs,
+        MVMSpeshOperand o) {
+    MVMSpeshFacts *facts;
+    MVMSpeshIns *writer;
+    MVMuint32 i, result;
+
+    o = canonical(tc, g, o);
+    facts = MVM_spesh_get_facts(tc, g, o);
+    if (facts->flags & MVM_SPESH_FACT_NON_NEGATIVE)
+        return 1;
+    if (facts->flags & MVM_SPESH_FACT_KNOWN_VALUE)
+        return facts->value.i >= 0;
+    writer = facts->writer;
+    if (!writer || writer->info->opcode != MVM_SSA_PHI)
+        return 0;
+
+    /* A PHI we're already working on is assumed to be non-negative. */
+    for (i = 0; i < rs->num_assumed; i++)
+        if (rs->assumed[i] == writer)
+            return 1;
+    if (rs->num_assumed == MAX_PHI_DEPTH)
+        return 0;
+
+    /* Otherwise, every incoming value must be non-negative, or be a small
+     * step up from a PHI we're proving non-negative. */
+    rs->assumed[rs->num_assumed++] = writer;
+    result = 1;
+    for (i = 1; i < writer->info->num_operands; i++) {
+        if (!induction_step(tc, g, rs, writer->operands[i]) &&
+                !non_negative(tc, g, rs, writer->operands[i])) {
+            result = 0;
+            break;
+        }
+    }
+    rs->num_assumed--;
+
+    /* Only cache the result if it didn't depend on an outer assumption. */
+    if (result && rs->num_assumed == 0)
+        facts->flags |= MVM_SPESH_FACT_NON_NEGATIVE;
+    return result;
+}
+
+/* Checks if the instruction reads the number of elements in an array, and if
+ * so gives the array register. */
+static MVMuint32 is_elems_read(MVMThreadContext *tc, MVMSpeshGraph *g, MVMSpeshIns *ins,
+        MVMSpeshOperand *array) {
+    switch (ins->info->opcode) {
+        case MVM_OP_elems:
+            break;
+        case MVM_OP_sp_get_i64:
+            if (ins->operands[2].lit_i16 != offsetof(MVMArray, body.elems))
+                return 0;
+            break;
+        default:
+            return 0;
+    }
+    if (!is_known_vmarray(tc, g, ins->operands[1], -1))
+        return 0;
+    *array = ins->operands[1];
+    return 1;
+}
+
+/* Checks if an instruction may cause an array to have fewer elements. We are
+ * conservative: anything that might run arbitrary code or write to memory
+ * counts, apart from a few array operations we know cannot shrink it. */
+static MVMuint32 may_shrink(MVMThreadContext *tc, MVMSpeshGraph *g, MVMSpeshIns *ins) {
+    switch (ins->info->opcode) {
+        case MVM_SSA_PHI:
+        case MVM_OP_set:
+        case MVM_OP_goto:
+        case MVM_OP_if_i:
+        case MVM_OP_unless_i:
+        case MVM_OP_if_n:
+        case MVM_OP_unless_n:
+        case MVM_OP_sp_guard:
+        case MVM_OP_sp_guardconc:
+        case MVM_OP_sp_guardtype:
+        case MVM_OP_sp_guardobj:
+        case MVM_OP_sp_guardnotobj:
+        case MVM_OP_sp_guardjustconc:
+        case MVM_OP_sp_guardjusttype:
+        case MVM_OP_sp_atpos_i64:
+        case MVM_OP_sp_atpos_n:
+        case MVM_OP_sp_bindpos_i64:
+        case MVM_OP_sp_bindpos_n:
+            return 0;
+        case MVM_OP_atpos_i:
+        case MVM_OP_atpos_n:
+            return !is_known_vmarray(tc, g, ins->operands[1], -1);
+        case MVM_OP_bindpos_i:
+        case MVM_OP_bindpos_n:
+        case MVM_OP_push_i:
+        case MVM_OP_push_n:
+            return !is_known_vmarray(tc, g, ins->operands[0], -1);
+        default:
+            return !ins->info->pure || (ins->info->jittivity & MVM_JIT_INFO_INVOKISH);
+    }
+}
+static MVMuint32 range_may_shrink(MVMThreadContext *tc, MVMSpeshGraph *g,
+        MVMSpeshIns *from, MVMSpeshIns *to) {
+    while (from && from != to) {
+        if (may_shrink(tc, g, from))
+            return 1;
+        from = from->next;
+    }
+    return 0;
+}
+
+/* Checks that nothing on any path from the element count being read by
+ * elems_ins in elems_bb to the access in access_bb may shrink the array. */
+static MVMuint32 unchanged_between(MVMThreadContext *tc, MVMSpeshGraph *g, RangeState *rs,
+        MVMSpeshBB *elems_bb, MVMSpeshIns *elems_ins, MVMSpeshBB *access_bb,
+        MVMSpeshIns *access_ins) {
+    MVMSpeshBB *bb;
+    MVMuint32 changed;
+    MVMuint16 i;
+
+    /* If they're in the same block with the read first, then any path from
+     * the read to the access is just the instructions between them. */
+    if (elems_bb == access_bb) {
+        MVMSpeshIns *ins = elems_ins->next;
+        while (ins && ins != access_ins)
+            ins = ins->next;
+        if (ins)
+            return !range_may_shrink(tc, g, elems_ins->next, access_ins);
+    }
+
+    /* Otherwise, find the blocks that are reachable from the read without
+     * running it again... */
+    memset(rs->fwd, 0, rs->num_bbs);
+    MVM_VECTOR_CLEAR(rs->worklist);
+    MVM_VECTOR_PUSH(rs->worklist, elems_bb);
+    while (MVM_VECTOR_ELEMS(rs->worklist)) {
+        bb = MVM_VECTOR_POP(rs->worklist);
+        for (i = 0; i < bb->num_succ + bb->num_handler_succ; i++) {
+            MVMSpeshBB *succ = i < bb->num_succ
+                ? bb->succ[i]
+                : bb->handler_succ[i - bb->num_succ];
+            if (succ != elems_bb && !rs->fwd[succ->idx]) {
+                rs->fwd[succ->idx] = 1;
+                MVM_VECTOR_PUSH(rs->worklist, succ);
+            }
+        }
+    }
+
+    /* ...and those from which the access can be reached without running the
+     * read again. */
+    memset(rs->bwd, 0, rs->num_bbs);
+    do {
+        changed = 0;
+        bb = g->entry;
+        while (bb) {
+            if (!rs->bwd[bb->idx] && bb != elems_bb) {
+                for (i = 0; i < bb->num_succ + bb->num_handler_succ; i++) {
+                    MVMSpeshBB *succ = i < bb->num_succ
+                        ? bb->succ[i]
+                        : bb->handler_succ[i - bb->num_succ];
+                    if (succ == access_bb || rs->bwd[succ->idx]) {
+                        rs->bwd[bb->idx] = 1;
+                        changed = 1;
+                        break;
+                    }
+                }
+            }
+            bb = bb->linear_next;
+        }
+    } while (changed);
+
+    /* Check the rest of the block with the read, all of the blocks that are
+     * in both sets, and the start of the block with the access (or all of it,
+     * if it is possible to go around it again). */
+    if (range_may_shrink(tc, g, elems_ins->next, NULL))
+        return 0;
+    bb = g->entry;
+    while (bb) {
+        if (bb != elems_bb && bb != access_bb && rs->fwd[bb->idx] && rs->bwd[bb->idx])
+            if (range_may_shrink(tc, g, bb->first_ins, NULL))
+                return 0;
+        bb = bb->linear_next;
+    }
+    if (access_bb != elems_bb && rs->fwd[access_bb->idx] && rs->bwd[access_bb->idx])
+        return !range_may_shrink(tc, g, access_bb->first_ins, NULL);
+    return !range_may_shrink(tc, g, access_bb->first_ins, access_ins);
+}
+
+/* Finds the block an instruction is in, given that it dominates a block. */
+static MVMSpeshBB * find_dominating_bb(RangeState *rs, MVMSpeshBB *bb, MVMSpeshIns *target) {
+    while (bb) {
+        MVMSpeshIns *ins = bb->first_ins;
+        while (ins) {
+            if (ins == target)
+                return bb;
+            ins = ins->next;
+        }
+        bb = rs->idom[bb->idx];
+    }
+    return NULL;
+}
+
+/* Given the result of a comparison and whether it is known to be true or
+ * false, sees if it establishes that idx is less than the number of elements
+ * of the array, and if so returns the instruction reading that. */
+static MVMSpeshIns * compared_below_elems(MVMThreadContext *tc, MVMSpeshGraph *g,
+        MVMSpeshOperand cond, MVMuint32 truth, MVMSpeshOperand array, MVMSpeshOperand idx) {
+    MVMSpeshIns *cmp = MVM_spesh_get_facts(tc, g, canonical(tc, g, cond))->writer;
+    MVMSpeshOperand lesser, greater;
+    MVMSpeshIns *n_writer;
+    MVMSpeshOperand n_array;
+    if (!cmp)
+        return NULL;
+    switch (cmp->info->opcode) {
+        case MVM_OP_lt_i:
+            if (!truth) return NULL;
+            lesser = cmp->operands[1]; greater = cmp->operands[2];
+            break;
+        case MVM_OP_gt_i:
+            if (!truth) return NULL;
+            lesser = cmp->operands[2]; greater = cmp->operands[1];
+            break;
+        case MVM_OP_ge_i:
+            if (truth) return NULL;
+            lesser = cmp->operands[1]; greater = cmp->operands[2];
+            break;
+        case MVM_OP_le_i:
+            if (truth) return NULL;
+            lesser = cmp->operands[2]; greater = cmp->operands[1];
+            break;
+        default:
+            return NULL;
+    }
+    if (!same_value(tc, g, lesser, idx))
+        return NULL;
+    n_writer = MVM_spesh_get_facts(tc, g, canonical(tc, g, greater))->writer;
+    if (!n_writer || !is_elems_read(tc, g, n_writer, &n_array))
+        return NULL;
+    return same_value(tc, g, n_array, array) ? n_writer : NULL;
+}
+
+/* Checks if the access in bb is only reached when idx is in bounds. */
+static MVMuint32 in_bounds(MVMThreadContext *tc, MVMSpeshGraph *g, RangeState *rs,
+        MVMSpeshBB *bb, MVMSpeshIns *access, MVMSpeshOperand array, MVMSpeshOperand idx) {
+    MVMSpeshBB *cur;
+    if (!non_negative(tc, g, rs, idx))
+        return 0;
+
+    /* Look for a dominating block that is only entered through a conditional
+     * branch on a comparison of the index with the number of elements. */
+    for (cur = bb; cur; cur = rs->idom[cur->idx]) {
+        MVMSpeshBB *pred;
+        MVMSpeshIns *branch, *elems_ins;
+        MVMSpeshBB *elems_bb;
+        MVMuint32 taken, truth;
+        if (cur->num_pred != 1)
+            continue;
+        pred = cur->pred[0];
+        branch = pred->last_ins;
+        if (!branch)
+            continue;
+        switch (branch->info->opcode) {
+            case MVM_OP_if_i:
+            case MVM_OP_unless_i:
+                break;
+            default:
+                continue;
+        }
+        if (branch->operands[1].ins_bb == pred->linear_next)
+            continue;
+        taken = branch->operands[1].ins_bb == cur;
+        truth = branch->info->opcode == MVM_OP_if_i ? taken : !taken;
+        elems_ins = compared_below_elems(tc, g, branch->operands[0], truth, array, idx);
+        if (!elems_ins)
+            continue;
+        elems_bb = find_dominating_bb(rs, pred, elems_ins);
+        if (elems_bb && unchanged_between(tc, g, rs, elems_bb, elems_ins, bb, access))
+            return 1;
+    }
+    return 0;
+}
+
+/* Turns an access into the unchecked form, if it's safe. */
+static void try_eliminate(MVMThreadContext *tc, MVMSpeshGraph *g, RangeState *rs,
+        MVMSpeshBB *bb, MVMSpeshIns *ins) {
+    MVMSpeshOperand array, idx;
+    MVMint32 slot_type;
+    MVMuint16 new_op;
+    switch (ins->info->opcode) {
+        case MVM_OP_atpos_i:
+            array = ins->operands[1]; idx = ins->operands[2];
+            slot_type = MVM_ARRAY_I64; new_op = MVM_OP_sp_atpos_i64;
+            break;
+        case MVM_OP_atpos_n:
+            array = ins->operands[1]; idx = ins->operands[2];
+            slot_type = MVM_ARRAY_N64; new_op = MVM_OP_sp_atpos_n;
+            break;
+        case MVM_OP_bindpos_i:
+            array = ins->operands[0]; idx = ins->operands[1];
+            slot_type = MVM_ARRAY_I64; new_op = MVM_OP_sp_bindpos_i64;
+            break;
+        case MVM_OP_bindpos_n:
+            array = ins->operands[0]; idx = ins->operands[1];
+            slot_type = MVM_ARRAY_N64; new_op = MVM_OP_sp_bindpos_n;
+            break;
+        default:
+            return;
+    }
+    if (!is_known_vmarray(tc, g, array, slot_type))
+        return;
+    if (!in_bounds(tc, g, rs, bb, ins, array, idx))
+        return;
+    if (MVM_spesh_debug_enabled(tc))
+        MVM_spesh_debug_printf(tc, "BCE: eliminated bounds check on %s in BB %d\n",
+            ins->info->name, bb->idx);
+    MVM_spesh_use_facts(tc, g, MVM_spesh_get_facts(tc, g, array));
+    MVM_spesh_graph_add_comment(tc, g, ins, "bounds check eliminated from %s",
+        ins->info->name);
+    ins->info = MVM_op_get_op(new_op);
+}
+
+/* Eliminates bounds checks on native array accesses where we can show the
+ * index is in range. Must be run with the dominator tree up to date. */
+void MVM_spesh_range_bce(MVMThreadContext *tc, MVMSpeshGraph *g) {
+    RangeState rs;
+    MVMSpeshBB *bb;
+
+    rs.num_bbs = 0;
+    bb = g->entry;
+    while (bb) {
+        if (bb->idx >= rs.num_bbs)
+            rs.num_bbs = bb->idx + 1;
+        bb = bb->linear_next;
+    }
+    rs.idom = MVM_calloc(rs.num_bbs, sizeof(MVMSpeshBB *));
+    rs.fwd = MVM_malloc(rs.num_bbs);
+    rs.bwd = MVM_malloc(rs.num_bbs);
+    rs.num_assumed = 0;
+    MVM_VECTOR_INIT(rs.worklist, 8);
+    record_idoms(&rs, g->entry);
+
+    bb = g->entry;
+    while (bb) {
+        MVMSpeshIns *ins = bb->first_ins;
+        while (ins) {
+            try_eliminate(tc, g, &rs, bb, ins);
+            ins = ins->next;
+        }
+        bb = bb->linear_next;
+    }
+
+    MVM_VECTOR_DESTROY(rs.worklist);
+    MVM_free(rs.bwd);
+    MVM_free(rs.fwd);
+    MVM_free(rs.idom);
+}
@@ -0,0 +1 @@
+void MVM_spesh_range_bce(MVMThreadContext *tc, MVMSpeshGraph *g);
@@ -650,6 +650,73 @@ void MVM_spesh_stats_update(MVMThreadContext *tc, MVMSpeshLog *sl, MVMObject *sf
 #endif
 }
 
+/* Seeds the statistics of a static frame with a specialization profile from
+ * the profile cache, as if the logs for it had been seen already. The hits
+ * are raised to the profiled ones rather than added, so that seeding twice
+ * has no more effect than seeding once. Takes ownership of arg_types, which
+ * may be NULL to seed only at callsite level. */
+void MVM_spesh_stats_seed(MVMThreadContext *tc, MVMStaticFrame *sf, MVMCallsite *cs,
+                          MVMSpeshStatsType *arg_types, MVMuint32 hits,
+                          MVMuint32 osr_hits, MVMuint32 max_depth,
+                          MVMObject *sf_updated) {
+    MVMSpeshStats *ss = stats_for(tc, sf);
+    MVMuint32 callsite_idx = by_callsite_idx(tc, ss, cs);
+    MVMSpeshStatsByCallsite *css = &(ss->by_callsite[callsite_idx]);
+    MVMuint32 total_hits = 0;
+    MVMuint32 total_osr_hits = 0;
+    MVMuint32 i;
+
+    if (arg_types) {
+        MVMint32 type_idx;
+        for (i = 0; i < cs->flag_count; i++) {
+            if (arg_types[i].type)
+                MVM_gc_write_barrier(tc, &(sf->body.spesh->common.header),
+                    &(arg_types[i].type->header));
+            if (arg_types[i].decont_type)
+                MVM_gc_write_barrier(tc, &(sf->body.spesh->common.header),
+                    &(arg_types[i].decont_type->header));
+        }
+        type_idx = by_type(tc, ss, callsite_idx, arg_types);
+        if (type_idx >= 0) {
+            MVMSpeshStatsByType *tss = &(css->by_type[type_idx]);
+            if (hits > tss->hits) {
+                css->hits += hits - tss->hits;
+                tss->hits = hits;
+            }
+            if (osr_hits > tss->osr_hits) {
+                css->osr_hits += osr_hits - tss->osr_hits;
+                tss->osr_hits = osr_hits;
+            }
+            if (max_depth > tss->max_depth)
+                tss->max_depth = max_depth;
+        }
+    }
+    else {
+        if (hits > css->hits)
+            css->hits = hits;
+        if (osr_hits > css->osr_hits)
+            css->osr_hits = osr_hits;
+    }
+    if (max_depth > css->max_depth)
+        css->max_depth = max_depth;
+
+    /* Keep the frame totals covering the callsites. */
+    for (i = 0; i < ss->num_by_callsite; i++) {
+        total_hits += ss->by_callsite[i].hits;
+        total_osr_hits += ss->by_callsite[i].osr_hits;
+    }
+    if (total_hits > ss->hits)
+        ss->hits = total_hits;
+    if (total_osr_hits > ss->osr_hits)
+        ss->osr_hits = total_osr_hits;
+
+    /* Done last, as it may allocate. */
+    if (ss->last_update != tc->instance->spesh_stats_version) {
+        ss->last_update = tc->instance->spesh_stats_version;
+        MVM_repr_push_o(tc, sf_updated, (MVMObject *)sf);
+    }
+}
+
 /* Takes an array of frames we recently updated the stats in. If they weren't
  * updated in a while, clears them out. */
 void MVM_spesh_stats_cleanup(MVMThreadContext *tc, MVMObject *check_frames) {
@@ -1,15 +1,58 @@
 #include "moar.h"
 
+/* In adaptive tiering mode, weights a threshold by how busy the worker has
+ * been lately. */
+static MVMuint32 adapt_threshold(MVMThreadContext *tc, MVMuint32 threshold) {
+    threshold = (threshold * tc->instance->spesh_threshold_percent) / 100;
+    return threshold < MVM_SPESH_ADAPTIVE_MIN_THRESHOLD
+        ? MVM_SPESH_ADAPTIVE_MIN_THRESHOLD
+        : threshold;
+}
+
 /* Choose the threshold for a given static frame before we start applying
  * specialization to it. */
 MVMuint32 MVM_spesh_threshold(MVMThreadContext *tc, MVMStaticFrame *sf) {
     MVMuint32 bs = sf->body.bytecode_size;
+    MVMuint32 threshold;
     if (tc->instance->spesh_nodelay)
         return 1;
     if (bs <= 2048)
-        return 150;
+        threshold = 150;
     else if (bs <= 8192)
-        return 200;
+        threshold = 200;
     else
-        return 300;
+        threshold = 300;
+    return tc->instance->spesh_adaptive_enabled
+        ? adapt_threshold(tc, threshold)
+        : threshold;
+}
+
+/* Called by the main worker after it has dealt with some work, with how long
+ * it waited for that work and whether threads have more logs waiting for it
+ * or ran out of log quota. An idle worker lowers the thresholds so that code warms up faster,
+ * while a backlog raises them so we spend less time compiling. */
+void MVM_spesh_threshold_adapt(MVMThreadContext *tc, MVMuint64 idle_ns, MVMint32 backlog) {
+    MVMInstance *instance = tc->instance;
+    MVMuint32 percent = instance->spesh_threshold_percent;
+    if (!instance->spesh_adaptive_enabled)
+        return;
+    if (backlog) {
+        percent += (percent * MVM_SPESH_ADAPTIVE_BACKLOG_STEP) / 100;
+        if (percent > MVM_SPESH_ADAPTIVE_MAX_PERCENT)
+            percent = MVM_SPESH_ADAPTIVE_MAX_PERCENT;
+    }
+    else if (idle_ns >= MVM_SPESH_ADAPTIVE_IDLE_NS) {
+        percent -= (percent * MVM_SPESH_ADAPTIVE_IDLE_STEP) / 100;
+        if (percent < MVM_SPESH_ADAPTIVE_MIN_PERCENT)
+            percent = MVM_SPESH_ADAPTIVE_MIN_PERCENT;
+    }
+    if (percent != instance->spesh_threshold_percent) {
+        instance->spesh_threshold_percent = percent;
+        if (MVM_spesh_debug_enabled(tc))
+            MVM_spesh_debug_printf(tc,
+                "Adaptive Tiering\n"
+                "================\n"
+                "Thresholds now scaled to %u%% (%s).\n\n",
+                percent, backlog ? "worker has a backlog" : "worker was idle");
+    }
 }
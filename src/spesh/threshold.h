@@ -1,4 +1,26 @@
 /* The maximum size of bytecode we'll ever attempt to optimize. */
 #define MVM_SPESH_MAX_BYTECODE_SIZE 65536
 
+/* Bounds on the percentage the thresholds are scaled by in adaptive tiering
+ * mode, and how far it moves each time the worker is seen to be idle or to
+ * have a backlog. */
+#define MVM_SPESH_ADAPTIVE_MIN_PERCENT      25
+#define MVM_SPESH_ADAPTIVE_MAX_PERCENT      400
+#define MVM_SPESH_ADAPTIVE_IDLE_STEP        10
+#define MVM_SPESH_ADAPTIVE_BACKLOG_STEP     25
+
+/* How long the worker must have waited for logs, in nanoseconds, for it to
+ * count as idle. */
+#define MVM_SPESH_ADAPTIVE_IDLE_NS          1000000
+
+/* The threshold is never made lower than this in adaptive tiering mode, so
+ * we always have some statistics to specialize from. */
+#define MVM_SPESH_ADAPTIVE_MIN_THRESHOLD    20
+
+/* In adaptive tiering mode, one in this many calls that would run a
+ * specialization not specific to argument types is instead run unspecialized
+ * and logged, so the frame can be planned again once its types stabilize. */
+#define MVM_SPESH_ADAPTIVE_RESAMPLE_INTERVAL 8
+
 MVMuint32 MVM_spesh_threshold(MVMThreadContext *tc, MVMStaticFrame *sf);
+void MVM_spesh_threshold_adapt(MVMThreadContext *tc, MVMuint64 idle_ns, MVMint32 backlog);
@@ -0,0 +1,504 @@
+#include "moar.h"
+
+/* Keeps numeric values unboxed across basic blocks. A loop that counts or
+ * accumulates using boxed integers or nums will, even after the box/unbox
+ * pair elimination in the post-inline pass, box the new value at the end of
+ * every iteration and unbox it again at the top of the next, since the value
+ * flows around the loop through a PHI. Here we look for webs of object PHIs
+ * whose incoming values are all boxes of the same type (or other PHIs of
+ * the web), and whose only users are unboxes. We then mirror the web with
+ * native PHIs in a fresh register, turn the unboxes into reads of that, and
+ * delete the object PHIs, leaving the boxes for dead instruction elimination.
+ *
+ * Should we deoptimize at a point where one of the boxes is still needed, we
+ * make a new box from the native register; this reuses the materialization
+ * that partial escape analysis does for replaced allocations. If the web is
+ * entered through OSR, then the boxed value in the register at that point is
+ * unboxed into the native register when performing OSR (which is refused if
+ * it is not a box of the type we expect).
+ */
+
+/* The maximum number of PHIs and boxes in a web we will consider. */
+#define MAX_WEB_VALUES 32
+
+/* A PHI or box in a web, along with the native version mirroring it. */
+typedef struct {
+    MVMSpeshIns *ins;
+    MVMSpeshBB *bb;
+    MVMSpeshOperand native;
+
+    /* For a PHI with an input from an OSR entry, the index of the OSR deopt
+     * point; -1 otherwise. */
+    MVMint32 osr_idx;
+} UnboxValue;
+
+/* A web of boxed values that could be kept unboxed. */
+typedef struct {
+    /* The register all of the values live in. */
+    MVMuint16 orig;
+
+    /* The box op used, the native register kind, and the boxed type; these
+     * are set when the first box is found. */
+    MVMuint16 box_op;
+    MVMuint16 kind;
+    MVMObject *type;
+
+    /* The PHIs and boxes making up the web. */
+    MVM_VECTOR_DECL(UnboxValue, values);
+
+    /* The unboxing instructions using values in the web. */
+    MVM_VECTOR_DECL(MVMSpeshIns *, unboxes);
+} UnboxWeb;
+
+/* A PHI or box instruction along with the basic block it lives in. */
+typedef struct {
+    MVMSpeshIns *ins;
+    MVMSpeshBB *bb;
+} InsLocation;
+
+/* A deopt point that may be deoptimized to at runtime, along with the index
+ * that was used to record deopt usages of values needed there. */
+typedef struct {
+    MVMint32 deopt_idx;
+    MVMint32 deopt_user_idx;
+} DeoptIdxMapping;
+
+/* State for the pass over the whole graph. */
+typedef struct {
+    MVM_VECTOR_DECL(InsLocation, locations);
+    MVM_VECTOR_DECL(DeoptIdxMapping, deopt_idxs);
+    MVMuint32 have_deopt_idxs;
+} UnboxState;
+
+/* Finds the basic block of a PHI or box instruction. */
+static MVMSpeshBB * find_bb(UnboxState *us, MVMSpeshIns *ins) {
+    MVMuint32 i;
+    for (i = 0; i < MVM_VECTOR_ELEMS(us->locations); i++)
+        if (us->locations[i].ins == ins)
+            return us->locations[i].bb;
+    return NULL;
+}
+
+/* Finds the value in a web that the given instruction writes. */
+static UnboxValue * find_value(UnboxWeb *web, MVMSpeshIns *ins) {
+    MVMuint32 i;
+    for (i = 0; i < MVM_VECTOR_ELEMS(web->values); i++)
+        if (web->values[i].ins == ins)
+            return &(web->values[i]);
+    return NULL;
+}
+
+/* Checks if the entry block of the graph is a predecessor of a block, which
+ * means the block is a loop header with an OSR point. */
+static MVMuint32 has_entry_pred(MVMSpeshGraph *g, MVMSpeshBB *bb) {
+    MVMuint16 i;
+    for (i = 0; i < bb->num_pred; i++)
+        if (bb->pred[i] == g->entry)
+            return 1;
+    return 0;
+}
+
+/* Finds the OSR deopt index in a block, if there is one. */
+static MVMint32 find_osr_idx_in(MVMSpeshBB *bb) {
+    MVMSpeshIns *ins = bb->first_ins;
+    while (ins) {
+        MVMSpeshAnn *ann = ins->annotations;
+        while (ann) {
+            if (ann->type == MVM_SPESH_ANN_DEOPT_OSR)
+                return ann->data.deopt_idx;
+            ann = ann->next;
+        }
+        ins = ins->next;
+    }
+    return -1;
+}
+
+/* Finds the OSR deopt index of a loop header. Loop-invariant code motion
+ * may have moved it into the preheader, so we look there too. */
+static MVMint32 find_osr_idx(MVMSpeshGraph *g, MVMSpeshBB *header) {
+    MVMint32 idx = find_osr_idx_in(header);
+    MVMuint16 i;
+    for (i = 0; idx < 0 && i < header->num_pred; i++)
+        if (header->pred[i] != g->entry)
+            idx = find_osr_idx_in(header->pred[i]);
+    return idx;
+}
+
+/* Adds a PHI or box to the web, if it's not already in it. */
+static MVMuint32 add_value(UnboxState *us, UnboxWeb *web, MVMSpeshIns *ins) {
+    UnboxValue value;
+    if (find_value(web, ins))
+        return 1;
+    if (MVM_VECTOR_ELEMS(web->values) == MAX_WEB_VALUES)
+        return 0;
+    value.ins = ins;
+    value.bb = find_bb(us, ins);
+    value.osr_idx = -1;
+    if (!value.bb)
+        return 0;
+    MVM_VECTOR_PUSH(web->values, value);
+    return 1;
+}
+
+/* Checks a box flowing into the web is compatible with those already in it,
+ * and adds it. */
+static MVMuint32 add_box(MVMThreadContext *tc, MVMSpeshGraph *g, UnboxState *us,
+                         UnboxWeb *web, MVMSpeshIns *box) {
+    MVMSpeshFacts *type_facts = MVM_spesh_get_facts(tc, g, box->operands[2]);
+    MVMObject *type;
+    if (!(type_facts->flags & MVM_SPESH_FACT_KNOWN_TYPE) || !type_facts->type)
+        return 0;
+    type = type_facts->type;
+    if (web->box_op) {
+        if (box->info->opcode != web->box_op || type != web->type)
+            return 0;
+    }
+    else {
+        if (type->st->container_spec)
+            return 0;
+        web->box_op = box->info->opcode;
+        web->kind = web->box_op == MVM_OP_box_i ? MVM_reg_int64 : MVM_reg_num64;
+        web->type = type;
+    }
+    return add_value(us, web, box);
+}
+
+/* Checks the users of a value in the web, adding any PHIs to the web and
+ * recording any unboxes. */
+static MVMuint32 check_users(MVMThreadContext *tc, MVMSpeshGraph *g, UnboxState *us,
+                             UnboxWeb *web, MVMSpeshOperand value) {
+    MVMSpeshFacts *facts = MVM_spesh_get_facts(tc, g, value);
+    MVMSpeshUseChainEntry *user = facts->usage.users;
+    MVMSpeshDeoptUseEntry *deopt_user = facts->usage.deopt_users;
+    if (facts->usage.handler_required)
+        return 0;
+    while (deopt_user) {
+        if (deopt_user->deopt_idx < 0)
+            return 0;
+        deopt_user = deopt_user->next;
+    }
+    while (user) {
+        MVMSpeshIns *ins = user->user;
+        switch (ins->info->opcode) {
+            case MVM_SSA_PHI:
+                if (ins->operands[0].reg.orig != web->orig || !add_value(us, web, ins))
+                    return 0;
+                break;
+            case MVM_OP_unbox_i:
+            case MVM_OP_decont_i:
+            case MVM_OP_unbox_n:
+            case MVM_OP_decont_n:
+                MVM_VECTOR_PUSH(web->unboxes, ins);
+                break;
+            default:
+                return 0;
+        }
+        user = user->next;
+    }
+    return 1;
+}
+
+/* Builds up the web starting from a PHI, returning non-zero if it's one that
+ * we can keep unboxed. */
+static MVMuint32 build_web(MVMThreadContext *tc, MVMSpeshGraph *g, UnboxState *us,
+                           UnboxWeb *web, MVMSpeshIns *phi) {
+    MVMuint32 i, j;
+    MVMuint16 unbox_op, decont_op;
+    web->orig = phi->operands[0].reg.orig;
+    if (!add_value(us, web, phi))
+        return 0;
+    for (i = 0; i < MVM_VECTOR_ELEMS(web->values); i++) {
+        UnboxValue *value = &(web->values[i]);
+        MVMSpeshIns *ins = value->ins;
+        if (ins->info->opcode == MVM_SSA_PHI) {
+            for (j = 1; j < ins->info->num_operands; j++) {
+                MVMSpeshIns *writer;
+                if (ins->operands[j].reg.orig != web->orig)
+                    return 0;
+                writer = MVM_spesh_get_facts(tc, g, ins->operands[j])->writer;
+                if (!writer) {
+                    /* Only the input from an OSR entry may lack a writer. */
+                    if (!has_entry_pred(g, value->bb))
+                        return 0;
+                    if (value->osr_idx < 0) {
+                        value->osr_idx = find_osr_idx(g, value->bb);
+                        if (value->osr_idx < 0)
+                            return 0;
+                    }
+                }
+                else if (writer->info->opcode == MVM_SSA_PHI) {
+                    if (!add_value(us, web, writer))
+                        return 0;
+                }
+                else if (writer->info->opcode == MVM_OP_box_i ||
+                         writer->info->opcode == MVM_OP_box_n) {
+                    if (!add_box(tc, g, us, web, writer))
+                        return 0;
+                }
+                else {
+                    return 0;
+                }
+                /* Adding may have grown (and so moved) the values. */
+                value = &(web->values[i]);
+            }
+        }
+        if (!check_users(tc, g, us, web, ins->operands[0]))
+            return 0;
+    }
+
+    /* We need at least one box, and all of the unboxes must match it. */
+    if (!web->box_op)
+        return 0;
+    unbox_op = web->box_op == MVM_OP_box_i ? MVM_OP_unbox_i : MVM_OP_unbox_n;
+    decont_op = web->box_op == MVM_OP_box_i ? MVM_OP_decont_i : MVM_OP_decont_n;
+    for (i = 0; i < MVM_VECTOR_ELEMS(web->unboxes); i++) {
+        MVMuint16 opcode = web->unboxes[i]->info->opcode;
+        if (opcode != unbox_op && opcode != decont_op)
+            return 0;
+    }
+    return 1;
+}
+
+/* Collects the deopt points that may be deoptimized to at runtime, along
+ * with the index used for deopt usages there (which differs from the runtime
+ * one for synthetic deopt points). */
+static void collect_deopt_idxs(MVMThreadContext *tc, MVMSpeshGraph *g, UnboxState *us) {
+    MVMSpeshBB *bb = g->entry;
+    while (bb) {
+        MVMSpeshIns *ins = bb->first_ins;
+        while (ins) {
+            MVMint32 deopt_user_idx = -1;
+            MVMSpeshAnn *ann = ins->annotations;
+            while (ann) {
+                if (ann->type == MVM_SPESH_ANN_DEOPT_SYNTH) {
+                    deopt_user_idx = ann->data.deopt_idx;
+                    break;
+                }
+                ann = ann->next;
+            }
+            ann = ins->annotations;
+            while (ann) {
+                switch (ann->type) {
+                    case MVM_SPESH_ANN_DEOPT_ONE_INS:
+                    case MVM_SPESH_ANN_DEOPT_ALL_INS:
+                    case MVM_SPESH_ANN_DEOPT_INLINE: {
+                        DeoptIdxMapping mapping;
+                        mapping.deopt_idx = ann->data.deopt_idx;
+                        mapping.deopt_user_idx = deopt_user_idx >= 0
+                            ? deopt_user_idx
+                            : ann->data.deopt_idx;
+                        MVM_VECTOR_PUSH(us->deopt_idxs, mapping);
+                        break;
+                    }
+                }
+                ann = ann->next;
+            }
+            ins = ins->next;
+        }
+        bb = bb->linear_next;
+    }
+    us->have_deopt_idxs = 1;
+}
+
+/* Adds a deopt point at which to box the value in the native register into
+ * the object register, unless it is already there. */
+static void add_deopt_point(MVMSpeshGraph *g, MVMint32 deopt_idx, MVMuint16 mat_idx,
+                            MVMuint16 target_reg) {
+    MVMSpeshPEADeoptPoint dp;
+    MVMuint32 i;
+    for (i = 0; i < MVM_VECTOR_ELEMS(g->deopt_pea.deopt_point); i++) {
+        MVMSpeshPEADeoptPoint *existing = &(g->deopt_pea.deopt_point[i]);
+        if (existing->deopt_point_idx == deopt_idx &&
+                existing->materialize_info_idx == mat_idx &&
+                existing->target_reg == target_reg)
+            return;
+    }
+    dp.deopt_point_idx = deopt_idx;
+    dp.materialize_info_idx = mat_idx;
+    dp.target_reg = target_reg;
+    MVM_VECTOR_PUSH(g->deopt_pea.deopt_point, dp);
+}
+
+/* Sets up boxing of the native value upon deoptimization at any point where
+ * a value in the web is needed, and moves the deopt usages over to the
+ * native versions. */
+static void add_deopt_boxing(MVMThreadContext *tc, MVMSpeshGraph *g, UnboxState *us,
+                             UnboxWeb *web, MVMuint16 native_reg, MVMuint16 type_sslot) {
+    MVMint32 mat_idx = -1;
+    MVMuint32 i, j;
+    for (i = 0; i < MVM_VECTOR_ELEMS(web->values); i++) {
+        UnboxValue *value = &(web->values[i]);
+        MVMSpeshFacts *facts = MVM_spesh_get_facts(tc, g, value->ins->operands[0]);
+        MVMSpeshDeoptUseEntry *deopt_user = facts->usage.deopt_users;
+        if (!deopt_user)
+            continue;
+        if (mat_idx < 0) {
+            MVMSpeshPEAMaterializeInfo mi;
+            mi.stable_sslot = type_sslot;
+            mi.num_attr_regs = 1;
+            mi.attr_regs = MVM_malloc(sizeof(MVMuint16));
+            mi.attr_regs[0] = native_reg;
+            mi.key_sslots = NULL;
+            mi.unboxed_kind = web->kind;
+            mat_idx = MVM_VECTOR_ELEMS(g->deopt_pea.materialize_info);
+            MVM_VECTOR_PUSH(g->deopt_pea.materialize_info, mi);
+            if (!us->have_deopt_idxs)
+                collect_deopt_idxs(tc, g, us);
+        }
+        while (deopt_user) {
+            for (j = 0; j < MVM_VECTOR_ELEMS(us->deopt_idxs); j++)
+                if (us->deopt_idxs[j].deopt_user_idx == deopt_user->deopt_idx)
+                    add_deopt_point(g, us->deopt_idxs[j].deopt_idx, mat_idx, web->orig);
+            MVM_spesh_usages_add_deopt_usage_by_reg(tc, g, value->native,
+                deopt_user->deopt_idx);
+            deopt_user = deopt_user->next;
+        }
+        facts->usage.deopt_users = NULL;
+    }
+}
+
+/* Mirrors the web with native values, and rewrites the unboxes to use
+ * them. */
+static void unbox_web(MVMThreadContext *tc, MVMSpeshGraph *g, UnboxState *us,
+                      UnboxWeb *web) {
+    MVMuint16 native_reg = MVM_spesh_manipulate_get_unique_reg(tc, g, web->kind);
+    MVMuint16 type_sslot = MVM_spesh_add_spesh_slot_try_reuse(tc, g,
+        (MVMCollectable *)web->type->st);
+    MVMuint32 i, j;
+
+    /* Allocate a native version for each value. */
+    for (i = 0; i < MVM_VECTOR_ELEMS(web->values); i++)
+        web->values[i].native = MVM_spesh_manipulate_new_version(tc, g, native_reg);
+
+    /* Copy the unboxed value after each box, and make a native PHI after
+     * each object one. */
+    for (i = 0; i < MVM_VECTOR_ELEMS(web->values); i++) {
+        UnboxValue *value = &(web->values[i]);
+        MVMSpeshIns *ins = value->ins;
+        MVMSpeshIns *native_ins = MVM_spesh_alloc(tc, g, sizeof(MVMSpeshIns));
+        if (ins->info->opcode == MVM_SSA_PHI) {
+            native_ins->info = get_phi(tc, g, ins->info->num_operands);
+            native_ins->operands = MVM_spesh_alloc(tc, g,
+                ins->info->num_operands * sizeof(MVMSpeshOperand));
+            native_ins->operands[0] = value->native;
+            for (j = 1; j < ins->info->num_operands; j++) {
+                MVMSpeshIns *writer = MVM_spesh_get_facts(tc, g, ins->operands[j])->writer;
+                if (writer) {
+                    native_ins->operands[j] = find_value(web, writer)->native;
+                }
+                else {
+                    /* The OSR input, which is unboxed when performing OSR. */
+                    native_ins->operands[j].reg.orig = native_reg;
+                    native_ins->operands[j].reg.i = 0;
+                }
+                MVM_spesh_usages_add_by_reg(tc, g, native_ins->operands[j], native_ins);
+            }
+        }
+        else {
+            native_ins->info = MVM_op_get_op(MVM_OP_set);
+            native_ins->operands = MVM_spesh_alloc(tc, g, 2 * sizeof(MVMSpeshOperand));
+            native_ins->operands[0] = value->native;
+            native_ins->operands[1] = ins->operands[1];
+            MVM_spesh_usages_add_by_reg(tc, g, native_ins->operands[1], native_ins);
+            MVM_spesh_graph_add_comment(tc, g, native_ins, "unboxed copy of boxed value");
+        }
+        MVM_spesh_get_facts(tc, g, value->native)->writer = native_ins;
+        MVM_spesh_manipulate_insert_ins(tc, value->bb, ins, native_ins);
+    }
+
+    /* Turn the unboxes into reads of the native values. */
+    for (i = 0; i < MVM_VECTOR_ELEMS(web->unboxes); i++) {
+        MVMSpeshIns *ins = web->unboxes[i];
+        MVMSpeshIns *writer = MVM_spesh_get_facts(tc, g, ins->operands[1])->writer;
+        MVM_spesh_usages_delete_by_reg(tc, g, ins->operands[1], ins);
+        ins->info = MVM_op_get_op(MVM_OP_set);
+        ins->operands[1] = find_value(web, writer)->native;
+        MVM_spesh_usages_add_by_reg(tc, g, ins->operands[1], ins);
+        MVM_spesh_graph_add_comment(tc, g, ins, "kept unboxed");
+    }
+
+    /* Box the native values again on deopt, and unbox them on OSR. */
+    add_deopt_boxing(tc, g, us, web, native_reg, type_sslot);
+    for (i = 0; i < MVM_VECTOR_ELEMS(web->values); i++) {
+        if (web->values[i].osr_idx >= 0) {
+            MVMSpeshPEAOSRUnbox ou;
+            ou.deopt_idx = web->values[i].osr_idx;
+            ou.obj_reg = web->orig;
+            ou.native_reg = native_reg;
+            ou.kind = web->kind;
+            ou.stable_sslot = type_sslot;
+            MVM_VECTOR_PUSH(g->deopt_pea.osr_unbox, ou);
+        }
+    }
+
+    /* The object PHIs are no longer used, except by each other, so delete
+     * them; the boxes will then be cleaned up as dead instructions. */
+    for (i = 0; i < MVM_VECTOR_ELEMS(web->values); i++)
+        if (web->values[i].ins->info->opcode == MVM_SSA_PHI)
+            MVM_spesh_manipulate_delete_ins(tc, g, web->values[i].bb, web->values[i].ins);
+}
+
+/* Checks if a PHI has a box flowing into it, and so is worth considering as
+ * the start of a web. */
+static MVMuint32 has_box_input(MVMThreadContext *tc, MVMSpeshGraph *g, MVMSpeshIns *phi) {
+    MVMuint16 i;
+    for (i = 1; i < phi->info->num_operands; i++) {
+        MVMSpeshIns *writer = MVM_spesh_get_facts(tc, g, phi->operands[i])->writer;
+        if (writer && (writer->info->opcode == MVM_OP_box_i ||
+                       writer->info->opcode == MVM_OP_box_n))
+            return 1;
+    }
+    return 0;
+}
+
+void MVM_spesh_unbox(MVMThreadContext *tc, MVMSpeshGraph *g) {
+    UnboxState us;
+    MVM_VECTOR_DECL(MVMSpeshIns *, seeds);
+    MVMSpeshBB *bb = g->entry;
+    MVMuint32 i;
+
+    /* Find the PHIs with boxed inputs, and where the PHIs and boxes live. */
+    MVM_VECTOR_INIT(us.locations, 0);
+    MVM_VECTOR_INIT(us.deopt_idxs, 0);
+    MVM_VECTOR_INIT(seeds, 0);
+    us.have_deopt_idxs = 0;
+    while (bb) {
+        MVMSpeshIns *ins = bb->first_ins;
+        while (ins) {
+            MVMuint16 opcode = ins->info->opcode;
+            if (opcode == MVM_SSA_PHI || opcode == MVM_OP_box_i || opcode == MVM_OP_box_n) {
+                InsLocation loc;
+                loc.ins = ins;
+                loc.bb = bb;
+                MVM_VECTOR_PUSH(us.locations, loc);
+                if (opcode == MVM_SSA_PHI && has_box_input(tc, g, ins))
+                    MVM_VECTOR_PUSH(seeds, ins);
+            }
+            ins = ins->next;
+        }
+        bb = bb->linear_next;
+    }
+
+    /* Try to keep the web each of them is in unboxed. */
+    for (i = 0; i < MVM_VECTOR_ELEMS(seeds); i++) {
+        UnboxWeb web;
+        if (MVM_spesh_get_facts(tc, g, seeds[i]->operands[0])->dead_writer)
+            continue;
+        memset(&web, 0, sizeof(UnboxWeb));
+        MVM_VECTOR_INIT(web.values, 4);
+        MVM_VECTOR_INIT(web.unboxes, 4);
+        if (build_web(tc, g, &us, &web, seeds[i])) {
+            if (MVM_spesh_debug_enabled(tc))
+                MVM_spesh_debug_printf(tc, "Unbox: keeping r%d unboxed (%d values, %d unboxes)\n",
+                    web.orig, (int)MVM_VECTOR_ELEMS(web.values),
+                    (int)MVM_VECTOR_ELEMS(web.unboxes));
+            unbox_web(tc, g, &us, &web);
+        }
+        MVM_VECTOR_DESTROY(web.values);
+        MVM_VECTOR_DESTROY(web.unboxes);
+    }
+
+    MVM_VECTOR_DESTROY(seeds);
+    MVM_VECTOR_DESTROY(us.locations);
+    MVM_VECTOR_DESTROY(us.deopt_idxs);
+}
@@ -0,0 +1 @@
+void MVM_spesh_unbox(MVMThreadContext *tc, MVMSpeshGraph *g);
@@ -0,0 +1,699 @@
+#include "moar.h"
+
+/* Vectorization of simple counted loops over native arrays. A loop such as:
+ *
+ *     my int $i = 0;
+ *     while $i < $n {
+ *         nqp::bindpos_n(@c, $i, nqp::mul_n(nqp::atpos_n(@a, $i), nqp::atpos_n(@b, $i)));
+ *         $i++
+ *     }
+ *
+ * ends up, once loop-invariant code has been hoisted, as a header that
+ * compares the induction variable with a limit and a body of one basic block
+ * that loads elements at the induction variable, computes with them, stores
+ * the result at the induction variable and steps it up by one. We replace
+ * the loads, the computation and the store with a single op that does the
+ * work of all the remaining iterations, and turn the step into a copy of the
+ * limit, so the header leaves the loop the next time it is reached. We also
+ * handle loops that sum up the elements of an array. The ops are:
+ *
+ *     sp_vec_binop_n   @c[$i] = @a[$i] op @b[$i] on num arrays (add, sub, mul)
+ *     sp_vec_binop_i   the same on int arrays
+ *     sp_vec_cmp_n     @c[$i] = @a[$i] cmp @b[$i], from num arrays to an int array
+ *     sp_vec_sum_n     $s = $s + @a[$i] on a num array
+ *     sp_vec_sum_i     the same on an int array
+ *
+ * If all the elements are in range, these work on the slots directly, and
+ * the JIT compiles them into SSE2 loops that do two elements at a time, with
+ * a scalar tail. Otherwise, they do exactly what the loop did, one element
+ * at a time through the REPR. Since each iteration only reads and writes the
+ * elements at the induction variable, doing two at a time gives the same
+ * results as the loop did, even if the arrays are one and the same. Sums of
+ * nums are the exception: floating point addition is not associative, so
+ * they are always done one element at a time, in order, and only save the
+ * loop overhead.
+ */
+
+/* The most instructions that we'll delete from a loop body. */
+#define MAX_DOOMED 16
+
+/* A loop we are trying to vectorize. */
+typedef struct {
+    MVMSpeshBB *header;
+    MVMSpeshBB *body;
+
+    /* The PHI of the induction variable, the add_i that steps it by one, and
+     * the value it is compared below to stay in the loop. */
+    MVMSpeshIns *phi;
+    MVMSpeshIns *step;
+    MVMSpeshOperand limit;
+
+    /* The element loads, the computation and the store in the body, and the
+     * PHI of the accumulator if it is a sum rather than a store. */
+    MVMSpeshIns *loads[2];
+    MVMuint32 num_loads;
+    MVMSpeshIns *op;
+    MVMSpeshIns *store;
+    MVMSpeshIns *acc_phi;
+
+    /* The instructions of the body that go away. */
+    MVMSpeshIns *doomed[MAX_DOOMED];
+    MVMuint32 num_doomed;
+} Loop;
+
+/* Looks through `set` instructions to find where a value came from. */
+static MVMSpeshOperand canonical(MVMThreadContext *tc, MVMSpeshGraph *g, MVMSpeshOperand o) {
+    MVMSpeshIns *writer = MVM_spesh_get_facts(tc, g, o)->writer;
+    while (writer && writer->info->opcode == MVM_OP_set) {
+        o = writer->operands[1];
+        writer = MVM_spesh_get_facts(tc, g, o)->writer;
+    }
+    return o;
+}
+static MVMSpeshIns * canonical_writer(MVMThreadContext *tc, MVMSpeshGraph *g, MVMSpeshOperand o) {
+    return MVM_spesh_get_facts(tc, g, canonical(tc, g, o))->writer;
+}
+static MVMuint32 same_value(MVMThreadContext *tc, MVMSpeshGraph *g, MVMSpeshOperand a,
+        MVMSpeshOperand b) {
+    a = canonical(tc, g, a);
+    b = canonical(tc, g, b);
+    return a.reg.orig == b.reg.orig && a.reg.i == b.reg.i;
+}
+static MVMuint32 is_one(MVMThreadContext *tc, MVMSpeshGraph *g, MVMSpeshOperand o) {
+    MVMSpeshFacts *facts = MVM_spesh_get_facts(tc, g, o);
+    return (facts->flags & MVM_SPESH_FACT_KNOWN_VALUE) && facts->value.i == 1;
+}
+static MVMuint32 in_bb(MVMSpeshBB *bb, MVMSpeshIns *target) {
+    MVMSpeshIns *ins;
+    for (ins = bb->first_ins; ins; ins = ins->next)
+        if (ins == target)
+            return 1;
+    return 0;
+}
+
+/* Checks if an object register is known to hold a concrete VMArray with the
+ * given slot type. */
+static MVMuint32 is_known_vmarray(MVMThreadContext *tc, MVMSpeshGraph *g,
+        MVMSpeshOperand o, MVMint32 slot_type) {
+    MVMSpeshFacts *facts = MVM_spesh_get_facts(tc, g, canonical(tc, g, o));
+    MVMSTable *st;
+    if ((facts->flags & (MVM_SPESH_FACT_KNOWN_TYPE | MVM_SPESH_FACT_CONCRETE)) !=
+            (MVM_SPESH_FACT_KNOWN_TYPE | MVM_SPESH_FACT_CONCRETE) || !facts->type)
+        return 0;
+    st = STABLE(facts->type);
+    return st->REPR->ID == MVM_REPR_ID_VMArray && st->REPR_data &&
+        ((MVMArrayREPRData *)st->REPR_data)->slot_type == slot_type;
+}
+
+/* Given the result of a comparison and whether it must be true or false to
+ * stay in the loop, sees if it keeps an index below a limit. */
+static MVMuint32 compared_below(MVMThreadContext *tc, MVMSpeshGraph *g, MVMSpeshOperand cond,
+        MVMuint32 truth, MVMSpeshOperand *idx, MVMSpeshOperand *limit) {
+    MVMSpeshIns *cmp = canonical_writer(tc, g, cond);
+    if (!cmp)
+        return 0;
+    switch (cmp->info->opcode) {
+        case MVM_OP_lt_i:
+            if (!truth) return 0;
+            *idx = cmp->operands[1]; *limit = cmp->operands[2];
+            return 1;
+        case MVM_OP_gt_i:
+            if (!truth) return 0;
+            *idx = cmp->operands[2]; *limit = cmp->operands[1];
+            return 1;
+        case MVM_OP_ge_i:
+            if (truth) return 0;
+            *idx = cmp->operands[1]; *limit = cmp->operands[2];
+            return 1;
+        case MVM_OP_le_i:
+            if (truth) return 0;
+            *idx = cmp->operands[2]; *limit = cmp->operands[1];
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+/* Sees if the block is the header of a loop with a body of one block, that
+ * is entered while an induction variable stepped by one in the body is below
+ * some limit. */
+static MVMuint32 find_loop(MVMThreadContext *tc, MVMSpeshGraph *g, MVMSpeshBB *header, Loop *l) {
+    MVMSpeshBB *body = NULL;
+    MVMSpeshIns *branch, *ins;
+    MVMSpeshOperand idx;
+    MVMuint32 truth, i;
+
+    if (header->num_pred != 2 || header->num_succ != 2 || header->num_handler_succ)
+        return 0;
+    for (i = 0; i < 2; i++) {
+        MVMSpeshBB *pred = header->pred[i];
+        if (pred != header && pred->num_succ == 1 && pred->succ[0] == header &&
+                pred->num_pred == 1 && pred->pred[0] == header && !pred->num_handler_succ)
+            body = pred;
+    }
+    if (!body)
+        return 0;
+
+    /* The header will run fewer times than it did, so it must do nothing but
+     * work out whether to go around again. */
+    branch = header->last_ins;
+    if (!branch || (branch->info->opcode != MVM_OP_if_i &&
+                branch->info->opcode != MVM_OP_unless_i))
+        return 0;
+    for (ins = header->first_ins; ins != branch; ins = ins->next)
+        if (ins->info->opcode != MVM_SSA_PHI && (!ins->info->pure ||
+                    (ins->info->jittivity & MVM_JIT_INFO_INVOKISH)))
+            return 0;
+
+    /* Find the induction variable and its limit. */
+    truth = branch->info->opcode == MVM_OP_if_i
+        ? branch->operands[1].ins_bb == body
+        : branch->operands[1].ins_bb != body;
+    if (!compared_below(tc, g, branch->operands[0], truth, &idx, &l->limit))
+        return 0;
+    l->phi = canonical_writer(tc, g, idx);
+    if (!l->phi || l->phi->info->opcode != MVM_SSA_PHI || l->phi->info->num_operands != 3 ||
+            !in_bb(header, l->phi))
+        return 0;
+
+    /* It must be stepped up by exactly one in the body, so that it leaves the
+     * loop equal to the limit. */
+    l->step = NULL;
+    for (i = 1; i < 3; i++) {
+        MVMSpeshIns *writer = canonical_writer(tc, g, l->phi->operands[i]);
+        if (!writer || writer->info->opcode != MVM_OP_add_i || !in_bb(body, writer))
+            continue;
+        if ((same_value(tc, g, writer->operands[1], l->phi->operands[0]) &&
+                    is_one(tc, g, writer->operands[2])) ||
+                (same_value(tc, g, writer->operands[2], l->phi->operands[0]) &&
+                    is_one(tc, g, writer->operands[1])))
+            l->step = writer;
+    }
+    if (!l->step)
+        return 0;
+
+    l->header = header;
+    l->body = body;
+    return 1;
+}
+
+/* Checks if an instruction is one that will be deleted. */
+static MVMuint32 is_doomed(Loop *l, MVMSpeshIns *ins) {
+    MVMuint32 i;
+    for (i = 0; i < l->num_doomed; i++)
+        if (l->doomed[i] == ins)
+            return 1;
+    return 0;
+}
+static MVMuint32 doom(Loop *l, MVMSpeshIns *ins) {
+    if (l->num_doomed == MAX_DOOMED)
+        return 0;
+    l->doomed[l->num_doomed++] = ins;
+    return 1;
+}
+
+/* Checks if a value written in the body is the same at the end of the last
+ * iteration after vectorizing as it was before. */
+static MVMuint32 is_final_value(MVMThreadContext *tc, MVMSpeshGraph *g, Loop *l,
+        MVMSpeshOperand o) {
+    MVMSpeshIns *writer = canonical_writer(tc, g, o);
+    return writer == l->step || (l->acc_phi && writer == l->op);
+}
+
+/* Finds the loads, the computation and the store in the loop body, and makes
+ * sure there is nothing else there that we don't understand. */
+static MVMuint32 find_body_parts(MVMThreadContext *tc, MVMSpeshGraph *g, Loop *l) {
+    MVMSpeshOperand iv = l->phi->operands[0];
+    MVMSpeshIns *ins;
+    l->num_loads = 0;
+    l->op = NULL;
+    l->store = NULL;
+    for (ins = l->body->first_ins; ins; ins = ins->next) {
+        MVMSpeshAnn *ann;
+        for (ann = ins->annotations; ann; ann = ann->next)
+            if (ann->type != MVM_SPESH_ANN_LINENO && ann->type != MVM_SPESH_ANN_COMMENT)
+                return 0;
+        switch (ins->info->opcode) {
+            case MVM_OP_goto:
+                if (ins != l->body->last_ins)
+                    return 0;
+                break;
+            case MVM_OP_set:
+            case MVM_OP_const_i64:
+            case MVM_OP_const_i64_16:
+            case MVM_OP_const_i64_32:
+            case MVM_OP_const_n64:
+                break;
+            case MVM_OP_atpos_i:
+            case MVM_OP_atpos_n:
+            case MVM_OP_sp_atpos_i64:
+            case MVM_OP_sp_atpos_n:
+                if (l->num_loads == 2 || !same_value(tc, g, ins->operands[2], iv))
+                    return 0;
+                l->loads[l->num_loads++] = ins;
+                break;
+            case MVM_OP_bindpos_i:
+            case MVM_OP_bindpos_n:
+            case MVM_OP_sp_bindpos_i64:
+            case MVM_OP_sp_bindpos_n:
+                if (l->store || !same_value(tc, g, ins->operands[1], iv))
+                    return 0;
+                l->store = ins;
+                break;
+            case MVM_OP_add_i:
+                if (ins == l->step)
+                    break;
+                /* Otherwise, it's the computation. */
+            case MVM_OP_sub_i:
+            case MVM_OP_mul_i:
+            case MVM_OP_add_n:
+            case MVM_OP_sub_n:
+            case MVM_OP_mul_n:
+            case MVM_OP_eq_n:
+            case MVM_OP_ne_n:
+            case MVM_OP_lt_n:
+            case MVM_OP_le_n:
+            case MVM_OP_gt_n:
+            case MVM_OP_ge_n:
+                if (l->op)
+                    return 0;
+                l->op = ins;
+                break;
+            default:
+                return 0;
+        }
+    }
+    return l->op != NULL;
+}
+
+/* Checks if the computation reads a value from one of the loads, and if so
+ * gives the load. */
+static MVMSpeshIns * load_of(MVMThreadContext *tc, MVMSpeshGraph *g, Loop *l,
+        MVMSpeshOperand o) {
+    MVMSpeshIns *writer = canonical_writer(tc, g, o);
+    MVMuint32 i;
+    for (i = 0; i < l->num_loads; i++)
+        if (l->loads[i] == writer)
+            return writer;
+    return NULL;
+}
+
+/* Works out which op the loop body can be replaced with. For a store, this
+ * gives the arrays to store to and load from; for a sum, the array to load
+ * from and which operand of the computation is the accumulator. */
+static MVMuint16 choose_op(MVMThreadContext *tc, MVMSpeshGraph *g, Loop *l,
+        MVMSpeshOperand *arrays, MVMint16 *kind) {
+    MVMSpeshIns *load_a, *load_b;
+    MVMuint16 opcode = l->op->info->opcode;
+    MVMuint32 i;
+    l->acc_phi = NULL;
+
+    if (l->store) {
+        MVMuint32 store_n = l->store->info->opcode == MVM_OP_bindpos_n ||
+            l->store->info->opcode == MVM_OP_sp_bindpos_n;
+        MVMuint32 swap = 0;
+        MVMuint16 vec_op;
+        if (canonical_writer(tc, g, l->store->operands[2]) != l->op)
+            return 0;
+        switch (opcode) {
+            case MVM_OP_add_n: vec_op = MVM_OP_sp_vec_binop_n; *kind = MVM_SPESH_VEC_ADD; break;
+            case MVM_OP_sub_n: vec_op = MVM_OP_sp_vec_binop_n; *kind = MVM_SPESH_VEC_SUB; break;
+            case MVM_OP_mul_n: vec_op = MVM_OP_sp_vec_binop_n; *kind = MVM_SPESH_VEC_MUL; break;
+            case MVM_OP_add_i: vec_op = MVM_OP_sp_vec_binop_i; *kind = MVM_SPESH_VEC_ADD; break;
+            case MVM_OP_sub_i: vec_op = MVM_OP_sp_vec_binop_i; *kind = MVM_SPESH_VEC_SUB; break;
+            case MVM_OP_mul_i: vec_op = MVM_OP_sp_vec_binop_i; *kind = MVM_SPESH_VEC_MUL; break;
+            case MVM_OP_eq_n: vec_op = MVM_OP_sp_vec_cmp_n; *kind = MVM_SPESH_VEC_EQ; break;
+            case MVM_OP_ne_n: vec_op = MVM_OP_sp_vec_cmp_n; *kind = MVM_SPESH_VEC_NE; break;
+            case MVM_OP_lt_n: vec_op = MVM_OP_sp_vec_cmp_n; *kind = MVM_SPESH_VEC_LT; break;
+            case MVM_OP_le_n: vec_op = MVM_OP_sp_vec_cmp_n; *kind = MVM_SPESH_VEC_LE; break;
+            case MVM_OP_gt_n: vec_op = MVM_OP_sp_vec_cmp_n; *kind = MVM_SPESH_VEC_LT; swap = 1; break;
+            case MVM_OP_ge_n: vec_op = MVM_OP_sp_vec_cmp_n; *kind = MVM_SPESH_VEC_LE; swap = 1; break;
+            default: return 0;
+        }
+        if (store_n != (vec_op == MVM_OP_sp_vec_binop_n))
+            return 0;
+
+        /* Both operands must be loads, and there must be no other loads. */
+        load_a = load_of(tc, g, l, l->op->operands[swap ? 2 : 1]);
+        load_b = load_of(tc, g, l, l->op->operands[swap ? 1 : 2]);
+        if (!load_a || !load_b || (l->num_loads == 2 && load_a == load_b))
+            return 0;
+        arrays[0] = canonical(tc, g, l->store->operands[0]);
+        arrays[1] = canonical(tc, g, load_a->operands[1]);
+        arrays[2] = canonical(tc, g, load_b->operands[1]);
+        if (!is_known_vmarray(tc, g, arrays[0], store_n ? MVM_ARRAY_N64 : MVM_ARRAY_I64))
+            return 0;
+        for (i = 1; i < 3; i++)
+            if (!is_known_vmarray(tc, g, arrays[i],
+                    vec_op == MVM_OP_sp_vec_binop_i ? MVM_ARRAY_I64 : MVM_ARRAY_N64))
+                return 0;
+        return vec_op;
+    }
+    else {
+        /* A sum, where one operand is an accumulator PHI in the header that
+         * gets the result of the add back, and the other is the only load. */
+        MVMuint32 acc_idx;
+        if ((opcode != MVM_OP_add_n && opcode != MVM_OP_add_i) || l->num_loads != 1)
+            return 0;
+        for (acc_idx = 1; acc_idx < 3; acc_idx++) {
+            MVMSpeshIns *phi = canonical_writer(tc, g, l->op->operands[acc_idx]);
+            if (phi && phi != l->phi && phi->info->opcode == MVM_SSA_PHI &&
+                    phi->info->num_operands == 3 && in_bb(l->header, phi) &&
+                    (canonical_writer(tc, g, phi->operands[1]) == l->op ||
+                     canonical_writer(tc, g, phi->operands[2]) == l->op) &&
+                    load_of(tc, g, l, l->op->operands[3 - acc_idx])) {
+                l->acc_phi = phi;
+                break;
+            }
+        }
+        if (!l->acc_phi)
+            return 0;
+        *kind = acc_idx;
+        arrays[0] = canonical(tc, g, l->loads[0]->operands[1]);
+        if (!is_known_vmarray(tc, g, arrays[0],
+                opcode == MVM_OP_add_n ? MVM_ARRAY_N64 : MVM_ARRAY_I64))
+            return 0;
+        return opcode == MVM_OP_add_n ? MVM_OP_sp_vec_sum_n : MVM_OP_sp_vec_sum_i;
+    }
+}
+
+/* Works out which instructions of the body go away, and makes sure nothing
+ * outside of the body relies on them, or on anything else in the body that
+ * would have a different value after vectorizing. */
+static MVMuint32 find_doomed(MVMThreadContext *tc, MVMSpeshGraph *g, Loop *l) {
+    MVMSpeshIns *ins;
+    MVMuint32 i;
+    l->num_doomed = 0;
+    for (ins = l->body->first_ins; ins; ins = ins->next) {
+        if (ins == l->store || (ins == l->op && !l->acc_phi) ||
+                (ins->info->opcode == MVM_OP_set &&
+                    is_doomed(l, MVM_spesh_get_facts(tc, g, ins->operands[1])->writer))) {
+            if (!doom(l, ins))
+                return 0;
+        }
+        else {
+            for (i = 0; i < l->num_loads; i++) {
+                if (ins == l->loads[i]) {
+                    if (!doom(l, ins))
+                        return 0;
+                    break;
+                }
+            }
+        }
+    }
+
+    for (ins = l->body->first_ins; ins; ins = ins->next) {
+        MVMSpeshFacts *facts;
+        MVMSpeshUseChainEntry *use;
+        if (ins == l->store || ins->info->opcode == MVM_OP_goto ||
+                (ins->info->operands[0] & MVM_operand_rw_mask) != MVM_operand_write_reg)
+            continue;
+        facts = MVM_spesh_get_facts(tc, g, ins->operands[0]);
+        if (is_doomed(l, ins)) {
+            /* Only read by what goes away, or by the computation that we
+             * rewrite into a sum. */
+            if (facts->usage.deopt_users || facts->usage.handler_required)
+                return 0;
+            for (use = facts->usage.users; use; use = use->next)
+                if (!is_doomed(l, use->user) && use->user != l->op)
+                    return 0;
+        }
+        else if (ins->info->opcode == MVM_OP_set && !is_final_value(tc, g, l, ins->operands[1])) {
+            /* A copy of something that would have a different value after
+             * the last iteration must not be used outside of the body. */
+            for (use = facts->usage.users; use; use = use->next)
+                if (!in_bb(l->body, use->user))
+                    return 0;
+        }
+    }
+    return 1;
+}
+
+/* Checks if a value is computed outside of the loop. */
+static MVMuint32 defined_outside(MVMThreadContext *tc, MVMSpeshGraph *g, Loop *l,
+        MVMSpeshOperand o) {
+    MVMSpeshIns *writer = canonical_writer(tc, g, o);
+    return !writer || (!in_bb(l->header, writer) && !in_bb(l->body, writer));
+}
+
+/* Checks that the arrays and the limit stay the same all through the loop,
+ * and that every value carried around the loop by a PHI in the header is
+ * either unchanged by the loop or has the value it would have had after the
+ * last iteration. The header only runs once more after the body now, so a
+ * PHI getting something else (like the induction variable itself, or a
+ * value computed from it in the header) would see a different value. */
+static MVMuint32 invariants_ok(MVMThreadContext *tc, MVMSpeshGraph *g, Loop *l,
+        MVMSpeshOperand *arrays, MVMuint32 num_arrays) {
+    MVMSpeshIns *ins;
+    MVMuint32 i;
+    for (i = 0; i < num_arrays; i++)
+        if (!defined_outside(tc, g, l, arrays[i]))
+            return 0;
+    if (!defined_outside(tc, g, l, l->limit)) {
+        /* An element count read in the header is fine, as long as it is of
+         * an array from outside of the loop. Only a store beyond the end of
+         * an array changes its element count, and the stores in the loop are
+         * all below the limit. */
+        MVMSpeshIns *writer = canonical_writer(tc, g, l->limit);
+        if (!in_bb(l->header, writer) || !defined_outside(tc, g, l, writer->operands[1]))
+            return 0;
+        if (writer->info->opcode != MVM_OP_elems && (writer->info->opcode != MVM_OP_sp_get_i64 ||
+                    writer->operands[2].lit_i16 != offsetof(MVMArray, body.elems)))
+            return 0;
+    }
+    for (ins = l->header->first_ins; ins && ins->info->opcode == MVM_SSA_PHI; ins = ins->next) {
+        for (i = 1; i < ins->info->num_operands; i++) {
+            MVMSpeshIns *writer = canonical_writer(tc, g, ins->operands[i]);
+            if (!writer || writer == ins || defined_outside(tc, g, l, ins->operands[i]))
+                continue;
+            if (in_bb(l->body, writer) && (is_final_value(tc, g, l, ins->operands[i]) ||
+                        writer->info->opcode == MVM_OP_const_i64 ||
+                        writer->info->opcode == MVM_OP_const_i64_16 ||
+                        writer->info->opcode == MVM_OP_const_i64_32 ||
+                        writer->info->opcode == MVM_OP_const_n64))
+                continue;
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* Replaces the body of the loop with the vectorized op. */
+static void vectorize_loop(MVMThreadContext *tc, MVMSpeshGraph *g, Loop *l, MVMuint16 vec_op,
+        MVMSpeshOperand *arrays, MVMint16 kind) {
+    MVMSpeshIns *vec;
+    MVMuint32 i, num_arrays;
+
+    if (vec_op == MVM_OP_sp_vec_sum_n || vec_op == MVM_OP_sp_vec_sum_i) {
+        /* Turn the add into the sum; here, kind is the accumulator operand. */
+        MVMSpeshOperand *operands = MVM_spesh_alloc(tc, g, 5 * sizeof(MVMSpeshOperand));
+        vec = l->op;
+        operands[0] = vec->operands[0];
+        operands[1] = vec->operands[kind];
+        operands[2] = arrays[0];
+        operands[3] = l->phi->operands[0];
+        operands[4] = l->limit;
+        MVM_spesh_usages_delete_by_reg(tc, g, vec->operands[1], vec);
+        MVM_spesh_usages_delete_by_reg(tc, g, vec->operands[2], vec);
+        vec->info = MVM_op_get_op(vec_op);
+        vec->operands = operands;
+        for (i = 1; i < 5; i++)
+            MVM_spesh_usages_add_by_reg(tc, g, operands[i], vec);
+        num_arrays = 1;
+    }
+    else {
+        /* Put the new op where the store was. */
+        vec = MVM_spesh_alloc(tc, g, sizeof(MVMSpeshIns));
+        vec->info = MVM_op_get_op(vec_op);
+        vec->operands = MVM_spesh_alloc(tc, g, 6 * sizeof(MVMSpeshOperand));
+        vec->operands[0] = arrays[0];
+        vec->operands[1] = arrays[1];
+        vec->operands[2] = arrays[2];
+        vec->operands[3] = l->phi->operands[0];
+        vec->operands[4] = l->limit;
+        vec->operands[5].lit_i16 = kind;
+        MVM_spesh_manipulate_insert_ins(tc, l->body, l->store->prev, vec);
+        for (i = 0; i < 5; i++)
+            MVM_spesh_usages_add_by_reg(tc, g, vec->operands[i], vec);
+        num_arrays = 3;
+    }
+    for (i = 0; i < num_arrays; i++)
+        MVM_spesh_use_facts(tc, g, MVM_spesh_get_facts(tc, g, arrays[i]));
+
+    /* Delete what it replaced, latest first so each is unused by the time it
+     * goes. */
+    for (i = l->num_doomed; i > 0; i--)
+        MVM_spesh_manipulate_delete_ins(tc, g, l->body, l->doomed[i - 1]);
+
+    /* The induction variable now goes straight to the limit. */
+    MVM_spesh_usages_delete_by_reg(tc, g, l->step->operands[1], l->step);
+    MVM_spesh_usages_delete_by_reg(tc, g, l->step->operands[2], l->step);
+    l->step->info = MVM_op_get_op(MVM_OP_set);
+    l->step->operands[1] = l->limit;
+    MVM_spesh_usages_add_by_reg(tc, g, l->step->operands[1], l->step);
+
+    if (MVM_spesh_debug_enabled(tc))
+        MVM_spesh_debug_printf(tc, "Vectorize: loop with header BB %d into %s\n",
+            l->header->idx, vec->info->name);
+    MVM_spesh_graph_add_comment(tc, g, vec, "vectorized loop with header BB %d",
+        l->header->idx);
+}
+
+/* Vectorizes simple counted loops over native arrays. */
+void MVM_spesh_vectorize(MVMThreadContext *tc, MVMSpeshGraph *g) {
+    MVMSpeshBB *bb = g->entry;
+    while (bb) {
+        Loop l;
+        MVMSpeshOperand arrays[3];
+        MVMint16 kind;
+        MVMuint16 vec_op;
+        if (find_loop(tc, g, bb, &l) && find_body_parts(tc, g, &l) &&
+                (vec_op = choose_op(tc, g, &l, arrays, &kind)) && find_doomed(tc, g, &l) &&
+                invariants_ok(tc, g, &l, arrays, l.acc_phi ? 1 : 3))
+            vectorize_loop(tc, g, &l, vec_op, arrays, kind);
+        bb = bb->linear_next;
+    }
+}
+
+/* The rest of this file is the implementation of the vectorized ops. If all
+ * the elements are in range, we go straight to the slots; otherwise, we do
+ * just what the loop did, through the REPR. */
+static MVMuint32 in_range(MVMObject *array, MVMint64 from, MVMint64 to) {
+    return from >= 0 && (MVMuint64)to <= ((MVMArray *)array)->body.elems;
+}
+static MVMnum64 * slots_n(MVMObject *array) {
+    return ((MVMArray *)array)->body.slots.n64 + ((MVMArray *)array)->body.start;
+}
+static MVMint64 * slots_i(MVMObject *array) {
+    return ((MVMArray *)array)->body.slots.i64 + ((MVMArray *)array)->body.start;
+}
+
+static MVMnum64 binop_n(MVMint64 kind, MVMnum64 a, MVMnum64 b) {
+    switch (kind) {
+        case MVM_SPESH_VEC_ADD: return a + b;
+        case MVM_SPESH_VEC_SUB: return a - b;
+        default:                return a * b;
+    }
+}
+void MVM_spesh_vec_binop_n(MVMThreadContext *tc, MVMObject *dst, MVMObject *a, MVMObject *b,
+        MVMint64 from, MVMint64 to, MVMint64 kind) {
+    MVMint64 k;
+    if (in_range(dst, from, to) && in_range(a, from, to) && in_range(b, from, to)) {
+        MVMnum64 *d = slots_n(dst), *x = slots_n(a), *y = slots_n(b);
+        switch (kind) {
+            case MVM_SPESH_VEC_ADD:
+                for (k = from; k < to; k++)
+                    d[k] = x[k] + y[k];
+                break;
+            case MVM_SPESH_VEC_SUB:
+                for (k = from; k < to; k++)
+                    d[k] = x[k] - y[k];
+                break;
+            default:
+                for (k = from; k < to; k++)
+                    d[k] = x[k] * y[k];
+                break;
+        }
+    }
+    else {
+        for (k = from; k < to; k++) {
+            MVMnum64 x = MVM_repr_at_pos_n(tc, a, k);
+            MVMnum64 y = MVM_repr_at_pos_n(tc, b, k);
+            MVM_repr_bind_pos_n(tc, dst, k, binop_n(kind, x, y));
+        }
+    }
+}
+
+static MVMint64 binop_i(MVMint64 kind, MVMint64 a, MVMint64 b) {
+    switch (kind) {
+        case MVM_SPESH_VEC_ADD: return a + b;
+        case MVM_SPESH_VEC_SUB: return a - b;
+        default:                return a * b;
+    }
+}
+void MVM_spesh_vec_binop_i(MVMThreadContext *tc, MVMObject *dst, MVMObject *a, MVMObject *b,
+        MVMint64 from, MVMint64 to, MVMint64 kind) {
+    MVMint64 k;
+    if (in_range(dst, from, to) && in_range(a, from, to) && in_range(b, from, to)) {
+        MVMint64 *d = slots_i(dst), *x = slots_i(a), *y = slots_i(b);
+        switch (kind) {
+            case MVM_SPESH_VEC_ADD:
+                for (k = from; k < to; k++)
+                    d[k] = x[k] + y[k];
+                break;
+            case MVM_SPESH_VEC_SUB:
+                for (k = from; k < to; k++)
+                    d[k] = x[k] - y[k];
+                break;
+            default:
+                for (k = from; k < to; k++)
+                    d[k] = x[k] * y[k];
+                break;
+        }
+    }
+    else {
+        for (k = from; k < to; k++) {
+            MVMint64 x = MVM_repr_at_pos_i(tc, a, k);
+            MVMint64 y = MVM_repr_at_pos_i(tc, b, k);
+            MVM_repr_bind_pos_i(tc, dst, k, binop_i(kind, x, y));
+        }
+    }
+}
+
+static MVMint64 cmp_n(MVMint64 kind, MVMnum64 a, MVMnum64 b) {
+    switch (kind) {
+        case MVM_SPESH_VEC_EQ: return a == b;
+        case MVM_SPESH_VEC_NE: return a != b;
+        case MVM_SPESH_VEC_LT: return a < b;
+        default:               return a <= b;
+    }
+}
+void MVM_spesh_vec_cmp_n(MVMThreadContext *tc, MVMObject *dst, MVMObject *a, MVMObject *b,
+        MVMint64 from, MVMint64 to, MVMint64 kind) {
+    MVMint64 k;
+    if (in_range(dst, from, to) && in_range(a, from, to) && in_range(b, from, to)) {
+        MVMint64 *d = slots_i(dst);
+        MVMnum64 *x = slots_n(a), *y = slots_n(b);
+        for (k = from; k < to; k++)
+            d[k] = cmp_n(kind, x[k], y[k]);
+    }
+    else {
+        for (k = from; k < to; k++) {
+            MVMnum64 x = MVM_repr_at_pos_n(tc, a, k);
+            MVMnum64 y = MVM_repr_at_pos_n(tc, b, k);
+            MVM_repr_bind_pos_i(tc, dst, k, cmp_n(kind, x, y));
+        }
+    }
+}
+
+/* Adds up the elements strictly in order, so the result is just the same as
+ * the loop's, however warmed up the code is. */
+MVMnum64 MVM_spesh_vec_sum_n(MVMThreadContext *tc, MVMnum64 init, MVMObject *a,
+        MVMint64 from, MVMint64 to) {
+    MVMint64 k;
+    if (in_range(a, from, to)) {
+        MVMnum64 *x = slots_n(a);
+        for (k = from; k < to; k++)
+            init += x[k];
+    }
+    else {
+        for (k = from; k < to; k++)
+            init += MVM_repr_at_pos_n(tc, a, k);
+    }
+    return init;
+}
+
+MVMint64 MVM_spesh_vec_sum_i(MVMThreadContext *tc, MVMint64 init, MVMObject *a,
+        MVMint64 from, MVMint64 to) {
+    MVMint64 k;
+    if (in_range(a, from, to)) {
+        MVMint64 *x = slots_i(a);
+        for (k = from; k < to; k++)
+            init += x[k];
+    }
+    else {
+        for (k = from; k < to; k++)
+            init += MVM_repr_at_pos_i(tc, a, k);
+    }
+    return init;
+}
@@ -0,0 +1,23 @@
+/* The operation done by sp_vec_binop_n and sp_vec_binop_i. */
+#define MVM_SPESH_VEC_ADD   0
+#define MVM_SPESH_VEC_SUB   1
+#define MVM_SPESH_VEC_MUL   2
+
+/* The comparison done by sp_vec_cmp_n. */
+#define MVM_SPESH_VEC_EQ    0
+#define MVM_SPESH_VEC_NE    1
+#define MVM_SPESH_VEC_LT    2
+#define MVM_SPESH_VEC_LE    3
+
+void MVM_spesh_vectorize(MVMThreadContext *tc, MVMSpeshGraph *g);
+
+void MVM_spesh_vec_binop_n(MVMThreadContext *tc, MVMObject *dst, MVMObject *a, MVMObject *b,
+    MVMint64 from, MVMint64 to, MVMint64 kind);
+void MVM_spesh_vec_binop_i(MVMThreadContext *tc, MVMObject *dst, MVMObject *a, MVMObject *b,
+    MVMint64 from, MVMint64 to, MVMint64 kind);
+void MVM_spesh_vec_cmp_n(MVMThreadContext *tc, MVMObject *dst, MVMObject *a, MVMObject *b,
+    MVMint64 from, MVMint64 to, MVMint64 kind);
+MVMnum64 MVM_spesh_vec_sum_n(MVMThreadContext *tc, MVMnum64 init, MVMObject *a,
+    MVMint64 from, MVMint64 to);
+MVMint64 MVM_spesh_vec_sum_i(MVMThreadContext *tc, MVMint64 init, MVMObject *a,
+    MVMint64 from, MVMint64 to);
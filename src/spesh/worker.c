@@ -4,6 +4,142 @@
  * calls and types that showed up at runtime. It uses this to produce
  * specialized versions of code. */
 
+/* Acquires the lock used to hand out planned specializations; we may block
+ * for a while on it, so must be marked as blocked for GC purposes. */
+static void lock_plan(MVMThreadContext *tc) {
+    MVM_gc_mark_thread_blocked(tc);
+    uv_mutex_lock(&(tc->instance->mutex_spesh_plan));
+    MVM_gc_mark_thread_unblocked(tc);
+}
+
+/* Checks if the current plan has planned specializations in the current
+ * depth tier that no worker has yet claimed. Must be called with the plan
+ * lock held. */
+static MVMint32 plan_has_unclaimed(MVMInstance *instance) {
+    return instance->spesh_plan &&
+        instance->spesh_plan_next < instance->spesh_plan_tier_end;
+}
+
+/* Finds the end of the depth tier starting at the specified index of the
+ * plan; that is, of the planned specializations with the same maximum call
+ * depth. The plan is sorted deepest first, so callees are produced before
+ * their callers and can be inlined into them. */
+static MVMuint32 find_tier_end(MVMSpeshPlan *plan, MVMuint32 start) {
+    MVMuint32 end = start;
+    while (end < plan->num_planned &&
+            plan->planned[end].max_depth == plan->planned[start].max_depth)
+        end++;
+    return end;
+}
+
+/* Claims planned specializations from the current plan, in plan order, and
+ * produces them, until the plan is finished. Only those in the current depth
+ * tier can be claimed; once they are all produced, the next tier is opened,
+ * so if there's nothing to claim but the tier is still being worked on, we
+ * wait for it. This is done by the main worker and all of the helper
+ * workers. */
+static void produce_planned(MVMThreadContext *tc) {
+    MVMInstance *instance = tc->instance;
+    while (1) {
+        MVMSpeshPlanned *p;
+        lock_plan(tc);
+        while (!plan_has_unclaimed(instance) && instance->spesh_plan_outstanding) {
+            MVM_gc_mark_thread_blocked(tc);
+            uv_cond_wait(&(instance->cond_spesh_plan_ready), &(instance->mutex_spesh_plan));
+            MVM_gc_mark_thread_unblocked(tc);
+        }
+        if (!plan_has_unclaimed(instance)) {
+            uv_mutex_unlock(&(instance->mutex_spesh_plan));
+            return;
+        }
+        p = &(instance->spesh_plan->planned[instance->spesh_plan_next++]);
+        uv_mutex_unlock(&(instance->mutex_spesh_plan));
+
+        MVM_spesh_candidate_add(tc, p);
+        GC_SYNC_POINT(tc);
+
+        lock_plan(tc);
+        if (--instance->spesh_plan_outstanding == 0) {
+            uv_cond_broadcast(&(instance->cond_spesh_plan_done));
+            uv_cond_broadcast(&(instance->cond_spesh_plan_ready));
+        }
+        else if (instance->spesh_plan->num_planned - instance->spesh_plan_outstanding
+                == instance->spesh_plan_tier_end) {
+            instance->spesh_plan_tier_end = find_tier_end(instance->spesh_plan,
+                instance->spesh_plan_tier_end);
+            uv_cond_broadcast(&(instance->cond_spesh_plan_ready));
+        }
+        uv_mutex_unlock(&(instance->mutex_spesh_plan));
+    }
+}
+
+/* Makes a plan available to the workers, waking up any helpers. */
+static void publish_plan(MVMThreadContext *tc, MVMSpeshPlan *plan) {
+    MVMInstance *instance = tc->instance;
+    lock_plan(tc);
+    instance->spesh_plan = plan;
+    instance->spesh_plan_next = 0;
+    instance->spesh_plan_tier_end = find_tier_end(plan, 0);
+    instance->spesh_plan_outstanding = plan->num_planned;
+    uv_cond_broadcast(&(instance->cond_spesh_plan_ready));
+    uv_mutex_unlock(&(instance->mutex_spesh_plan));
+}
+
+/* Waits until all of the specializations in the current plan have been
+ * produced, and then discards the plan. */
+static void finish_plan(MVMThreadContext *tc) {
+    MVMInstance *instance = tc->instance;
+    MVMSpeshPlan *plan;
+    lock_plan(tc);
+    while (instance->spesh_plan_outstanding) {
+        MVM_gc_mark_thread_blocked(tc);
+        uv_cond_wait(&(instance->cond_spesh_plan_done), &(instance->mutex_spesh_plan));
+        MVM_gc_mark_thread_unblocked(tc);
+    }
+    plan = instance->spesh_plan;
+    instance->spesh_plan = NULL;
+    uv_mutex_unlock(&(instance->mutex_spesh_plan));
+    MVM_spesh_plan_destroy(tc, plan);
+}
+
+/* Work loop of a helper worker, which waits for a plan to be published by
+ * the main worker and helps produce the planned specializations. */
+static void helper(MVMThreadContext *tc, MVMCallsite *callsite, MVMRegister *args) {
+    MVMInstance *instance = tc->instance;
+    tc->region_pool_enabled = 1;
+    while (1) {
+        lock_plan(tc);
+        while (!instance->spesh_helpers_stop && !plan_has_unclaimed(instance)) {
+            MVM_gc_mark_thread_blocked(tc);
+            uv_cond_wait(&(instance->cond_spesh_plan_ready), &(instance->mutex_spesh_plan));
+            MVM_gc_mark_thread_unblocked(tc);
+        }
+        if (instance->spesh_helpers_stop) {
+            uv_mutex_unlock(&(instance->mutex_spesh_plan));
+            break;
+        }
+        uv_mutex_unlock(&(instance->mutex_spesh_plan));
+        produce_planned(tc);
+    }
+}
+
+/* Clears up stats that didn't get updated for a while, then moves frames
+ * updated this time into the previously updated array. Returns the number
+ * of frames moved. */
+static MVMuint32 rotate_updated_frames(MVMThreadContext *tc, MVMObject *updated_static_frames,
+                                       MVMObject *previous_static_frames) {
+    MVMuint32 i, n;
+    MVMROOT2(tc, updated_static_frames, previous_static_frames, {
+        MVM_spesh_stats_cleanup(tc, previous_static_frames);
+        n = MVM_repr_elems(tc, updated_static_frames);
+        for (i = 0; i < n; i++)
+            MVM_repr_push_o(tc, previous_static_frames,
+                MVM_repr_at_pos_o(tc, updated_static_frames, i));
+        MVM_repr_pos_set_elems(tc, updated_static_frames, 0);
+    });
+    return n;
+}
+
 /* Enters the work loop. */
 static void worker(MVMThreadContext *tc, MVMCallsite *callsite, MVMRegister *args) {
     MVMuint64 work_sequence_number = 0;
@@ -16,11 +152,14 @@ static void worker(MVMThreadContext *tc, MVMCallsite *callsite, MVMRegister *arg
     });
 
     tc->instance->speshworker_thread_id = tc->thread_obj->body.thread_id;
+    tc->region_pool_enabled = 1;
 
     MVMROOT2(tc, updated_static_frames, previous_static_frames, {
         while (1) {
             MVMObject *log_obj;
             MVMuint64 start_time;
+            MVMuint64 idle_time;
+            MVMint32 backlog = 0;
             unsigned int interval_id;
             MVMint64 *overview_data = NULL;
 
@@ -30,6 +169,7 @@ static void worker(MVMThreadContext *tc, MVMCallsite *callsite, MVMRegister *arg
 
             start_time = uv_hrtime();
             log_obj = MVM_repr_shift_o(tc, tc->instance->spesh_queue);
+            idle_time = uv_hrtime() - start_time;
             if (MVM_spesh_debug_enabled(tc)) {
                 MVM_spesh_debug_printf(tc,
                     "Received Logs\n"
@@ -69,138 +209,197 @@ static void worker(MVMThreadContext *tc, MVMCallsite *callsite, MVMRegister *arg
             uv_mutex_unlock(&(tc->instance->mutex_spesh_sync));
 
             tc->instance->spesh_stats_version++;
-            if (log_obj->st->REPR->ID == MVM_REPR_ID_MVMSpeshLog) {
-                MVMSpeshLog *sl = (MVMSpeshLog *)log_obj;
-                MVM_telemetry_interval_annotate((uintptr_t)sl->body.thread->body.tc, interval_id, "from this thread");
+            if (log_obj->st->REPR->ID == MVM_REPR_ID_MVMThread) {
+                /* A thread has logs for us in its log ring; process all of
+                 * them. Clear the notified flag first, so that any log added
+                 * after we find the ring empty will queue the thread again. */
+                MVMThread *thread = (MVMThread *)log_obj;
+                MVMSpeshLogRing *ring = thread->body.spesh_log_ring;
+                MVMSpeshLog *sl;
+                MVM_telemetry_interval_annotate((uintptr_t)thread->body.tc, interval_id, "from this thread");
                 if (overview_data) {
-                    overview_data[4] = sl->body.thread->body.tc->thread_id;
+                    overview_data[4] = thread->body.thread_id;
                 }
-                MVMROOT(tc, sl, {
-                    MVMThreadContext *stc;
-                    MVMuint32 i;
-                    MVMuint32 n;
-                    MVMuint64 newly_seen;
-                    MVMuint64 updated;
-
-                    MVMuint64 certain_spesh;
-                    MVMuint64 observed_spesh;
-                    MVMuint64 osr_spesh;
-
-                    /* Update stats, and if we're logging dump each of them. */
-                    tc->instance->spesh_stats_version++;
-                    start_time = uv_hrtime();
-                    MVM_spesh_stats_update(tc, sl, updated_static_frames, &newly_seen, &updated);
-                    n = MVM_repr_elems(tc, updated_static_frames);
-                    if (MVM_spesh_debug_enabled(tc)) {
-                        MVM_spesh_debug_printf(tc,
-                            "Statistics Updated\n"
-                            "==================\n"
-                            "%d frames had their statistics updated in %dus.\n\n",
-                            (int)n, (int)((uv_hrtime() - start_time) / 1000));
-                        for (i = 0; i < n; i++) {
-                            char *dump = MVM_spesh_dump_stats(tc, (MVMStaticFrame* )
-                                MVM_repr_at_pos_o(tc, updated_static_frames, i));
-                            MVM_spesh_debug_printf(tc, "%s==========\n\n", dump);
-                            MVM_free(dump);
-                        }
-                    }
-                    if (overview_data) {
-                        overview_data[5] = (uv_hrtime() - start_time) / 1000;
-                        overview_data[6] = newly_seen;
-                        overview_data[7] = updated;
-                    }
-                    MVM_telemetry_interval_annotate((uintptr_t)n, interval_id, "stats for this many frames");
-                    GC_SYNC_POINT(tc);
+                MVM_store(&(ring->notified), 0);
+                MVMROOT(tc, thread, {
+                    while ((sl = MVM_spesh_log_ring_take(tc, ring))) {
+                        MVMROOT(tc, sl, {
+                            MVMuint32 i;
+                            MVMuint32 n;
+                            MVMuint64 newly_seen;
+                            MVMuint64 updated;
+
+                            MVMuint64 certain_spesh;
+                            MVMuint64 observed_spesh;
+                            MVMuint64 osr_spesh;
+
+                            /* Update stats, and if we're logging dump each of them. */
+                            tc->instance->spesh_stats_version++;
+                            start_time = uv_hrtime();
+                            MVM_spesh_stats_update(tc, sl, updated_static_frames, &newly_seen, &updated);
+                            n = MVM_repr_elems(tc, updated_static_frames);
+                            if (MVM_spesh_debug_enabled(tc)) {
+                                MVM_spesh_debug_printf(tc,
+                                    "Statistics Updated\n"
+                                    "==================\n"
+                                    "%d frames had their statistics updated in %dus.\n\n",
+                                    (int)n, (int)((uv_hrtime() - start_time) / 1000));
+                                for (i = 0; i < n; i++) {
+                                    char *dump = MVM_spesh_dump_stats(tc, (MVMStaticFrame* )
+                                        MVM_repr_at_pos_o(tc, updated_static_frames, i));
+                                    MVM_spesh_debug_printf(tc, "%s==========\n\n", dump);
+                                    MVM_free(dump);
+                                }
+                            }
+                            if (overview_data) {
+                                overview_data[5] = (uv_hrtime() - start_time) / 1000;
+                                overview_data[6] = newly_seen;
+                                overview_data[7] = updated;
+                            }
+                            MVM_telemetry_interval_annotate((uintptr_t)n, interval_id, "stats for this many frames");
+                            GC_SYNC_POINT(tc);
+
+                            /* Form a specialization plan, and make it available to
+                             * any helper workers. */
+                            start_time = uv_hrtime();
+                            publish_plan(tc, MVM_spesh_plan(tc, updated_static_frames, &certain_spesh, &observed_spesh, &osr_spesh));
+                            if (MVM_spesh_debug_enabled(tc)) {
+                                n = tc->instance->spesh_plan->num_planned;
+                                MVM_spesh_debug_printf(tc,
+                                    "Specialization Plan\n"
+                                    "===================\n"
+                                    "%u specialization(s) will be produced (planned in %dus).\n\n",
+                                    n, (int)((uv_hrtime() - start_time) / 1000));
+                                for (i = 0; i < n; i++) {
+                                    char *dump = MVM_spesh_dump_planned(tc,
+                                        &(tc->instance->spesh_plan->planned[i]));
+                                    MVM_spesh_debug_printf(tc, "%s==========\n\n", dump);
+                                    MVM_free(dump);
+                                }
+                            }
 
-                    /* Form a specialization plan. */
-                    start_time = uv_hrtime();
-                    tc->instance->spesh_plan = MVM_spesh_plan(tc, updated_static_frames, &certain_spesh, &observed_spesh, &osr_spesh);
-                    if (MVM_spesh_debug_enabled(tc)) {
-                        n = tc->instance->spesh_plan->num_planned;
-                        MVM_spesh_debug_printf(tc,
-                            "Specialization Plan\n"
-                            "===================\n"
-                            "%u specialization(s) will be produced (planned in %dus).\n\n",
-                            n, (int)((uv_hrtime() - start_time) / 1000));
-                        for (i = 0; i < n; i++) {
-                            char *dump = MVM_spesh_dump_planned(tc,
-                                &(tc->instance->spesh_plan->planned[i]));
-                            MVM_spesh_debug_printf(tc, "%s==========\n\n", dump);
-                            MVM_free(dump);
-                        }
-                    }
+                            if (overview_data) {
+                                overview_data[8] = (uv_hrtime() - start_time) / 1000;
+                                overview_data[9] = certain_spesh;
+                                overview_data[10] = observed_spesh;
+                                overview_data[11] = osr_spesh;
+                            }
 
-                    if (overview_data) {
-                        overview_data[8] = (uv_hrtime() - start_time) / 1000;
-                        overview_data[9] = certain_spesh;
-                        overview_data[10] = observed_spesh;
-                        overview_data[11] = osr_spesh;
-                    }
+                            MVM_telemetry_interval_annotate((uintptr_t)tc->instance->spesh_plan->num_planned, interval_id,
+                                    "this many specializations planned");
+                            GC_SYNC_POINT(tc);
 
-                    MVM_telemetry_interval_annotate((uintptr_t)tc->instance->spesh_plan->num_planned, interval_id,
-                            "this many specializations planned");
-                    GC_SYNC_POINT(tc);
+                            start_time = uv_hrtime();
 
-                    start_time = uv_hrtime();
+                            /* Implement the plan, together with any helpers, and
+                             * then discard it. */
+                            produce_planned(tc);
+                            finish_plan(tc);
 
-                    /* Implement the plan and then discard it. */
-                    n = tc->instance->spesh_plan->num_planned;
-                    for (i = 0; i < n; i++) {
-                        MVM_spesh_candidate_add(tc, &(tc->instance->spesh_plan->planned[i]));
-                        GC_SYNC_POINT(tc);
-                    }
-                    MVM_spesh_plan_destroy(tc, tc->instance->spesh_plan);
-                    tc->instance->spesh_plan = NULL;
+                            if (overview_data) {
+                                overview_data[12] = (uv_hrtime() - start_time) / 1000;
+                            }
 
-                    if (overview_data) {
-                        overview_data[12] = (uv_hrtime() - start_time) / 1000;
-                    }
+                            n = rotate_updated_frames(tc, updated_static_frames,
+                                previous_static_frames);
+                            if (overview_data) {
+                                overview_data[13] = n;
+                            }
 
-                    /* Clear up stats that didn't get updated for a while,
-                     * then add frames updated this time into the previously
-                     * updated array. */
-                    MVM_spesh_stats_cleanup(tc, previous_static_frames);
-                    n = MVM_repr_elems(tc, updated_static_frames);
-                    for (i = 0; i < n; i++)
-                        MVM_repr_push_o(tc, previous_static_frames,
-                            MVM_repr_at_pos_o(tc, updated_static_frames, i));
-
-                    if (overview_data) {
-                        overview_data[13] = n;
-                    }
+                            /* Update the thread's log quota, putting a new spesh
+                             * log in place if it had run out. */
+                            if (!sl->body.was_compunit_bumped) {
+                                if (MVM_incr(&(ring->quota)) == 0) {
+                                    MVMThreadContext *stc = thread->body.tc;
+                                    if (stc) {
+                                        stc->spesh_log = MVM_spesh_log_create(tc, thread);
+                                        MVM_telemetry_timestamp(stc, "logging restored after quota had run out");
+                                    }
+                                    backlog = 1;
+                                }
+                            }
+                            else {
+                                MVM_decr(&(ring->num_compunit_extra_logs));
+                            }
 
-                    /* Clear updated static frames array. */
-                    MVM_repr_pos_set_elems(tc, updated_static_frames, 0);
-
-                    /* Allow the sending thread to produce more logs again,
-                     * putting a new spesh log in place if needed. */
-                    stc = sl->body.thread->body.tc;
-                    if (stc) {
-                        if (!sl->body.was_compunit_bumped) {
-                            if (MVM_incr(&(stc->spesh_log_quota)) == 0) {
-                                stc->spesh_log = MVM_spesh_log_create(tc, sl->body.thread);
-                                MVM_telemetry_timestamp(stc, "logging restored after quota had run out");
+                            /* If needed, signal sending thread that it can continue. */
+                            if (sl->body.block_mutex) {
+                                uv_mutex_lock(sl->body.block_mutex);
+                                MVM_store(&(sl->body.completed), 1);
+                                uv_cond_signal(sl->body.block_condvar);
+                                uv_mutex_unlock(sl->body.block_mutex);
+                            }
+                            {
+                                MVMSpeshLogEntry *entries = sl->body.entries;
+                                sl->body.entries = NULL;
+                                MVM_free(entries);
                             }
-                        }
-                        else {
-                            MVM_decr(&(stc->num_compunit_extra_logs));
-                        }
+                        });
                     }
+                });
 
-                    /* If needed, signal sending thread that it can continue. */
-                    if (sl->body.block_mutex) {
-                        uv_mutex_lock(sl->body.block_mutex);
-                        MVM_store(&(sl->body.completed), 1);
-                        uv_cond_signal(sl->body.block_condvar);
-                        uv_mutex_unlock(sl->body.block_mutex);
-                    }
-                    {
-                        MVMSpeshLogEntry *entries = sl->body.entries;
-                        sl->body.entries = NULL;
-                        MVM_free(entries);
+                /* Report any times the thread ran out of log quota since
+                 * last time. */
+                if (MVM_load(&(ring->quota_exhausted)) != ring->quota_exhausted_reported) {
+                    MVMuint64 exhausted = MVM_load(&(ring->quota_exhausted));
+                    if (MVM_spesh_debug_enabled(tc)) {
+                        MVM_spesh_debug_printf(tc,
+                            "Log Quota Exhausted\n"
+                            "===================\n"
+                            "Thread %u ran out of log quota %"PRIu64" time(s) while the worker was busy "
+                            "(%"PRIu64" time(s) over all threads so far).\n\n",
+                            thread->body.thread_id, exhausted - ring->quota_exhausted_reported,
+                            (MVMuint64)MVM_load(&(tc->instance->spesh_log_quota_exhausted)));
                     }
-                });
+                    ring->quota_exhausted_reported = exhausted;
+                }
+            }
+            else if (log_obj->st->REPR->ID == MVM_REPR_ID_MVMStaticFrame) {
+                /* A frame with cached specialization profiles was invoked
+                 * for the first time; seed its statistics from them and
+                 * specialize it right away. */
+                MVMStaticFrameSpesh *spesh = ((MVMStaticFrame *)log_obj)->body.spesh;
+                MVMuint64 certain_spesh;
+                MVMuint64 observed_spesh;
+                MVMuint64 osr_spesh;
+                MVM_spesh_profile_cache_seed(tc, (MVMStaticFrame *)log_obj,
+                    updated_static_frames);
+                GC_SYNC_POINT(tc);
+
+                start_time = uv_hrtime();
+                publish_plan(tc, MVM_spesh_plan(tc, updated_static_frames, &certain_spesh, &observed_spesh, &osr_spesh));
+                if (MVM_spesh_debug_enabled(tc)) {
+                    MVM_spesh_debug_printf(tc,
+                        "Specialization Plan From Profile Cache\n"
+                        "======================================\n"
+                        "%u specialization(s) will be produced (planned in %dus).\n\n",
+                        tc->instance->spesh_plan->num_planned,
+                        (int)((uv_hrtime() - start_time) / 1000));
+                }
+                if (overview_data) {
+                    overview_data[8] = (uv_hrtime() - start_time) / 1000;
+                    overview_data[9] = certain_spesh;
+                    overview_data[10] = observed_spesh;
+                    overview_data[11] = osr_spesh;
+                }
+                GC_SYNC_POINT(tc);
+
+                start_time = uv_hrtime();
+                produce_planned(tc);
+                finish_plan(tc);
+                if (overview_data) {
+                    overview_data[12] = (uv_hrtime() - start_time) / 1000;
+                    overview_data[13] = rotate_updated_frames(tc,
+                        updated_static_frames, previous_static_frames);
+                }
+                else {
+                    rotate_updated_frames(tc, updated_static_frames,
+                        previous_static_frames);
+                }
 
+                /* The frame's specializations are installed now, so let the
+                 * thread invoking it go if it is waiting for them. */
+                MVM_spesh_profile_cache_seeded(tc, spesh);
             }
             else if (MVM_is_null(tc, log_obj)) {
                 /* This is a stop signal, so quit processing */
@@ -211,6 +410,13 @@ static void worker(MVMThreadContext *tc, MVMCallsite *callsite, MVMRegister *arg
 
             MVM_telemetry_interval_stop(tc, interval_id, "spesh worker finished");
 
+            /* Adapt the thresholds to how busy we are, if asked to. Logs that
+             * arrived in the threads' log rings while we were working mean
+             * we're falling behind. */
+            if (MVM_load(&(tc->instance->spesh_logs_waiting)) > 0)
+                backlog = 1;
+            MVM_spesh_threshold_adapt(tc, idle_time, backlog);
+
             if (overview_data) {
                 MVMObject *queue = tc->instance->subscriptions.subscription_queue;
 
@@ -243,6 +449,7 @@ static void worker(MVMThreadContext *tc, MVMCallsite *callsite, MVMRegister *arg
 void MVM_spesh_worker_start(MVMThreadContext *tc) {
     MVMObject *worker_entry_point;
     if (tc->instance->spesh_enabled) {
+        MVMuint32 num_helpers = tc->instance->spesh_num_workers - 1;
 
         /* There must not be a running thread now */
         assert(tc->instance->spesh_thread == NULL);
@@ -255,6 +462,27 @@ void MVM_spesh_worker_start(MVMThreadContext *tc) {
 
         tc->instance->spesh_thread = MVM_thread_new(tc, worker_entry_point, 1);
         MVM_thread_run(tc, tc->instance->spesh_thread);
+
+        /* Start any helper workers. */
+        if (num_helpers) {
+            MVMuint32 i;
+            tc->instance->spesh_helpers_stop = 0;
+            tc->instance->spesh_helper_threads = MVM_repr_alloc_init(tc,
+                tc->instance->boot_types.BOOTArray);
+            if (!tc->instance->speshworker_helper_thread_ids)
+                tc->instance->speshworker_helper_thread_ids = MVM_calloc(num_helpers,
+                    sizeof(MVMuint32));
+            for (i = 0; i < num_helpers; i++) {
+                MVMObject *helper_thread;
+                worker_entry_point = MVM_repr_alloc_init(tc, tc->instance->boot_types.BOOTCCode);
+                ((MVMCFunction *)worker_entry_point)->body.func = helper;
+                helper_thread = MVM_thread_new(tc, worker_entry_point, 1);
+                tc->instance->speshworker_helper_thread_ids[i] =
+                    ((MVMThread *)helper_thread)->body.thread_id;
+                MVM_repr_push_o(tc, tc->instance->spesh_helper_threads, helper_thread);
+                MVM_thread_run(tc, helper_thread);
+            }
+        }
     }
 }
 
@@ -262,6 +490,14 @@ void MVM_spesh_worker_stop(MVMThreadContext *tc) {
     /* Send stop sentinel */
     if (tc->instance->spesh_enabled) {
         MVM_repr_unshift_o(tc, tc->instance->spesh_queue, tc->instance->VMNull);
+
+        /* Tell any helpers to stop once there's nothing left to claim. */
+        if (tc->instance->spesh_helper_threads) {
+            lock_plan(tc);
+            tc->instance->spesh_helpers_stop = 1;
+            uv_cond_broadcast(&(tc->instance->cond_spesh_plan_ready));
+            uv_mutex_unlock(&(tc->instance->mutex_spesh_plan));
+        }
     }
 }
 
@@ -271,5 +507,29 @@ void MVM_spesh_worker_join(MVMThreadContext *tc) {
         assert(tc->instance->spesh_thread != NULL);
         MVM_thread_join(tc, tc->instance->spesh_thread);
         tc->instance->spesh_thread = NULL;
+
+        /* Join any helpers. */
+        if (tc->instance->spesh_helper_threads) {
+            MVMint64 n = MVM_repr_elems(tc, tc->instance->spesh_helper_threads);
+            MVMint64 i;
+            for (i = 0; i < n; i++)
+                MVM_thread_join(tc, MVM_repr_at_pos_o(tc,
+                    tc->instance->spesh_helper_threads, i));
+            tc->instance->spesh_helper_threads = NULL;
+        }
+    }
+}
+
+/* Checks if the thread with the specified ID is a specialization worker,
+ * either the main one or a helper. */
+MVMint32 MVM_spesh_worker_is_worker_thread_id(MVMInstance *instance, MVMuint32 thread_id) {
+    if (thread_id == instance->speshworker_thread_id)
+        return 1;
+    if (instance->speshworker_helper_thread_ids) {
+        MVMuint32 i;
+        for (i = 0; i < instance->spesh_num_workers - 1; i++)
+            if (thread_id == instance->speshworker_helper_thread_ids[i])
+                return 1;
     }
+    return 0;
 }
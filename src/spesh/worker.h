@@ -1,4 +1,8 @@
+/* The maximum number of specialization worker threads (the main worker plus
+ * any helpers) that may be configured with MVM_SPESH_WORKERS. */
+#define MVM_SPESH_MAX_WORKERS 16
+
 void MVM_spesh_worker_start(MVMThreadContext *tc);
 void MVM_spesh_worker_stop(MVMThreadContext *tc);
 void MVM_spesh_worker_join(MVMThreadContext *tc);
-
+MVMint32 MVM_spesh_worker_is_worker_thread_id(MVMInstance *instance, MVMuint32 thread_id);
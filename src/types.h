@@ -170,7 +170,9 @@ typedef struct MVMSpeshAnn MVMSpeshAnn;
 typedef struct MVMSpeshFacts MVMSpeshFacts;
 typedef struct MVMSpeshCode MVMSpeshCode;
 typedef struct MVMSpeshCandidate MVMSpeshCandidate;
+typedef struct MVMSpeshOSREntry MVMSpeshOSREntry;
 typedef struct MVMSpeshLogGuard MVMSpeshLogGuard;
+typedef struct MVMSpeshLogRing MVMSpeshLogRing;
 typedef struct MVMSpeshCallInfo MVMSpeshCallInfo;
 typedef struct MVMSpeshInline MVMSpeshInline;
 typedef struct MVMSpeshIterator MVMSpeshIterator;
@@ -180,6 +182,8 @@ typedef struct MVMSpeshLogEntry MVMSpeshLogEntry;
 typedef struct MVMSpeshPluginState MVMSpeshPluginState;
 typedef struct MVMSpeshPluginPosition MVMSpeshPluginPosition;
 typedef struct MVMSpeshPluginGuardSet MVMSpeshPluginGuardSet;
+typedef struct MVMSpeshPluginGuardIndex MVMSpeshPluginGuardIndex;
+typedef struct MVMSpeshPluginGuardIndexEntry MVMSpeshPluginGuardIndexEntry;
 typedef struct MVMSpeshPluginGuard MVMSpeshPluginGuard;
 typedef struct MVMSpeshStats MVMSpeshStats;
 typedef struct MVMSpeshStatsByCallsite MVMSpeshStatsByCallsite;
@@ -196,6 +200,10 @@ typedef struct MVMSpeshSimStackFrame MVMSpeshSimStackFrame;
 typedef struct MVMSpeshSimCallType MVMSpeshSimCallType;
 typedef struct MVMSpeshPlan MVMSpeshPlan;
 typedef struct MVMSpeshPlanned MVMSpeshPlanned;
+typedef struct MVMSpeshProfileCache MVMSpeshProfileCache;
+typedef struct MVMSpeshProfileCacheUnit MVMSpeshProfileCacheUnit;
+typedef struct MVMSpeshProfileCacheEntry MVMSpeshProfileCacheEntry;
+typedef struct MVMSpeshProfileCacheType MVMSpeshProfileCacheType;
 typedef struct MVMSpeshArgGuard MVMSpeshArgGuard;
 typedef struct MVMSpeshArgGuardNode MVMSpeshArgGuardNode;
 typedef struct MVMSpeshUsages MVMSpeshUsages;
@@ -207,6 +215,7 @@ typedef struct MVMSpeshPEAAllocation MVMSpeshPEAAllocation;
 typedef struct MVMSpeshPEADeopt MVMSpeshPEADeopt;
 typedef struct MVMSpeshPEAMaterializeInfo MVMSpeshPEAMaterializeInfo;
 typedef struct MVMSpeshPEADeoptPoint MVMSpeshPEADeoptPoint;
+typedef struct MVMSpeshPEAOSRUnbox MVMSpeshPEAOSRUnbox;
 typedef struct MVMConfigurationProgram MVMConfigurationProgram;
 typedef struct MVMSTable MVMSTable;
 typedef struct MVMStaticFrame MVMStaticFrame;
@@ -264,6 +273,11 @@ typedef struct MVMJitControl MVMJitControl;
 typedef struct MVMJitData MVMJitData;
 typedef struct MVMJitStackSlot MVMJitStackSlot;
 typedef struct MVMJitCode MVMJitCode;
+typedef struct MVMJitCodeHeap MVMJitCodeHeap;
+typedef struct MVMJitCodeChunk MVMJitCodeChunk;
+typedef struct MVMJitCodeFreeBlock MVMJitCodeFreeBlock;
+typedef struct MVMJitGDBCodeEntry MVMJitGDBCodeEntry;
+typedef struct MVMJitGDBDescriptor MVMJitGDBDescriptor;
 typedef struct MVMJitCompiler MVMJitCompiler;
 typedef struct MVMJitExprTree MVMJitExprTree;
 typedef struct MVMJitExprInfo MVMJitExprInfo;
@@ -55,7 +55,7 @@ END {
 
 # Expected result type
 my %OPERATOR_TYPES = (
-    (map { $_ => 'void' } qw(store store_num discard dov when ifv branch mark callv guard)),
+    (map { $_ => 'void' } qw(store store_num discard dov when ifv branch mark callv guard deopt)),
     (map { $_ => 'flag' } qw(lt le eq ne ge gt nz zr all any)),
     (map { $_ => 'num' }  qw(const_num load_num calln)),
     (map { $_ => '?' }    qw(if copy do add sub mul)),
@@ -385,8 +385,8 @@ sub compile_reference {
         my ($ref, $name) = $expr =~ m/^(\\?)\$(\w+)/;
     if (looks_like_number($name)) {
         my $opcode = $compiler->{opcode};
-        # special case for dec_i/inc_i
-        return 'i' => $name if $opcode =~ m/^(dec|inc)_i$/ and $name <= 1;
+        # special case for dec_i/inc_i and dec_u/inc_u
+        return 'i' => $name if $opcode =~ m/^(dec|inc)_[iu]$/ and $name <= 1;
         my @direction = operand_direction($opcode);
         die "Invalid operand reference $expr for $opcode"
             unless $name >= 0 && $name < @direction;
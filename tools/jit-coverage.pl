@@ -0,0 +1,83 @@
+#!/usr/bin/env perl
+# Report which ops the JIT can compile, and how.
+#
+# Ops with a template in src/jit/core_templates.expr are compiled by the
+# expression JIT. Ops without one, but which src/jit/graph.c knows about, are
+# compiled by the legacy ('lego') JIT, which ends the current expression tree.
+# For any other op, the JIT bails out and the whole frame stays in the
+# interpreter.
+#
+# Given a JIT log (as written with MVM_JIT_LOG), uncovered ops are sorted by
+# how often they caused a bail, so the ones that matter most come first:
+#
+#   perl -Itools/ tools/jit-coverage.pl [--all] [jit.log]
+use strict;
+use warnings;
+use Getopt::Long;
+use File::Spec;
+use FindBin;
+use lib File::Spec->catdir($FindBin::Bin, 'lib');
+
+use oplist;
+
+my %OPTIONS = (
+    templates => File::Spec->catfile($FindBin::Bin, File::Spec->updir, qw(src jit core_templates.expr)),
+    graph     => File::Spec->catfile($FindBin::Bin, File::Spec->updir, qw(src jit graph.c)),
+    all       => 0,
+);
+GetOptions(\%OPTIONS, qw(templates=s graph=s all)) or die "Invalid options";
+
+my (%expr, %lego, %bails);
+
+open my $templates, '<', $OPTIONS{templates} or die "Could not open $OPTIONS{templates}: $!";
+while (<$templates>) {
+    $expr{$1} = 1 if m/^\s*\(template:\s+(\w+)!?/;
+}
+close $templates;
+
+open my $graph, '<', $OPTIONS{graph} or die "Could not open $OPTIONS{graph}: $!";
+while (<$graph>) {
+    $lego{$1} = 1 while m/case MVM_OP_(\w+):/g;
+}
+close $graph;
+
+if (my $log = shift @ARGV) {
+    open my $fh, '<', $log or die "Could not open $log: $!";
+    while (<$fh>) {
+        $bails{$1}++ if m/BAIL: .*?<(\w+)>/;
+    }
+    close $fh;
+}
+
+my (@expr, @lego, @none);
+for my $op (@OPLIST) {
+    my $name = $op->[0];
+    next if $name =~ m/^DEPRECATED/;
+    if ($expr{$name}) {
+        push @expr, $name;
+    } elsif ($lego{$name}) {
+        push @lego, $name;
+    } else {
+        push @none, $name;
+    }
+}
+
+my $total = @expr + @lego + @none;
+printf "%d ops: %d expression JIT, %d legacy JIT, %d not compiled\n",
+    $total, scalar @expr, scalar @lego, scalar @none;
+
+sub report {
+    my ($title, @ops) = @_;
+    return unless @ops;
+    print "\n$title:\n";
+    if (%bails) {
+        @ops = sort { ($bails{$b} // 0) <=> ($bails{$a} // 0) || $a cmp $b } @ops;
+        printf "  %-28s %d\n", $_, $bails{$_} // 0 for @ops;
+    } else {
+        print "  $_\n" for @ops;
+    }
+}
+
+report('Not compiled (frames containing these bail)', @none);
+report('Legacy JIT only (these end expression trees)', @lego);
+report('Expression JIT', @expr) if $OPTIONS{all};